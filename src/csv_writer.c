@@ -1,19 +1,171 @@
 /* Standard library headers */
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 /* Project headers */
 #include "csv_writer.h"
 #include "utils.h"
 
-/* CSV Writer structure */
+/* Bytes of repeated empty fields or line terminators copied at once */
+#define CSV_RUN_BLOCK_SIZE 4096
+
+/* Output buffer size when the options leave it at 0, and its alignment and size unit */
+#define CSV_OUTPUT_BUFFER_DEFAULT_KB 1024
+#define CSV_OUTPUT_ALIGN             4096
+
+/* CSV Writer structure.
+ * Output is collected in out and written when it is full or flushed: straight
+ * to the file descriptor behind fp with write(2), or through fp for streams
+ * that have none (open_memstream).
+ */
 struct csvWriter {
     FILE        *fp;
+    int          fd;               /* Descriptor of fp, -1 to write through fp */
+    char        *out;              /* Output not written yet */
+    size_t       out_len;
+    size_t       out_capacity;
+    bool         failed;           /* A write failed; later output is dropped */
     xlsxOptions *options;
+    size_t       terminator_len;   /* Bytes of options->lineterminator */
     int          field_index;
-    int          field_count; /* Total fields in current row */
+    int          field_count;      /* Total fields in current row */
+    char        *scratch;          /* Fields rewritten for line breaks, kept between fields */
+    size_t       scratch_capacity;
+    char         empty_field[3];   /* An empty field after the first: delimiter, quotes if any */
+    size_t       empty_field_len;
+    char         empty_fields[CSV_RUN_BLOCK_SIZE]; /* empty_field back to back */
+    size_t       empty_fields_len;
+    char         empty_rows[CSV_RUN_BLOCK_SIZE];   /* The line terminator back to back */
+    size_t       empty_rows_len;
 };
 
+/* Fill a block with unit repeated as many whole times as fit; returns the bytes used,
+ * 0 if unit is empty or longer than the block.
+ */
+static size_t run_block_fill(char *block, const char *unit, size_t unit_len)
+{
+    if (unit_len == 0 || unit_len > CSV_RUN_BLOCK_SIZE) {
+        return 0;
+    }
+
+    size_t full = CSV_RUN_BLOCK_SIZE / unit_len * unit_len;
+    size_t len  = unit_len;
+    memcpy(block, unit, unit_len);
+    while (len < full) {
+        size_t n = len < full - len ? len : full - len;
+        memcpy(block + len, block, n);
+        len += n;
+    }
+    return len;
+}
+
+/* Write all of iov to fd, continuing after partial writes and interruptions */
+static int fd_write_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        size_t done = (size_t)written;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+/* Write the buffer, then len bytes of data, and empty the buffer */
+static int out_flush_with(csvWriter *writer, const char *data, size_t len)
+{
+    size_t buffered = writer->out_len;
+    writer->out_len = 0;
+    if (writer->failed) {
+        return -1;
+    }
+    if (buffered == 0 && len == 0) {
+        return 0;
+    }
+
+    int status = 0;
+    if (writer->fd >= 0) {
+        /* Whatever was written to fp before goes out first */
+        struct iovec iov[2] = {
+            {.iov_base = writer->out, .iov_len = buffered},
+            {.iov_base = (void *)(uintptr_t)data, .iov_len = len}
+        };
+        status = fflush(writer->fp) == 0 ? fd_write_all(writer->fd, iov, 2) : -1;
+    } else if (fwrite(writer->out, 1, buffered, writer->fp) != buffered ||
+               (len > 0 && fwrite(data, 1, len, writer->fp) != len)) {
+        status = -1;
+    }
+
+    writer->failed = status < 0;
+    return status;
+}
+
+/* Append len bytes to the output */
+static void out_write(csvWriter *writer, const char *data, size_t len)
+{
+    if (len <= writer->out_capacity - writer->out_len) {
+        memcpy(writer->out + writer->out_len, data, len);
+        writer->out_len += len;
+    } else if (len < writer->out_capacity) {
+        out_flush_with(writer, NULL, 0);
+        memcpy(writer->out, data, len);
+        writer->out_len = len;
+    } else {
+        /* Not worth copying: written right after the buffer */
+        out_flush_with(writer, data, len);
+    }
+}
+
+static void out_byte(csvWriter *writer, char c)
+{
+    if (writer->out_len == writer->out_capacity) {
+        out_flush_with(writer, NULL, 0);
+    }
+    writer->out[writer->out_len++] = c;
+}
+
+/* Write unit count times, from a block filled by run_block_fill when there is one */
+static int run_block_write(csvWriter  *writer,
+                           const char *block,
+                           size_t      block_len,
+                           const char *unit,
+                           size_t      unit_len,
+                           size_t      count)
+{
+    if (block_len == 0) {
+        for (size_t i = 0; i < count; i++) {
+            out_write(writer, unit, unit_len);
+        }
+        return writer->failed ? -1 : 0;
+    }
+
+    size_t remaining = count * unit_len;
+    while (remaining > 0) {
+        size_t n = remaining < block_len ? remaining : block_len;
+        out_write(writer, block, n);
+        remaining -= n;
+    }
+    return writer->failed ? -1 : 0;
+}
+
 /* Create CSV writer */
 csvWriter *csv_writer_create(FILE *fp, xlsxOptions *options)
 {
@@ -26,24 +178,83 @@ csvWriter *csv_writer_create(FILE *fp, xlsxOptions *options)
         return NULL;
     }
 
-    writer->fp          = fp;
-    writer->options     = options;
-    writer->field_index = 0;
-    writer->field_count = 0;
+    int    kb   = options->write_buffer_kb > 0 ? options->write_buffer_kb
+                                                : CSV_OUTPUT_BUFFER_DEFAULT_KB;
+    size_t size = ((size_t)kb * 1024 + CSV_OUTPUT_ALIGN - 1) / CSV_OUTPUT_ALIGN * CSV_OUTPUT_ALIGN;
+    writer->out = aligned_alloc(CSV_OUTPUT_ALIGN, size);
+    if (!writer->out) {
+        free(writer);
+        return NULL;
+    }
+
+    writer->fp             = fp;
+    writer->fd             = fileno(fp);
+    writer->out_capacity   = size;
+    writer->options        = options;
+    writer->terminator_len = strlen(options->lineterminator);
+    writer->field_index    = 0;
+    writer->field_count    = 0;
+
+    /* Only the first field of a row can be quoted on its own when empty */
+    writer->empty_field[0]  = options->delimiter;
+    writer->empty_field_len = 1;
+    if (options->quoting == QUOTE_ALL || options->quoting == QUOTE_NONNUMERIC) {
+        writer->empty_field[1]  = '"';
+        writer->empty_field[2]  = '"';
+        writer->empty_field_len = 3;
+    }
+    writer->empty_fields_len =
+        run_block_fill(writer->empty_fields, writer->empty_field, writer->empty_field_len);
+    writer->empty_rows_len =
+        run_block_fill(writer->empty_rows, options->lineterminator, writer->terminator_len);
 
     return writer;
 }
 
-/* Free CSV writer */
+/* Free CSV writer, writing out what it still holds */
 void csv_writer_free(csvWriter *writer)
 {
     if (writer) {
+        out_flush_with(writer, NULL, 0);
+        free(writer->out);
+        free(writer->scratch);
         free(writer);
     }
 }
 
+/* Write out the buffered output; -1 if this or any earlier write failed */
+int csv_writer_flush(csvWriter *writer)
+{
+    if (!writer) {
+        return -1;
+    }
+    return out_flush_with(writer, NULL, 0);
+}
+
+/* Scratch space for size bytes, NULL if out of memory */
+static char *csv_writer_scratch(csvWriter *writer, size_t size)
+{
+    if (size > writer->scratch_capacity) {
+        size_t capacity = writer->scratch_capacity ? writer->scratch_capacity : 256;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        char *scratch = realloc(writer->scratch, capacity);
+        if (!scratch) {
+            return NULL;
+        }
+        writer->scratch          = scratch;
+        writer->scratch_capacity = capacity;
+    }
+    return writer->scratch;
+}
+
 /* Check if field needs quoting based on quoting mode */
-static bool needs_quoting(const char *field, xlsxOptions *options, int field_count, int field_index)
+static bool needs_quoting(const char  *field,
+                          size_t       len,
+                          xlsxOptions *options,
+                          int          field_count,
+                          int          field_index)
 {
     if (!field) {
         return false;
@@ -61,17 +272,17 @@ static bool needs_quoting(const char *field, xlsxOptions *options, int field_cou
 
         case QUOTE_MINIMAL:
             /* Empty strings: only quote if it's the ONLY field in the row */
-            if (field[0] == '\0') {
+            if (len == 0) {
                 return (field_count == 1 && field_index == 0);
             }
             /* Quote if field contains delimiter, quote, or line breaks */
-            if (strchr(field, options->delimiter) != NULL) {
+            if (memchr(field, options->delimiter, len) != NULL) {
                 return true;
             }
-            if (strchr(field, '"') != NULL) {
+            if (memchr(field, '"', len) != NULL) {
                 return true;
             }
-            if (strchr(field, '\n') != NULL || strchr(field, '\r') != NULL) {
+            if (memchr(field, '\n', len) != NULL || memchr(field, '\r', len) != NULL) {
                 return true;
             }
             return false;
@@ -84,8 +295,52 @@ static bool needs_quoting(const char *field, xlsxOptions *options, int field_cou
     }
 }
 
+/* How a non-empty field is written with these options */
+csvFieldForm csv_field_form(const xlsxOptions *options, const char *field, size_t len)
+{
+    /* Line break replacement and escaping rewrite the field */
+    if ((options->no_line_breaks || options->escape_strings) &&
+        (memchr(field, '\r', len) || memchr(field, '\n', len) || memchr(field, '\t', len))) {
+        return CSV_FIELD_ENCODE;
+    }
+
+    switch (options->quoting) {
+        case QUOTE_ALL:
+        case QUOTE_NONNUMERIC:
+            return memchr(field, '"', len) ? CSV_FIELD_ENCODE : CSV_FIELD_QUOTED;
+
+        case QUOTE_MINIMAL:
+            if (memchr(field, '"', len)) {
+                return CSV_FIELD_ENCODE;
+            }
+            if (memchr(field, options->delimiter, len) || memchr(field, '\n', len) ||
+                memchr(field, '\r', len)) {
+                return CSV_FIELD_QUOTED;
+            }
+            return CSV_FIELD_PLAIN;
+
+        case QUOTE_NONE:
+            return CSV_FIELD_PLAIN;
+
+        default:
+            return CSV_FIELD_ENCODE;
+    }
+}
+
 /* Write a single field */
 int csv_write_field(csvWriter *writer, const char *field)
+{
+    return csv_write_field_len(writer, field, field ? strlen(field) : 0);
+}
+
+/* Write a single field given as len bytes, not necessarily NUL-terminated */
+int csv_write_field_len(csvWriter *writer, const char *field, size_t len)
+{
+    return csv_write_field_as(writer, field, len, CSV_FIELD_UNKNOWN);
+}
+
+/* Write a single field whose form may already be known (CSV_FIELD_UNKNOWN otherwise) */
+int csv_write_field_as(csvWriter *writer, const char *field, size_t len, csvFieldForm form)
 {
     if (!writer || !writer->fp) {
         return -1;
@@ -93,18 +348,35 @@ int csv_write_field(csvWriter *writer, const char *field)
 
     /* Write delimiter if not first field */
     if (writer->field_index > 0) {
-        fputc(writer->options->delimiter, writer->fp);
+        out_byte(writer, writer->options->delimiter);
     }
 
     /* Handle NULL field */
     if (!field) {
         field = "";
+        len   = 0;
     }
 
     /* Check if empty field needs quoting */
-    if (field[0] == '\0') {
-        if (needs_quoting(field, writer->options, writer->field_count, writer->field_index)) {
-            fputs("\"\"", writer->fp);
+    if (len == 0) {
+        if (needs_quoting(field, len, writer->options, writer->field_count, writer->field_index)) {
+            out_write(writer, "\"\"", 2);
+        }
+        writer->field_index++;
+        return 0;
+    }
+
+    /* Fields that are written as they are, or only wrapped in quotes */
+    if (form == CSV_FIELD_UNKNOWN) {
+        form = csv_field_form(writer->options, field, len);
+    }
+    if (form == CSV_FIELD_PLAIN || form == CSV_FIELD_QUOTED) {
+        if (form == CSV_FIELD_QUOTED) {
+            out_byte(writer, '"');
+        }
+        out_write(writer, field, len);
+        if (form == CSV_FIELD_QUOTED) {
+            out_byte(writer, '"');
         }
         writer->field_index++;
         return 0;
@@ -114,23 +386,21 @@ int csv_write_field(csvWriter *writer, const char *field)
     char *processed_field = NULL;
     if (writer->options->no_line_breaks) {
         /* Replace line breaks with spaces */
-        processed_field = str_duplicate(field);
+        processed_field = csv_writer_scratch(writer, len);
         if (processed_field) {
-            for (char *p = processed_field; *p; p++) {
-                if (*p == '\r' || *p == '\n' || *p == '\t') {
-                    *p = ' ';
-                }
+            for (size_t i = 0; i < len; i++) {
+                char c             = field[i];
+                processed_field[i] = (c == '\r' || c == '\n' || c == '\t') ? ' ' : c;
             }
+            field = processed_field;
         }
-        field = processed_field;
     } else if (writer->options->escape_strings) {
         /* Escape control characters */
-        size_t len         = strlen(field);
-        size_t escaped_len = len * 2 + 1; /* Worst case */
-        processed_field    = malloc(escaped_len);
+        size_t escaped_len = len * 2; /* Worst case */
+        processed_field    = csv_writer_scratch(writer, escaped_len);
         if (processed_field) {
             char *dst = processed_field;
-            for (const char *src = field; *src; src++) {
+            for (const char *src = field; src < field + len; src++) {
                 if (*src == '\r') {
                     *dst++ = '\\';
                     *dst++ = 'r';
@@ -144,39 +414,37 @@ int csv_write_field(csvWriter *writer, const char *field)
                     *dst++ = *src;
                 }
             }
-            *dst  = '\0';
+            len   = (size_t)(dst - processed_field);
             field = processed_field;
         }
     }
 
-    bool quote = needs_quoting(field, writer->options, writer->field_count, writer->field_index);
+    bool quote =
+        needs_quoting(field, len, writer->options, writer->field_count, writer->field_index);
 
     if (quote) {
-        fputc('"', writer->fp);
+        out_byte(writer, '"');
     }
 
     /* Write field content, escaping quotes if needed */
     if (writer->options->quoting != QUOTE_NONE) {
-        /* Double quotes for CSV escaping */
-        for (const char *p = field; *p; p++) {
-            if (*p == '"') {
-                fputc('"', writer->fp); /* Double the quote */
-                fputc('"', writer->fp);
-            } else {
-                fputc(*p, writer->fp);
-            }
+        /* Double quotes for CSV escaping: write up to and including each quote, then repeat it */
+        const char *p   = field;
+        const char *end = field + len;
+        const char *q;
+        while ((q = memchr(p, '"', (size_t)(end - p))) != NULL) {
+            out_write(writer, p, (size_t)(q - p) + 1);
+            out_byte(writer, '"');
+            p = q + 1;
         }
+        out_write(writer, p, (size_t)(end - p));
     } else {
         /* No quoting mode - just write as-is */
-        fputs(field, writer->fp);
+        out_write(writer, field, len);
     }
 
     if (quote) {
-        fputc('"', writer->fp);
-    }
-
-    if (processed_field) {
-        free(processed_field);
+        out_byte(writer, '"');
     }
 
     writer->field_index++;
@@ -201,9 +469,88 @@ int csv_write_row(csvWriter *writer, char **fields, int field_count)
         }
     }
 
-    /* Write line terminator */
-    fputs(writer->options->lineterminator, writer->fp);
+    return csv_writer_end_row(writer);
+}
 
+/* Write the line terminator that ends a row */
+int csv_writer_end_row(csvWriter *writer)
+{
+    if (!writer || !writer->fp) {
+        return -1;
+    }
+
+    out_write(writer, writer->options->lineterminator, writer->terminator_len);
+    return writer->failed ? -1 : 0;
+}
+
+/* Write count empty fields, as count calls to csv_write_field with NULL would */
+int csv_write_empty_fields(csvWriter *writer, int count)
+{
+    if (!writer || !writer->fp) {
+        return -1;
+    }
+    if (count <= 0) {
+        return 0;
+    }
+
+    if (writer->field_index == 0) {
+        csv_write_field_as(writer, NULL, 0, CSV_FIELD_UNKNOWN);
+        count--;
+    }
+    writer->field_index += count;
+    return run_block_write(writer,
+                           writer->empty_fields,
+                           writer->empty_fields_len,
+                           writer->empty_field,
+                           writer->empty_field_len,
+                           (size_t)count);
+}
+
+/* Write count empty rows: the line terminator count times */
+int csv_write_empty_rows(csvWriter *writer, int count)
+{
+    if (!writer || !writer->fp) {
+        return -1;
+    }
+    if (count <= 0) {
+        return 0;
+    }
+
+    return run_block_write(writer,
+                           writer->empty_rows,
+                           writer->empty_rows_len,
+                           writer->options->lineterminator,
+                           writer->terminator_len,
+                           (size_t)count);
+}
+
+/* Write unit count times to a stream that has no writer */
+int csv_write_repeated(FILE *fp, const char *unit, size_t count)
+{
+    if (!fp || !unit) {
+        return -1;
+    }
+
+    char   block[CSV_RUN_BLOCK_SIZE];
+    size_t unit_len  = strlen(unit);
+    size_t block_len = run_block_fill(block, unit, unit_len);
+    if (block_len == 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (fwrite(unit, 1, unit_len, fp) != unit_len) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    size_t remaining = count * unit_len;
+    while (remaining > 0) {
+        size_t n = remaining < block_len ? remaining : block_len;
+        if (fwrite(block, 1, n, fp) != n) {
+            return -1;
+        }
+        remaining -= n;
+    }
     return 0;
 }
 
@@ -8,12 +8,31 @@
 /* Forward declaration */
 typedef struct csvWriter csvWriter;
 
+/* How a non-empty field is written, so it can be decided once for repeated values */
+typedef enum {
+    CSV_FIELD_UNKNOWN = 0, /* Not classified yet */
+    CSV_FIELD_PLAIN,       /* Written as is */
+    CSV_FIELD_QUOTED,      /* Written as is between quotes */
+    CSV_FIELD_ENCODE       /* Rewritten: quotes doubled, line breaks replaced or escaped */
+} csvFieldForm;
+
 /* CSV Writer functions */
-csvWriter *csv_writer_create(FILE *fp, xlsxOptions *options);
-void       csv_writer_free(csvWriter *writer);
-int        csv_write_row(csvWriter *writer, char **fields, int field_count);
-int        csv_write_field(csvWriter *writer, const char *field);
-void       csv_writer_reset_row(csvWriter *writer);
-void       csv_writer_set_field_count(csvWriter *writer, int count);
+csvWriter   *csv_writer_create(FILE *fp, xlsxOptions *options);
+void         csv_writer_free(csvWriter *writer);
+int          csv_writer_flush(csvWriter *writer);
+int          csv_write_row(csvWriter *writer, char **fields, int field_count);
+int          csv_write_field(csvWriter *writer, const char *field);
+int          csv_write_field_len(csvWriter *writer, const char *field, size_t len);
+int          csv_write_field_as(csvWriter   *writer,
+                                const char  *field,
+                                size_t       len,
+                                csvFieldForm form);
+csvFieldForm csv_field_form(const xlsxOptions *options, const char *field, size_t len);
+int          csv_write_empty_fields(csvWriter *writer, int count);
+int          csv_write_empty_rows(csvWriter *writer, int count);
+int          csv_write_repeated(FILE *fp, const char *unit, size_t count);
+void         csv_writer_reset_row(csvWriter *writer);
+int          csv_writer_end_row(csvWriter *writer);
+void         csv_writer_set_field_count(csvWriter *writer, int count);
 
 #endif /* _CSV_WRITER_H */
@@ -0,0 +1,348 @@
+/* Double to decimal text without snprintf.
+ *
+ * Every cell that is not an integer goes through "%.15g", and integers and
+ * --sci-float cells through "%.0f" and "%f". glibc's printf parses the format
+ * and runs a multi-precision conversion for each of them; here a finite double
+ * m * 2^-s in the range spreadsheets hold is scaled exactly instead: m * 10^k
+ * fits in 128 bits, so rounding it to the wanted digits is one shift and one
+ * compare, half to even like printf. The text is byte-for-byte what printf
+ * writes. Values outside that range (huge, tiny, subnormal, inf, nan) are rare
+ * and still go to snprintf.
+ *
+ * dtoa_shortest writes the fewest significant digits that read back to the
+ * same double (at most 17), for --shortest-floats. Whether a candidate reads
+ * back is decided exactly against the halfway points to the neighbouring
+ * doubles, so there is no strtod call on the fast path either.
+ */
+
+/* Standard library headers */
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project headers */
+#include "dtoa.h"
+
+__extension__ typedef unsigned __int128 uint128;
+
+/* Range handled without snprintf for the %g forms: every exponent is negative
+ * and m * 10^k stays below 2^128 for the 17 digits dtoa_shortest may need.
+ */
+#define GENERAL_MIN 1e-4
+#define GENERAL_MAX 1e15
+
+static const uint64_t pow10_table[] = {1ULL,
+                                       10ULL,
+                                       100ULL,
+                                       1000ULL,
+                                       10000ULL,
+                                       100000ULL,
+                                       1000000ULL,
+                                       10000000ULL,
+                                       100000000ULL,
+                                       1000000000ULL,
+                                       10000000000ULL,
+                                       100000000000ULL,
+                                       1000000000000ULL,
+                                       10000000000000ULL,
+                                       100000000000000ULL,
+                                       1000000000000000ULL,
+                                       10000000000000000ULL,
+                                       100000000000000000ULL,
+                                       1000000000000000000ULL,
+                                       10000000000000000000ULL};
+
+/* Largest magnitude dtoa_fixed converts itself: the scaled value stays below 10^19 */
+static const double fixed_limit[] = {1e15, 1e15, 1e15, 1e15, 1e15, 1e14, 1e13, 1e12, 1e11, 1e10};
+
+/* 10^k for 0 <= k <= 38 */
+static uint128 pow10_wide(int k)
+{
+    if (k <= 19) {
+        return pow10_table[k];
+    }
+    return (uint128)pow10_table[19] * pow10_table[k - 19];
+}
+
+/* A positive finite double as m * 2^-shift */
+typedef struct {
+    uint64_t mantissa;
+    int      shift;
+    bool     power_of_two; /* The double below is half as far away as the one above */
+} binaryValue;
+
+static binaryValue decompose(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    binaryValue b;
+    uint64_t    fraction = bits & ((1ULL << 52) - 1);
+    int         biased   = (int)((bits >> 52) & 0x7ff);
+
+    if (biased == 0) {
+        b.mantissa     = fraction;
+        b.shift        = 1074;
+        b.power_of_two = false;
+    } else {
+        b.mantissa     = fraction | (1ULL << 52);
+        b.shift        = 1075 - biased;
+        b.power_of_two = fraction == 0 && biased > 1;
+    }
+    return b;
+}
+
+/* m * 10^k / 2^shift rounded half to even; shift > 0 and m * 10^k < 2^127 */
+static uint128 round_scaled(const binaryValue *b, int k)
+{
+    if (b->shift >= 128) {
+        return 0; /* Below one half */
+    }
+
+    uint128 n         = b->mantissa * pow10_wide(k);
+    uint128 quotient  = n >> b->shift;
+    uint128 remainder = n - (quotient << b->shift);
+    uint128 half      = (uint128)1 << (b->shift - 1);
+
+    if (remainder > half || (remainder == half && (quotient & 1))) {
+        quotient++;
+    }
+    return quotient;
+}
+
+/* Whether digits / 10^k reads back as the double b */
+static bool reads_back(const binaryValue *b, uint64_t digits, int k)
+{
+    uint128 scaled = (uint128)digits << (b->shift + 2);
+    uint128 unit   = pow10_wide(k);
+    uint128 center = (uint128)b->mantissa * 4 * unit;
+    uint128 upper  = center + 2 * unit;
+    uint128 lower  = center - (b->power_of_two ? unit : 2 * unit);
+
+    /* Ties round to the even mantissa */
+    if (b->mantissa & 1) {
+        return scaled > lower && scaled < upper;
+    }
+    return scaled >= lower && scaled <= upper;
+}
+
+/* floor(log10(value)) for a positive normal double, from its binary exponent:
+ * the estimate is exact or one too low, which the caller corrects.
+ */
+static int decimal_exponent_estimate(const binaryValue *b)
+{
+    int exponent2 = 52 - b->shift;
+    return (exponent2 * 78913) >> 18;
+}
+
+/* Round value to precision significant digits; sets *exponent to the decimal
+ * exponent of the first digit. value must lie in [GENERAL_MIN, GENERAL_MAX).
+ */
+static uint64_t round_significant(const binaryValue *b, int exponent, int precision,
+                                  int *out_exponent)
+{
+    uint128 digits = round_scaled(b, precision - 1 - exponent);
+
+    if (digits == pow10_wide(precision)) {
+        /* Rounded up to the next power of ten */
+        digits = pow10_wide(precision - 1);
+        exponent++;
+    }
+    *out_exponent = exponent;
+    return (uint64_t)digits;
+}
+
+/* Exact floor(log10(value)) for value in [GENERAL_MIN, GENERAL_MAX) */
+static int decimal_exponent(const binaryValue *b)
+{
+    int exponent = decimal_exponent_estimate(b);
+
+    /* value >= 10^(exponent + 1) iff floor(value * 10^(14 - exponent)) >= 10^15 */
+    uint128 n = b->mantissa * pow10_wide(14 - exponent);
+    if ((n >> b->shift) >= pow10_wide(15)) {
+        exponent++;
+    }
+    return exponent;
+}
+
+/* Write a '-' if negative and the digits as %g lays them out for this precision:
+ * fixed notation for exponents in [-4, precision), d.ddde+XX otherwise,
+ * trailing zeros removed.
+ */
+static int layout_general(bool negative, uint64_t digits, int count, int exponent, int precision,
+                          char *buffer)
+{
+    char text[20];
+    for (int i = count - 1; i >= 0; i--) {
+        text[i] = (char)('0' + digits % 10);
+        digits /= 10;
+    }
+    while (count > 1 && text[count - 1] == '0') {
+        count--;
+    }
+
+    char *p = buffer;
+    if (negative) {
+        *p++ = '-';
+    }
+
+    if (exponent < -4 || exponent >= precision) {
+        *p++ = text[0];
+        if (count > 1) {
+            *p++ = '.';
+            memcpy(p, text + 1, (size_t)(count - 1));
+            p += count - 1;
+        }
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+
+        int magnitude = abs(exponent);
+        if (magnitude >= 100) {
+            *p++ = (char)('0' + magnitude / 100);
+        }
+        *p++ = (char)('0' + magnitude / 10 % 10);
+        *p++ = (char)('0' + magnitude % 10);
+    } else if (exponent >= 0) {
+        int integer_digits = exponent + 1;
+        for (int i = 0; i < integer_digits; i++) {
+            *p++ = i < count ? text[i] : '0';
+        }
+        if (count > integer_digits) {
+            *p++ = '.';
+            memcpy(p, text + integer_digits, (size_t)(count - integer_digits));
+            p += count - integer_digits;
+        }
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > exponent; i--) {
+            *p++ = '0';
+        }
+        memcpy(p, text, (size_t)count);
+        p += count;
+    }
+
+    *p = '\0';
+    return (int)(p - buffer);
+}
+
+static int write_zero(double value, char *buffer)
+{
+    if (signbit(value)) {
+        memcpy(buffer, "-0", 3);
+        return 2;
+    }
+    memcpy(buffer, "0", 2);
+    return 1;
+}
+
+int dtoa_general(double value, char *buffer)
+{
+    if (value == 0.0) {
+        return write_zero(value, buffer);
+    }
+
+    double magnitude = fabs(value);
+    if (!(magnitude >= GENERAL_MIN && magnitude < GENERAL_MAX)) {
+        return snprintf(buffer, DTOA_BUFFER_SIZE, "%.15g", value);
+    }
+
+    binaryValue b = decompose(magnitude);
+    int         exponent;
+    uint64_t    digits = round_significant(&b, decimal_exponent(&b), 15, &exponent);
+
+    return layout_general(signbit(value), digits, 15, exponent, 15, buffer);
+}
+
+/* Shortest form by trying precisions with snprintf and reading each back.
+ * For a normal double the 15 digit rounding is the shortest whenever anything
+ * that short reads back; subnormals carry less precision, so start from one digit.
+ */
+static int shortest_slow(double value, char *buffer)
+{
+    char text[DTOA_BUFFER_SIZE];
+    int  len = 0;
+    for (int precision = fabs(value) < DBL_MIN ? 1 : 15; precision <= 17; precision++) {
+        len = snprintf(text, sizeof(text), "%.*g", precision, value);
+        if (strtod(text, NULL) == value) {
+            break;
+        }
+    }
+    memcpy(buffer, text, (size_t)len + 1);
+    return len;
+}
+
+int dtoa_shortest(double value, char *buffer)
+{
+    if (value == 0.0) {
+        return write_zero(value, buffer);
+    }
+
+    double magnitude = fabs(value);
+    if (!(magnitude >= GENERAL_MIN && magnitude < GENERAL_MAX)) {
+        return shortest_slow(value, buffer);
+    }
+
+    /* If the 15 digit rounding reads back, no shorter string is closer, so it
+     * is the shortest once its trailing zeros are gone. Otherwise one of 16 or
+     * 17 digits is, and 17 always is.
+     */
+    binaryValue b     = decompose(magnitude);
+    int         first = decimal_exponent(&b);
+
+    for (int precision = 15; precision <= 17; precision++) {
+        int      exponent;
+        uint64_t digits = round_significant(&b, first, precision, &exponent);
+
+        if (precision == 17 || reads_back(&b, digits, precision - 1 - exponent)) {
+            return layout_general(signbit(value), digits, precision, exponent, 17, buffer);
+        }
+    }
+    return shortest_slow(value, buffer);
+}
+
+int dtoa_fixed(double value, int decimals, char *buffer)
+{
+    double magnitude = fabs(value);
+    if (decimals < 0 || decimals > 9 || !(magnitude < fixed_limit[decimals])) {
+        return snprintf(buffer, DTOA_BUFFER_SIZE, "%.*f", decimals, value);
+    }
+
+    char     *p = buffer;
+    uint64_t  digits;
+    if (magnitude == 0.0) {
+        digits = 0;
+    } else {
+        binaryValue b = decompose(magnitude);
+        digits        = (uint64_t)round_scaled(&b, decimals);
+    }
+
+    if (signbit(value)) {
+        *p++ = '-';
+    }
+
+    /* At least one integer digit before the decimals */
+    char text[24];
+    int  count = 0;
+    do {
+        text[count++] = (char)('0' + digits % 10);
+        digits /= 10;
+    } while (digits || count <= decimals);
+
+    while (count > decimals) {
+        *p++ = text[--count];
+    }
+    if (decimals > 0) {
+        *p++ = '.';
+        while (count > 0) {
+            *p++ = text[--count];
+        }
+    }
+
+    *p = '\0';
+    return (int)(p - buffer);
+}
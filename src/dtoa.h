@@ -0,0 +1,14 @@
+#ifndef _DTOA_H
+#define _DTOA_H
+
+/* Fits every form written below, "%.9f" of -DBL_MAX included */
+#define DTOA_BUFFER_SIZE 328
+
+/* Double to text without snprintf on the common path. Each writes a
+ * NUL-terminated string into buffer (DTOA_BUFFER_SIZE bytes) and returns its length.
+ */
+int dtoa_general(double value, char *buffer);             /* Same text as "%.15g" */
+int dtoa_shortest(double value, char *buffer);            /* Fewest digits that read back */
+int dtoa_fixed(double value, int decimals, char *buffer); /* Same text as "%.*f", 0-9 decimals */
+
+#endif /* _DTOA_H */
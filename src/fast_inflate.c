@@ -0,0 +1,542 @@
+/* Whole-buffer DEFLATE (RFC 1951) decoder.
+ *
+ * Unlike zlib's streaming inflate, this decoder is only used when the entire
+ * compressed stream is in memory and the uncompressed size is known (ZIP
+ * entries always record it). That removes all window management and lets the
+ * hot loop run with a single bit-buffer refill per symbol:
+ *
+ * - 64-bit bit buffer refilled with one unaligned 8-byte load
+ * - Primary Huffman lookup tables that resolve a symbol, its extra bit count
+ *   and its base value in one load; the rare longer codes are decoded
+ *   canonically bit by bit
+ * - Match copies done 8 bytes at a time when the output has room to spare
+ */
+
+/* Standard library headers */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Project headers */
+#include "fast_inflate.h"
+
+#define MAX_CODE_LEN 15
+
+#define NUM_LITLEN_SYMS  288
+#define NUM_DIST_SYMS    32
+#define NUM_PRECODE_SYMS 19
+
+#define LITLEN_TABLE_BITS  10
+#define DIST_TABLE_BITS    8
+#define PRECODE_TABLE_BITS 7
+
+/* Table entry layout:
+ * bits 0-3   number of code bits (0 = not in the primary table, decode slowly)
+ * bits 4-7   number of extra bits following the code
+ * bits 8-9   entry type
+ * bits 16-31 literal byte, length base, distance base or precode symbol
+ */
+#define ENTRY(value, type, extra) (((uint32_t)(value) << 16) | ((type) << 8) | ((extra) << 4))
+#define ENTRY_CODE_BITS(e)        ((e)&0xF)
+#define ENTRY_EXTRA_BITS(e)       (((e) >> 4) & 0xF)
+#define ENTRY_TYPE(e)             (((e) >> 8) & 0x3)
+#define ENTRY_VALUE(e)            ((e) >> 16)
+
+#define TYPE_LITERAL 0 /* Also used for distances and precode symbols */
+#define TYPE_LENGTH  1
+#define TYPE_END     2
+#define TYPE_INVALID 3
+
+/* Canonical Huffman code: primary table plus data for slow decoding */
+typedef struct {
+    uint32_t       *table;
+    unsigned        table_bits;
+    const uint32_t *symbol_entries;
+    uint16_t        count[MAX_CODE_LEN + 1];
+    uint16_t        sorted[NUM_LITLEN_SYMS];
+} huffmanCode;
+
+/* Decoder state */
+typedef struct {
+    const unsigned char *in_next;
+    const unsigned char *in_end;
+    size_t               overrun; /* Zero bytes supplied past the end of input */
+    uint64_t             bitbuf;
+    unsigned             bitsleft;
+
+    uint32_t    litlen_table[1u << LITLEN_TABLE_BITS];
+    uint32_t    dist_table[1u << DIST_TABLE_BITS];
+    uint32_t    precode_table[1u << PRECODE_TABLE_BITS];
+    huffmanCode litlen;
+    huffmanCode dist;
+    huffmanCode precode;
+} inflateState;
+
+static uint32_t litlen_entries[NUM_LITLEN_SYMS];
+static uint32_t dist_entries[NUM_DIST_SYMS];
+static uint32_t precode_entries[NUM_PRECODE_SYMS];
+static bool     entries_ready = false;
+
+static const uint16_t length_base[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                                         15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                                         67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t  length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                          2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t dist_base[30]    = {1,    2,    3,    4,    5,    7,     9,     13,
+                                          17,   25,   33,   49,   65,   97,    129,   193,
+                                          257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                          4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t  dist_extra[30]   = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                          6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t  precode_order[NUM_PRECODE_SYMS] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                                         11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+/* Per-symbol table entries (without code length), built once */
+static void init_symbol_entries(void)
+{
+    if (entries_ready) {
+        return;
+    }
+
+    for (unsigned sym = 0; sym < 256; sym++) {
+        litlen_entries[sym] = ENTRY(sym, TYPE_LITERAL, 0u);
+    }
+    litlen_entries[256] = ENTRY(0u, TYPE_END, 0u);
+    for (unsigned i = 0; i < 29; i++) {
+        litlen_entries[257 + i] = ENTRY(length_base[i], TYPE_LENGTH, (unsigned)length_extra[i]);
+    }
+    litlen_entries[286] = ENTRY(0u, TYPE_INVALID, 0u);
+    litlen_entries[287] = ENTRY(0u, TYPE_INVALID, 0u);
+
+    for (unsigned i = 0; i < 30; i++) {
+        dist_entries[i] = ENTRY(dist_base[i], TYPE_LITERAL, (unsigned)dist_extra[i]);
+    }
+    dist_entries[30] = ENTRY(0u, TYPE_INVALID, 0u);
+    dist_entries[31] = ENTRY(0u, TYPE_INVALID, 0u);
+
+    for (unsigned sym = 0; sym < NUM_PRECODE_SYMS; sym++) {
+        precode_entries[sym] = ENTRY(sym, TYPE_LITERAL, 0u);
+    }
+
+    entries_ready = true;
+}
+
+static uint64_t load_u64_le(const unsigned char *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#else
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+#endif
+}
+
+/* Top up the bit buffer to at least 56 bits */
+static inline void refill(inflateState *s)
+{
+    if (s->in_end - s->in_next >= 8) {
+        /* Bits above bitsleft are the next input bits, so reloading them is harmless */
+        s->bitbuf |= load_u64_le(s->in_next) << s->bitsleft;
+        s->in_next += (63 - s->bitsleft) >> 3;
+        s->bitsleft |= 56;
+        return;
+    }
+
+    while (s->bitsleft <= 56) {
+        uint64_t byte = 0;
+        if (s->in_next < s->in_end) {
+            byte = *s->in_next++;
+        } else {
+            s->overrun++;
+        }
+        s->bitbuf |= byte << s->bitsleft;
+        s->bitsleft += 8;
+    }
+}
+
+static inline void consume(inflateState *s, unsigned n)
+{
+    s->bitbuf >>= n;
+    s->bitsleft -= n;
+}
+
+/* Read n (<= 32) bits, refilling first if needed */
+static uint32_t read_bits(inflateState *s, unsigned n)
+{
+    if (s->bitsleft < n) {
+        refill(s);
+    }
+    uint32_t v = (uint32_t)(s->bitbuf & ((1ull << n) - 1));
+    consume(s, n);
+    return v;
+}
+
+/* True if decoding has consumed bits that were never in the input */
+static bool input_exhausted(const inflateState *s)
+{
+    return s->overrun > (s->bitsleft >> 3);
+}
+
+/* Build primary table and canonical decoding data from code lengths */
+static int build_code(huffmanCode *code, const uint8_t *lens, unsigned num_syms)
+{
+    uint16_t offsets[MAX_CODE_LEN + 2];
+    uint32_t next_code[MAX_CODE_LEN + 1];
+
+    memset(code->count, 0, sizeof(code->count));
+    for (unsigned sym = 0; sym < num_syms; sym++) {
+        code->count[lens[sym]]++;
+    }
+    code->count[0] = 0;
+
+    /* Reject over-subscribed codes; incomplete ones decode until an unused code appears */
+    int32_t left = 1;
+    for (unsigned len = 1; len <= MAX_CODE_LEN; len++) {
+        left = (left << 1) - code->count[len];
+        if (left < 0) {
+            return -1;
+        }
+    }
+
+    offsets[1] = 0;
+    for (unsigned len = 1; len <= MAX_CODE_LEN; len++) {
+        offsets[len + 1] = (uint16_t)(offsets[len] + code->count[len]);
+    }
+
+    uint32_t next = 0;
+    for (unsigned len = 1; len <= MAX_CODE_LEN; len++) {
+        next            = (next + code->count[len - 1]) << 1;
+        next_code[len]  = next;
+    }
+
+    size_t table_size = (size_t)1 << code->table_bits;
+    memset(code->table, 0, table_size * sizeof(uint32_t));
+
+    for (unsigned sym = 0; sym < num_syms; sym++) {
+        unsigned len = lens[sym];
+        if (len == 0) {
+            continue;
+        }
+        code->sorted[offsets[len]++] = (uint16_t)sym;
+
+        uint32_t codeword = next_code[len]++;
+        if (len > code->table_bits) {
+            continue;
+        }
+
+        /* DEFLATE packs Huffman codes most significant bit first into an LSB-first stream */
+        uint32_t reversed = 0;
+        for (unsigned i = 0; i < len; i++) {
+            reversed = (reversed << 1) | ((codeword >> i) & 1);
+        }
+
+        uint32_t entry = code->symbol_entries[sym] | len;
+        for (size_t i = reversed; i < table_size; i += (size_t)1 << len) {
+            code->table[i] = entry;
+        }
+    }
+
+    return 0;
+}
+
+/* Decode a symbol whose code is longer than the primary table (or invalid) */
+static uint32_t decode_slow(const huffmanCode *code, uint64_t bits)
+{
+    int32_t codeword = 0;
+    int32_t first    = 0;
+    int32_t index    = 0;
+
+    for (unsigned len = 1; len <= MAX_CODE_LEN; len++) {
+        codeword |= (int32_t)(bits & 1);
+        bits >>= 1;
+
+        int32_t count = code->count[len];
+        if (codeword - first < count) {
+            return code->symbol_entries[code->sorted[index + codeword - first]] | len;
+        }
+        index += count;
+        first = (first + count) << 1;
+        codeword <<= 1;
+    }
+
+    return ENTRY(0u, TYPE_INVALID, 0u);
+}
+
+/* Decode one symbol; bit buffer must hold at least MAX_CODE_LEN bits */
+static inline uint32_t decode_symbol(inflateState *s, const huffmanCode *code)
+{
+    uint32_t entry = code->table[s->bitbuf & ((1u << code->table_bits) - 1)];
+    if (ENTRY_CODE_BITS(entry) == 0) {
+        entry = decode_slow(code, s->bitbuf);
+        if (ENTRY_TYPE(entry) == TYPE_INVALID && ENTRY_CODE_BITS(entry) == 0) {
+            return entry;
+        }
+    }
+    consume(s, ENTRY_CODE_BITS(entry));
+    return entry;
+}
+
+/* Fixed Huffman codes (BTYPE 01) */
+static int build_fixed_codes(inflateState *s)
+{
+    uint8_t lens[NUM_LITLEN_SYMS + NUM_DIST_SYMS];
+    unsigned i = 0;
+    for (; i < 144; i++) {
+        lens[i] = 8;
+    }
+    for (; i < 256; i++) {
+        lens[i] = 9;
+    }
+    for (; i < 280; i++) {
+        lens[i] = 7;
+    }
+    for (; i < NUM_LITLEN_SYMS; i++) {
+        lens[i] = 8;
+    }
+    for (; i < NUM_LITLEN_SYMS + NUM_DIST_SYMS; i++) {
+        lens[i] = 5;
+    }
+
+    if (build_code(&s->litlen, lens, NUM_LITLEN_SYMS) < 0) {
+        return -1;
+    }
+    return build_code(&s->dist, lens + NUM_LITLEN_SYMS, NUM_DIST_SYMS);
+}
+
+/* Dynamic Huffman codes (BTYPE 10) */
+static int read_dynamic_codes(inflateState *s)
+{
+    unsigned num_litlen  = read_bits(s, 5) + 257;
+    unsigned num_dist    = read_bits(s, 5) + 1;
+    unsigned num_precode = read_bits(s, 4) + 4;
+
+    if (num_litlen > 286 || num_dist > 30) {
+        return -1;
+    }
+
+    uint8_t precode_lens[NUM_PRECODE_SYMS] = {0};
+    for (unsigned i = 0; i < num_precode; i++) {
+        precode_lens[precode_order[i]] = (uint8_t)read_bits(s, 3);
+    }
+    if (build_code(&s->precode, precode_lens, NUM_PRECODE_SYMS) < 0) {
+        return -1;
+    }
+
+    uint8_t  lens[NUM_LITLEN_SYMS + NUM_DIST_SYMS] = {0};
+    unsigned total                                 = num_litlen + num_dist;
+    unsigned i                                     = 0;
+    while (i < total) {
+        refill(s);
+        uint32_t entry = decode_symbol(s, &s->precode);
+        if (ENTRY_TYPE(entry) == TYPE_INVALID) {
+            return -1;
+        }
+
+        unsigned sym = ENTRY_VALUE(entry);
+        if (sym < 16) {
+            lens[i++] = (uint8_t)sym;
+            continue;
+        }
+
+        uint8_t  value  = 0;
+        unsigned repeat = 0;
+        if (sym == 16) {
+            if (i == 0) {
+                return -1;
+            }
+            value  = lens[i - 1];
+            repeat = 3 + read_bits(s, 2);
+        } else if (sym == 17) {
+            repeat = 3 + read_bits(s, 3);
+        } else {
+            repeat = 11 + read_bits(s, 7);
+        }
+
+        if (repeat > total - i) {
+            return -1;
+        }
+        memset(lens + i, value, repeat);
+        i += repeat;
+    }
+
+    if (input_exhausted(s) || lens[256] == 0) {
+        return -1;
+    }
+
+    /* Literal/length and distance lengths may not be split across the two arrays */
+    uint8_t dist_lens[NUM_DIST_SYMS] = {0};
+    memcpy(dist_lens, lens + num_litlen, num_dist);
+    memset(lens + num_litlen, 0, NUM_LITLEN_SYMS - num_litlen);
+
+    if (build_code(&s->litlen, lens, NUM_LITLEN_SYMS) < 0) {
+        return -1;
+    }
+    return build_code(&s->dist, dist_lens, NUM_DIST_SYMS);
+}
+
+/* Copy a match of length bytes from distance bytes back */
+static inline void copy_match(unsigned char *out,
+                              const unsigned char *out_end,
+                              size_t               distance,
+                              size_t               length)
+{
+    const unsigned char *src = out - distance;
+
+    if (distance >= 8 && (size_t)(out_end - out) >= length + 8) {
+        /* Word copies may run a little past the match; those bytes are rewritten later */
+        unsigned char *end = out + length;
+        while (out < end) {
+            memcpy(out, src, 8);
+            out += 8;
+            src += 8;
+        }
+    } else if (distance == 1) {
+        memset(out, *src, length);
+    } else {
+        for (size_t i = 0; i < length; i++) {
+            out[i] = src[i];
+        }
+    }
+}
+
+/* Decode the body of a Huffman-coded block */
+static int decode_block(inflateState *s, unsigned char **out_ptr, unsigned char *out_begin,
+                        unsigned char *out_end)
+{
+    unsigned char *out = *out_ptr;
+
+    while (1) {
+        /* One refill covers code + extra bits of both a length and a distance */
+        refill(s);
+
+        uint32_t entry = decode_symbol(s, &s->litlen);
+        unsigned type  = ENTRY_TYPE(entry);
+
+        if (type == TYPE_LITERAL) {
+            if (out == out_end) {
+                return -1;
+            }
+            *out++ = (unsigned char)ENTRY_VALUE(entry);
+            continue;
+        }
+        if (type == TYPE_END) {
+            break;
+        }
+        if (type == TYPE_INVALID) {
+            return -1;
+        }
+
+        unsigned extra  = ENTRY_EXTRA_BITS(entry);
+        size_t   length = ENTRY_VALUE(entry) + (size_t)(s->bitbuf & ((1u << extra) - 1));
+        consume(s, extra);
+
+        entry = decode_symbol(s, &s->dist);
+        if (ENTRY_TYPE(entry) == TYPE_INVALID) {
+            return -1;
+        }
+        extra           = ENTRY_EXTRA_BITS(entry);
+        size_t distance = ENTRY_VALUE(entry) + (size_t)(s->bitbuf & ((1u << extra) - 1));
+        consume(s, extra);
+
+        if (distance > (size_t)(out - out_begin) || length > (size_t)(out_end - out)) {
+            return -1;
+        }
+        copy_match(out, out_end, distance, length);
+        out += length;
+    }
+
+    *out_ptr = out;
+    return input_exhausted(s) ? -1 : 0;
+}
+
+/* Copy an uncompressed block (BTYPE 00) */
+static int copy_stored_block(inflateState *s, unsigned char **out_ptr, unsigned char *out_end)
+{
+    /* Drop to a byte boundary and hand unread whole bytes back to the input */
+    consume(s, s->bitsleft & 7);
+    size_t unread = s->bitsleft >> 3;
+    if (s->overrun > unread) {
+        return -1;
+    }
+    s->in_next -= unread - s->overrun;
+    s->overrun  = 0;
+    s->bitbuf   = 0;
+    s->bitsleft = 0;
+
+    if (s->in_end - s->in_next < 4) {
+        return -1;
+    }
+    size_t len  = (size_t)s->in_next[0] | ((size_t)s->in_next[1] << 8);
+    size_t nlen = (size_t)s->in_next[2] | ((size_t)s->in_next[3] << 8);
+    s->in_next += 4;
+
+    if (len != (~nlen & 0xFFFF) || len > (size_t)(s->in_end - s->in_next) ||
+        len > (size_t)(out_end - *out_ptr)) {
+        return -1;
+    }
+
+    memcpy(*out_ptr, s->in_next, len);
+    *out_ptr += len;
+    s->in_next += len;
+    return 0;
+}
+
+/* Decode a complete raw DEFLATE stream of known uncompressed size */
+int fast_inflate(const unsigned char *src, size_t src_len, unsigned char *dst, size_t dst_len)
+{
+    init_symbol_entries();
+
+    inflateState s;
+    s.in_next  = src;
+    s.in_end   = src + src_len;
+    s.overrun  = 0;
+    s.bitbuf   = 0;
+    s.bitsleft = 0;
+
+    s.litlen.table           = s.litlen_table;
+    s.litlen.table_bits      = LITLEN_TABLE_BITS;
+    s.litlen.symbol_entries  = litlen_entries;
+    s.dist.table             = s.dist_table;
+    s.dist.table_bits        = DIST_TABLE_BITS;
+    s.dist.symbol_entries    = dist_entries;
+    s.precode.table          = s.precode_table;
+    s.precode.table_bits     = PRECODE_TABLE_BITS;
+    s.precode.symbol_entries = precode_entries;
+
+    unsigned char *out     = dst;
+    unsigned char *out_end = dst + dst_len;
+    bool           final   = false;
+
+    while (!final) {
+        final          = read_bits(&s, 1) != 0;
+        uint32_t btype = read_bits(&s, 2);
+
+        int status;
+        if (btype == 0) {
+            status = copy_stored_block(&s, &out, out_end);
+        } else if (btype == 1) {
+            status = build_fixed_codes(&s);
+            if (status == 0) {
+                status = decode_block(&s, &out, dst, out_end);
+            }
+        } else if (btype == 2) {
+            status = read_dynamic_codes(&s);
+            if (status == 0) {
+                status = decode_block(&s, &out, dst, out_end);
+            }
+        } else {
+            status = -1;
+        }
+
+        if (status < 0 || input_exhausted(&s)) {
+            return -1;
+        }
+    }
+
+    return out == out_end ? 0 : -1;
+}
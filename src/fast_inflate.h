@@ -0,0 +1,12 @@
+#ifndef _FAST_INFLATE_H
+#define _FAST_INFLATE_H
+
+#include <stddef.h>
+
+/* Decode a complete raw DEFLATE stream whose uncompressed size is known.
+ * The whole output must fit in dst; returns 0 only if exactly dst_len bytes
+ * were produced by a well-formed stream, -1 otherwise.
+ */
+int fast_inflate(const unsigned char *src, size_t src_len, unsigned char *dst, size_t dst_len);
+
+#endif /* _FAST_INFLATE_H */
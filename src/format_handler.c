@@ -6,7 +6,11 @@
 #include <string.h>
 
 /* Project headers */
+#include "dtoa.h"
 #include "format_handler.h"
+#include "number_format.h"
+#include "number_parse.h"
+#include "shared_strings.h"
 #include "utils.h"
 #include "xlsx2csv.h"
 
@@ -103,96 +107,215 @@ static formatType get_format_type_from_string(const char *format_str)
     return FORMAT_FLOAT;
 }
 
-/* Get format type by style ID */
-formatType get_format_type(int style_id, styleInfo *styles)
+/* Built-in number formats; numeric ones are also applied to floats. The codes
+ * are lowercased as the Python version matches them; excel has the spelling
+ * Excel renders where it differs.
+ */
+static const struct {
+    int         id;
+    const char *format;
+    bool        numeric;
+    const char *excel;
+} standard_formats[] = {
+    {0,  "general",                  true,  NULL           },
+    {1,  "0",                        true,  NULL           },
+    {2,  "0.00",                     true,  NULL           },
+    {3,  "#,##0",                    true,  NULL           },
+    {4,  "#,##0.00",                 true,  NULL           },
+    {9,  "0%",                       true,  NULL           },
+    {10, "0.00%",                    true,  NULL           },
+    {11, "0.00e+00",                 true,  "0.00E+00"     },
+    {14, "mm-dd-yy",                 false, NULL           },
+    {15, "d-mmm-yy",                 false, NULL           },
+    {16, "d-mmm",                    false, NULL           },
+    {17, "mmm-yy",                   false, NULL           },
+    {18, "h:mm am/pm",               false, "h:mm AM/PM"   },
+    {19, "h:mm:ss am/pm",            false, "h:mm:ss AM/PM"},
+    {20, "h:mm",                     false, NULL           },
+    {21, "h:mm:ss",                  false, NULL           },
+    {22, "m/d/yy h:mm",              false, NULL           },
+    {37, "#,##0 ;(#,##0)",           true,  NULL           },
+    {38, "#,##0 ;[red](#,##0)",      true,  NULL           },
+    {39, "#,##0.00;(#,##0.00)",      true,  NULL           },
+    {40, "#,##0.00;[red](#,##0.00)", true,  NULL           },
+    {45, "mm:ss",                    false, NULL           },
+    {46, "[h]:mm:ss",                false, NULL           },
+    {47, "mmss.0",                   false, NULL           },
+    {48, "##0.0e+0",                 true,  "##0.0E+0"     },
+    {49, "@",                        false, NULL           }
+};
+
+/* Style of cells whose style ID is out of range: left as they are */
+static const cellStyle unstyled = {FORMAT_STRING, NULL, NULL, 0, NULL};
+
+#define STANDARD_FORMAT_COUNT (int)(sizeof(standard_formats) / sizeof(standard_formats[0]))
+
+/* Whether a date format also shows the time of day */
+static bool date_format_has_time(const char *format)
 {
-    if (!styles || style_id < 0 || style_id >= styles->cell_xfs_count) {
-        return FORMAT_STRING;
+    if (!format) {
+        return false;
     }
 
-    int fmt_id = styles->cell_xfs[style_id];
+    /* Hours or seconds are clear time indicators, but only count next to a date
+     * (m/M alone is a month, and only a minute next to h or s)
+     */
+    bool has_time = strstr(format, "H") || strstr(format, "h") || strstr(format, "S") ||
+                    strstr(format, "s");
+    bool has_date = strstr(format, "Y") || strstr(format, "y") || strstr(format, "D") ||
+                    strstr(format, "d");
+    return has_time && has_date;
+}
 
-    /* Check custom formats */
+/* Resolve the number format fmt_id of a cellXfs entry */
+static void resolve_style(const styleInfo *styles, int fmt_id, cellStyle *style)
+{
+    int custom = -1;
     for (int i = 0; i < styles->format_count; i++) {
         if (styles->formats[i].id == fmt_id) {
-            return get_format_type_from_string(styles->formats[i].format_code);
+            custom = i;
+            break;
         }
     }
 
-    /* Check standard formats */
-    const char *std_format = NULL;
-    static const struct {
-        int         id;
-        const char *format;
-    } standard_formats[] = {
-        {0,  "general"                 },
-        {1,  "0"                       },
-        {2,  "0.00"                    },
-        {3,  "#,##0"                   },
-        {4,  "#,##0.00"                },
-        {9,  "0%"                      },
-        {10, "0.00%"                   },
-        {11, "0.00e+00"                },
-        {14, "mm-dd-yy"                },
-        {15, "d-mmm-yy"                },
-        {16, "d-mmm"                   },
-        {17, "mmm-yy"                  },
-        {18, "h:mm am/pm"              },
-        {19, "h:mm:ss am/pm"           },
-        {20, "h:mm"                    },
-        {21, "h:mm:ss"                 },
-        {22, "m/d/yy h:mm"             },
-        {37, "#,##0 ;(#,##0)"          },
-        {38, "#,##0 ;[red](#,##0)"     },
-        {39, "#,##0.00;(#,##0.00)"     },
-        {40, "#,##0.00;[red](#,##0.00)"},
-        {45, "mm:ss"                   },
-        {46, "[h]:mm:ss"               },
-        {47, "mmss.0"                  },
-        {48, "##0.0e+0"                },
-        {49, "@"                       }
-    };
-
-    for (size_t i = 0; i < sizeof(standard_formats) / sizeof(standard_formats[0]); i++) {
+    int standard = -1;
+    for (int i = 0; i < STANDARD_FORMAT_COUNT; i++) {
         if (standard_formats[i].id == fmt_id) {
-            std_format = standard_formats[i].format;
+            standard = i;
             break;
         }
     }
 
-    if (std_format) {
-        return get_format_type_from_string(std_format);
+    memset(style, 0, sizeof(*style));
+    if (custom >= 0) {
+        style->type        = styles->formats[custom].type;
+        style->format_code = styles->formats[custom].format_code;
+    } else {
+        style->type = standard >= 0 ? get_format_type_from_string(standard_formats[standard].format)
+                                    : FORMAT_FLOAT;
     }
 
-    return FORMAT_FLOAT;
+    /* Programs hold the custom formats first, then the built-in ones */
+    if (styles->programs && custom >= 0) {
+        style->program = styles->programs[custom];
+    } else if (styles->programs && standard >= 0) {
+        style->program = styles->programs[styles->format_count + standard];
+    }
+
+    /* Floats fall back to the built-in code when a custom format has none */
+    style->float_code = style->format_code;
+    if (!style->float_code && standard >= 0 && standard_formats[standard].numeric) {
+        style->float_code = standard_formats[standard].format;
+    }
+
+    const char *code = style->float_code;
+    if (code && (strcmp(code, "0") == 0 || strcmp(code, "0.00") == 0 ||
+                 strcmp(code, "0.00E+00") == 0 || strcmp(code, "0.00e+00") == 0 ||
+                 strncmp(code, "#,##0", 5) == 0)) {
+        style->flags |= STYLE_FLOAT_STANDARD;
+    }
+    if (code && strncmp(code, "0.0", 3) == 0) {
+        style->flags |= STYLE_FLOAT_DECIMALS;
+    }
+    if (style->format_code && strncmp(style->format_code, "0.0", 3) == 0) {
+        style->flags |= STYLE_PERCENT_DECIMALS;
+    }
+    if (date_format_has_time(style->format_code)) {
+        style->flags |= STYLE_DATE_TIME;
+    }
 }
 
-/* Format date value */
-char *format_date(double value, const char *format, bool date1904)
+/* Compile every custom and built-in format once */
+static int styles_compile(styleInfo *styles)
+{
+    int count        = styles->format_count + STANDARD_FORMAT_COUNT;
+    styles->programs = calloc((size_t)count, sizeof(numberFormat *));
+    if (!styles->programs) {
+        return -1;
+    }
+    styles->program_count = count;
+
+    for (int i = 0; i < count; i++) {
+        const char *code = NULL;
+        if (i < styles->format_count) {
+            code = styles->formats[i].format_code;
+        } else {
+            int standard = i - styles->format_count;
+            code         = standard_formats[standard].excel ? standard_formats[standard].excel
+                                                            : standard_formats[standard].format;
+        }
+        styles->programs[i] = number_format_compile(code);
+    }
+    return 0;
+}
+
+/* Resolve every cellXfs entry once, so a cell only needs one lookup; compile
+ * the number formats too if they are going to be rendered
+ */
+int styles_resolve(styleInfo *styles, bool compile)
+{
+    for (int i = 0; i < styles->format_count; i++) {
+        styles->formats[i].type = get_format_type_from_string(styles->formats[i].format_code);
+    }
+
+    if (compile && !styles->programs && styles_compile(styles) < 0) {
+        return -1;
+    }
+
+    free(styles->cell_styles);
+    styles->cell_styles = NULL;
+    if (styles->cell_xfs_count == 0) {
+        return 0;
+    }
+    styles->cell_styles = malloc((size_t)styles->cell_xfs_count * sizeof(cellStyle));
+    if (!styles->cell_styles) {
+        return -1;
+    }
+    for (int i = 0; i < styles->cell_xfs_count; i++) {
+        resolve_style(styles, styles->cell_xfs[i], &styles->cell_styles[i]);
+    }
+    return 0;
+}
+
+/* Resolved style of a cell */
+static const cellStyle *cell_style(const styleInfo *styles, int style_id)
+{
+    if (!styles->cell_styles || style_id < 0 || style_id >= styles->cell_xfs_count) {
+        return &unstyled;
+    }
+    return &styles->cell_styles[style_id];
+}
+
+/* Get format type by style ID */
+formatType get_format_type(int style_id, styleInfo *styles)
+{
+    return styles ? cell_style(styles, style_id)->type : FORMAT_STRING;
+}
+
+/* Free the styles and what was resolved from them */
+void styles_free(styleInfo *styles)
+{
+    for (int i = 0; i < styles->format_count; i++) {
+        free(styles->formats[i].format_code);
+    }
+    for (int i = 0; i < styles->program_count; i++) {
+        number_format_free(styles->programs[i]);
+    }
+    free(styles->formats);
+    free(styles->cell_xfs);
+    free(styles->cell_styles);
+    free(styles->programs);
+    memset(styles, 0, sizeof(*styles));
+}
+
+/* Format an Excel serial date, with the time of day if with_time is set */
+static int format_serial_date(double value, bool with_time, bool date1904, char *buffer)
 {
     /* Excel date: days since 1900-01-01 (or 1904-01-01 if date1904)
      * Note: Excel has a bug where it thinks 1900 was a leap year
      * For dates after 1900-02-28, we need to subtract 1 day to compensate
      */
 
-    /* Check if format contains both date and time components
-     * In Excel formats:
-     * - H/h = hours (time component)
-     * - S/s = seconds (time component)
-     * - m/M near h/H = minutes (time component)
-     * - m/M alone = months (date component)
-     */
-    bool has_time_component = false;
-    if (format) {
-        /* Check for hours or seconds (clear time indicators) */
-        has_time_component = strstr(format, "H") || strstr(format, "h") || strstr(format, "S") ||
-                             strstr(format, "s");
-        /* But only if it also has date components */
-        bool has_date_component = strstr(format, "Y") || strstr(format, "y") ||
-                                  strstr(format, "D") || strstr(format, "d");
-        has_time_component = has_time_component && has_date_component;
-    }
-
     /* Convert Excel serial date to year, month, day
      * Excel uses 1900-01-01 as day 1, with a leap year bug
      * Python xlsx2csv uses 1899-12-30 as day 0 (day 1 = 1899-12-31)
@@ -253,9 +376,7 @@ char *format_date(double value, const char *format, bool date1904)
         }
     }
 
-    char buffer[256];
-
-    if (has_time_component) {
+    if (with_time) {
         /* Format as DateTime: YYYY-MM-DD HH:MM:SS */
         /* Extract time from fractional part */
         double time_fraction = value - (int)value;
@@ -265,7 +386,7 @@ char *format_date(double value, const char *format, bool date1904)
         int    seconds       = total_seconds % 60;
 
         snprintf(buffer,
-                 sizeof(buffer),
+                 CELL_TEXT_BUFFER_SIZE,
                  "%04d-%02d-%02d %02d:%02d:%02d",
                  year,
                  month,
@@ -275,15 +396,20 @@ char *format_date(double value, const char *format, bool date1904)
                  seconds);
     } else {
         /* Use default date format: YYYY-MM-DD */
-        (void)format; /* Suppress unused parameter warning for non-datetime case */
-        snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+        snprintf(buffer, CELL_TEXT_BUFFER_SIZE, "%04d-%02d-%02d", year, month, day);
     }
 
-    return str_duplicate(buffer);
+    return (int)strlen(buffer);
+}
+
+/* Format date value; format only decides whether the time of day is shown */
+int format_date(double value, const char *format, bool date1904, char *buffer)
+{
+    return format_serial_date(value, date_format_has_time(format), date1904, buffer);
 }
 
 /* Format time value */
-char *format_time(double value, const char *format)
+int format_time(double value, const char *format, char *buffer)
 {
     /* Time is fraction of day */
     int total_seconds = (int)(value * 86400);
@@ -291,66 +417,59 @@ char *format_time(double value, const char *format)
     int minutes       = (total_seconds % 3600) / 60;
     int seconds       = total_seconds % 60;
 
-    char buffer[256];
     if (format) {
-        snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hours, minutes, seconds);
+        snprintf(buffer, CELL_TEXT_BUFFER_SIZE, "%02d:%02d:%02d", hours, minutes, seconds);
     } else {
-        snprintf(buffer, sizeof(buffer), "%02d:%02d", hours, minutes);
+        snprintf(buffer, CELL_TEXT_BUFFER_SIZE, "%02d:%02d", hours, minutes);
     }
 
-    return str_duplicate(buffer);
+    return (int)strlen(buffer);
 }
 
 /* Format float value */
-char *format_float(double value, const char *format, bool scifloat, const char *original_str)
+int format_float(double      value,
+                 const char *format,
+                 bool        scifloat,
+                 bool        shortest,
+                 bool        has_scientific,
+                 char       *buffer)
 {
-    char buffer[256];
-
     if (format) {
         /* Check if value is integer AND original string doesn't indicate float
          * True integers: value is close to integer AND no scientific notation in original
          * Float zeros: value is near-zero BUT from scientific notation (e.g., 1e-100)
          */
         bool is_integer_value = fabs(value - round(value)) < 1e-10;
-        bool has_scientific =
-            original_str && (strchr(original_str, 'e') || strchr(original_str, 'E'));
 
         if (is_integer_value && !has_scientific) {
             /* Python behavior: true integers are output as integers even with --floatformat */
-            snprintf(buffer, sizeof(buffer), "%.0f", value);
+            dtoa_fixed(value, 0, buffer);
         } else {
             /* Float values or scientific notation zeros: apply format */
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-            snprintf(buffer, sizeof(buffer), format, value);
+            snprintf(buffer, CELL_TEXT_BUFFER_SIZE, format, value);
 #pragma GCC diagnostic pop
         }
-
-        return str_duplicate(buffer);
     } else if (scifloat) {
         /* Python xlsx2csv's --sci-float behavior:
          * Use regular decimal format (not scientific notation)
          * But for integer values (not from scientific notation), output as integer
          */
 
-        /* Check if original value contains scientific notation */
-        bool has_scientific =
-            original_str && (strchr(original_str, 'e') || strchr(original_str, 'E'));
-
         /* Check if value is integer */
         bool is_integer_value = fabs(value - round(value)) < 1e-10;
 
         if (is_integer_value && !has_scientific) {
             /* Integer from normal notation: output as integer even with --sci-float */
-            snprintf(buffer, sizeof(buffer), "%.0f", value);
+            dtoa_fixed(value, 0, buffer);
         } else {
             /* Float or from scientific notation: use %f format */
-            snprintf(buffer, sizeof(buffer), "%f", value);
+            dtoa_fixed(value, 6, buffer);
 
             /* Strip trailing zeros for non-zero values (but not for values from scientific notation
              * that became zero) */
-            double result_value = atof(buffer);
-            bool   is_zero      = fabs(result_value) < 1e-300;
+            bool is_zero = !strpbrk(buffer, "123456789");
 
             /* Only strip trailing zeros if:
              * 1. Value is not zero, OR
@@ -377,35 +496,104 @@ char *format_float(double value, const char *format, bool scifloat, const char *
          * Exclude subnormal numbers (< 1e-200) to match Python behavior
          * which formats them as "0.000000" not "0"
          */
-        snprintf(buffer, sizeof(buffer), "%.0f", value);
+        dtoa_fixed(value, 0, buffer);
     } else if (fabs(value) < 1e-200 && value != 0.0) {
         /* Subnormal/tiny values: use %f to get "0.000000" or "-0.000000"
          * This matches Python's behavior for extremely small values
          */
-        snprintf(buffer, sizeof(buffer), "%f", value);
+        snprintf(buffer, CELL_TEXT_BUFFER_SIZE, "%f", value);
         /* Do NOT strip trailing zeros for tiny values - Python keeps them */
     } else if (fabs(value) < 1e-10) {
         /* Value is effectively zero (not subnormal, just zero) */
         if (value < 0.0 || signbit(value)) {
-            snprintf(buffer, sizeof(buffer), "-0");
+            memcpy(buffer, "-0", 3);
         } else {
-            snprintf(buffer, sizeof(buffer), "0");
+            memcpy(buffer, "0", 2);
         }
     } else {
         /* Default: Use %.15g format to preserve precision
-         * This matches Python xlsx2csv's default behavior
+         * This matches Python xlsx2csv's default behavior; --shortest-floats
+         * keeps every digit needed to read the same double back instead
          */
-        snprintf(buffer, sizeof(buffer), "%.15g", value);
+        if (shortest) {
+            dtoa_shortest(value, buffer);
+        } else {
+            dtoa_general(value, buffer);
+        }
     }
 
-    return str_duplicate(buffer);
+    return (int)strlen(buffer);
+}
+
+/* Whether a stored number is already the text the default formatting prints, so the
+ * cell can be copied instead of converted and printed again. decimals is what that path
+ * prints before dropping trailing zeros: 0 for %.15g, 6 for "%f".
+ *
+ * The text must be an optional '-', an integer part without leading zeros and a fraction
+ * without trailing zeros, with no exponent. At most 15 digits may be printed in all, as
+ * every decimal that short reads back from its double unchanged. Refused as well: "-0",
+ * which the paths print differently; a fraction starting with four 0s after "0.", which
+ * %.15g writes with an exponent; and one starting with eight 0s or 9s, close enough to
+ * an integer for the formatting to round it.
+ */
+static bool number_is_canonical(const char *value, int decimals)
+{
+    const char *p = value;
+    if (*p == '-') {
+        p++;
+    }
+
+    const char *integer = p;
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    int  integer_digits = (int)(p - integer);
+    bool zero_integer   = integer_digits == 1 && integer[0] == '0';
+    if (integer_digits == 0 || (integer_digits > 1 && integer[0] == '0')) {
+        return false;
+    }
+    if (*p == '\0') {
+        return integer_digits <= 15 && !(zero_integer && value[0] == '-');
+    }
+    if (*p != '.') {
+        return false;
+    }
+
+    const char *fraction = ++p;
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    int fraction_digits = (int)(p - fraction);
+    if (*p != '\0' || fraction_digits == 0 || fraction[fraction_digits - 1] == '0') {
+        return false;
+    }
+
+    int leading_zeros = 0;
+    int leading_nines = 0;
+    while (leading_zeros < fraction_digits && fraction[leading_zeros] == '0') {
+        leading_zeros++;
+    }
+    while (leading_nines < fraction_digits && fraction[leading_nines] == '9') {
+        leading_nines++;
+    }
+    if (leading_zeros >= 8 || leading_nines >= 8) {
+        return false;
+    }
+
+    int integer_printed = zero_integer ? 0 : integer_digits;
+    if (decimals > 0) {
+        return fraction_digits <= decimals && integer_printed + decimals <= 15;
+    }
+    if (zero_integer && leading_zeros >= 4) {
+        return false;
+    }
+    return integer_printed + fraction_digits - (zero_integer ? leading_zeros : 0) <= 15;
 }
 
 /* Apply Excel number format to a value
- * Returns formatted string, or NULL if format not supported
- * Caller must free the returned string
+ * Returns buffer holding the formatted value, or NULL if format not supported
  */
-static char *apply_excel_format(double value, const char *format_code)
+static const char *apply_excel_format(double value, const char *format_code, char *buffer)
 {
     if (!format_code) {
         return NULL;
@@ -417,25 +605,22 @@ static char *apply_excel_format(double value, const char *format_code)
 
     /* Handle format "0.00" - round to 2 decimal places */
     if (strcmp(format_code, "0.00") == 0) {
-        char buffer[256];
-        snprintf(buffer, sizeof(buffer), "%.2f", value);
-        return str_duplicate(buffer);
+        dtoa_fixed(value, 2, buffer);
+        return buffer;
     }
 
     /* Handle format "0" - no decimal places */
     if (strcmp(format_code, "0") == 0) {
-        char buffer[256];
-        snprintf(buffer, sizeof(buffer), "%.0f", value);
-        return str_duplicate(buffer);
+        dtoa_fixed(value, 0, buffer);
+        return buffer;
     }
 
     /* Handle scientific notation format "0.00E+00"
      * Python outputs with 6 decimal places (%.6f)
      */
     if (strcmp(format_code, "0.00E+00") == 0 || strcmp(format_code, "0.00e+00") == 0) {
-        char buffer[256];
-        snprintf(buffer, sizeof(buffer), "%.6f", value);
-        return str_duplicate(buffer);
+        dtoa_fixed(value, 6, buffer);
+        return buffer;
     }
 
     /* All other formats (including #,##0, #,##0.00, etc.) are not applied
@@ -444,43 +629,42 @@ static char *apply_excel_format(double value, const char *format_code)
     return NULL;
 }
 
-/* Main cell formatting function */
-char *format_cell_value(const char        *value,
-                        const char        *type_attr,
-                        const char        *style_attr,
-                        xlsx2csvConverter *conv)
+/* Format a cell that is not a shared string: returns value itself, a constant,
+ * or buffer (CELL_TEXT_BUFFER_SIZE bytes) holding the formatted text
+ */
+static const char *format_cell_string(const char        *value,
+                                      cellType           type,
+                                      int                style_id,
+                                      xlsx2csvConverter *conv,
+                                      char              *buffer)
 {
     if (!value) {
-        return str_duplicate("");
+        return "";
     }
 
-    /* Handle shared string */
-    if (type_attr && strcmp(type_attr, "s") == 0) {
-        int index = atoi(value);
-        if (index >= 0 && index < conv->shared_strings.count) {
-            return str_duplicate(conv->shared_strings.strings[index]);
-        }
-        return str_duplicate(value);
+    /* Shared string index out of range */
+    if (type == CELL_TYPE_SHARED_STRING) {
+        return value;
     }
 
     /* Handle boolean */
-    if (type_attr && strcmp(type_attr, "b") == 0) {
+    if (type == CELL_TYPE_BOOLEAN) {
         int bool_val = atoi(value);
-        return str_duplicate(bool_val ? "TRUE" : "FALSE");
+        return bool_val ? "TRUE" : "FALSE";
     }
 
     /* Handle inline string */
-    if (type_attr && (strcmp(type_attr, "str") == 0 || strcmp(type_attr, "inlineStr") == 0)) {
-        return str_duplicate(value);
+    if (type == CELL_TYPE_STRING || type == CELL_TYPE_INLINE_STRING) {
+        return value;
     }
 
     /* Handle numeric value with style - check BEFORE handling Excel errors
      * Python behavior: Even if value is #VALUE! (type='e'), if it has a numeric style
      * (date/time/float), Python tries to convert it to float, which raises ValueError
      */
-    if (style_attr) {
-        int        style_id = atoi(style_attr);
-        formatType ftype    = get_format_type(style_id, &conv->styles);
+    if (style_id != CELL_STYLE_NONE) {
+        const cellStyle *style = cell_style(&conv->styles, style_id);
+        formatType       ftype = style->type;
 
         /* Python behavior (line 823-856 in Python version):
          * - If has s_attr (style): checks data with regex to set format_type (line 848-850)
@@ -492,7 +676,22 @@ char *format_cell_value(const char        *value,
 
         /* Special case: #N/A is explicitly excluded */
         if (strcmp(value, "#N/A") == 0) {
-            return str_duplicate(value);
+            return value;
+        }
+
+        /* Numbers on the default float path that are stored as it would print them */
+        bool default_float =
+            (ftype == FORMAT_PERCENTAGE ||
+             ((ftype == FORMAT_FLOAT || ftype == FORMAT_CUSTOM_FLOAT) &&
+              !(style->flags & STYLE_FLOAT_DECIMALS))) &&
+            !conv->options.floatformat && !conv->options.scifloat &&
+            !(conv->options.excel_formats && style->program);
+        if (ftype == FORMAT_FLOAT || ftype == FORMAT_CUSTOM_FLOAT || ftype == FORMAT_PERCENTAGE) {
+            conv->format_stats.numbers++;
+        }
+        if (default_float && number_is_canonical(value, 0)) {
+            conv->format_stats.verbatim_numbers++;
+            return value;
         }
 
         /* Determine if we should attempt conversion based on Python's logic
@@ -509,9 +708,11 @@ char *format_cell_value(const char        *value,
          * Since we don't have the FORMATS dict in C, we'll assume that if we determined
          * a numeric ftype from the style, it's like a standard format - always try to convert.
          */
-        bool should_convert = false;
+        bool         should_convert = false;
+        parsedNumber number;
+        const char  *number_end = number_parse(value, &number);
 
-        if (style_attr) {
+        if (style_id != CELL_STYLE_NONE) {
             /* Has style */
             if (ftype == FORMAT_DATE || ftype == FORMAT_TIME || ftype == FORMAT_FLOAT ||
                 ftype == FORMAT_PERCENTAGE) {
@@ -521,149 +722,89 @@ char *format_cell_value(const char        *value,
             } else if (ftype == FORMAT_CUSTOM_FLOAT) {
                 /* Custom formats (not in FORMATS) - only if data looks like number (Python line
                  * 848-850) */
-                should_convert = is_numeric(value);
+                should_convert = number.numeric;
             }
-        } else if (type_attr && strcmp(type_attr, "n") == 0) {
+        } else if (type == CELL_TYPE_NUMBER) {
             /* No style, but colType="n" (Python line 853-854) - always try to convert */
             should_convert = true;
         }
 
-        double num_value;
+        double num_value = number.value;
         if (should_convert) {
-            /* Check if value is a valid number */
-            char *endptr;
-            num_value = strtod(value, &endptr);
-
-            /* If conversion failed (endptr didn't advance or didn't reach end),
+            /* If conversion failed (the number is missing or does not reach the end),
              * this matches Python's ValueError/OverflowError case
              */
-            if (endptr == value || (*endptr != '\0' && *endptr != ' ')) {
+            if (number_end == value || (*number_end != '\0' && *number_end != ' ')) {
                 /* Invalid numeric value - set error flag */
                 conv->has_date_error = true;
-                return str_duplicate(value);
+                return value;
             }
         } else {
             /* should_convert = false means value doesn't look like a number
              * (e.g., #VALUE! with custom format) - return as-is without conversion
              */
-            return str_duplicate(value);
+            return value;
         }
 
-        if (ftype == FORMAT_DATE) {
-            /* Get the format string for datetime detection */
-            int         fmt_id     = -1;
-            const char *format_str = NULL;
-            if (style_id >= 0 && style_id < conv->styles.cell_xfs_count) {
-                fmt_id = conv->styles.cell_xfs[style_id];
-            }
-            for (int i = 0; i < conv->styles.format_count; i++) {
-                if (conv->styles.formats[i].id == fmt_id) {
-                    format_str = conv->styles.formats[i].format_code;
-                    break;
-                }
+        /* --excel-formats: show the value as Excel would */
+        if (conv->options.excel_formats && style->program) {
+            if (number_format_render(style->program, num_value, conv->workbook.date1904, buffer,
+                                     CELL_TEXT_BUFFER_SIZE) >= 0) {
+                return buffer;
             }
+        }
 
+        if (ftype == FORMAT_DATE) {
             if (conv->options.dateformat) {
-                return format_date(num_value, conv->options.dateformat, conv->workbook.date1904);
+                format_date(num_value, conv->options.dateformat, conv->workbook.date1904, buffer);
             } else {
-                /* Pass Excel format string to detect DateTime vs Date-only */
-                return format_date(num_value, format_str, conv->workbook.date1904);
+                /* The style knows whether its Excel format shows DateTime or Date-only */
+                format_serial_date(num_value, style->flags & STYLE_DATE_TIME,
+                                   conv->workbook.date1904, buffer);
             }
+            return buffer;
         } else if (ftype == FORMAT_TIME) {
             if (conv->options.timeformat) {
-                return format_time(num_value, conv->options.timeformat);
+                format_time(num_value, conv->options.timeformat, buffer);
             } else {
-                return format_time(num_value, NULL);
+                format_time(num_value, NULL, buffer);
             }
+            return buffer;
         } else if (ftype == FORMAT_PERCENTAGE) {
             /* Percentage values are stored as decimals in Excel (0.5 = 50%)
              * Python xlsx2csv applies floatformat ONLY if the percentage format starts with "0.0"
              * e.g., "0.0%" applies floatformat, but "0%" does not
              */
-            /* Get the format string for this style */
-            int         fmt_id     = -1;
-            const char *format_str = NULL;
-            if (style_id >= 0 && style_id < conv->styles.cell_xfs_count) {
-                fmt_id = conv->styles.cell_xfs[style_id];
-            }
-            for (int i = 0; i < conv->styles.format_count; i++) {
-                if (conv->styles.formats[i].id == fmt_id) {
-                    format_str = conv->styles.formats[i].format_code;
-                    break;
-                }
-            }
-
-            bool format_starts_with_0_0 = format_str && strncmp(format_str, "0.0", 3) == 0;
+            bool format_starts_with_0_0 = style->flags & STYLE_PERCENT_DECIMALS;
             if (format_starts_with_0_0 && conv->options.floatformat) {
-                return format_float(
-                    num_value, conv->options.floatformat, conv->options.scifloat, value);
+                format_float(num_value,
+                             conv->options.floatformat,
+                             conv->options.scifloat,
+                             conv->options.shortest_floats,
+                             number.has_exponent,
+                             buffer);
             } else {
-                return format_float(num_value, NULL, conv->options.scifloat, value);
+                format_float(num_value,
+                             NULL,
+                             conv->options.scifloat,
+                             conv->options.shortest_floats,
+                             number.has_exponent,
+                             buffer);
             }
+            return buffer;
         } else if (ftype == FORMAT_FLOAT || ftype == FORMAT_CUSTOM_FLOAT) {
-            /* Get the format ID for this style */
-            int fmt_id = -1;
-            if (style_id >= 0 && style_id < conv->styles.cell_xfs_count) {
-                fmt_id = conv->styles.cell_xfs[style_id];
-            }
-
-            /* Get the format string for this format ID */
-            const char *format_str = NULL;
-            for (int i = 0; i < conv->styles.format_count; i++) {
-                if (conv->styles.formats[i].id == fmt_id) {
-                    format_str = conv->styles.formats[i].format_code;
-                    break;
-                }
-            }
-
-            /* If no custom format found, check standard formats */
-            if (!format_str && fmt_id >= 0) {
-                static const struct {
-                    int         id;
-                    const char *format;
-                } standard_formats[] = {
-                    {0,  "general"                 },
-                    {1,  "0"                       },
-                    {2,  "0.00"                    },
-                    {3,  "#,##0"                   },
-                    {4,  "#,##0.00"                },
-                    {9,  "0%"                      },
-                    {10, "0.00%"                   },
-                    {11, "0.00e+00"                },
-                    {37, "#,##0 ;(#,##0)"          },
-                    {38, "#,##0 ;[red](#,##0)"     },
-                    {39, "#,##0.00;(#,##0.00)"     },
-                    {40, "#,##0.00;[red](#,##0.00)"},
-                    {48, "##0.0e+0"                }
-                };
-                for (size_t i = 0; i < sizeof(standard_formats) / sizeof(standard_formats[0]);
-                     i++) {
-                    if (standard_formats[i].id == fmt_id) {
-                        format_str = standard_formats[i].format;
-                        break;
-                    }
-                }
-            }
+            /* Format string for this style: custom, or standard if there is none */
+            const char *format_str = style->float_code;
 
             /* Python behavior is complex:
              * - Standard formats (like "0.00", "#,##0.00", etc.) are NOT applied when --floatformat
              * exists
              * - Custom formats (like "0.00_ ", "0.00 ") ARE applied (keep Excel precision)
-             * Check format string patterns
+             * The patterns were checked when the styles were loaded
              */
-            bool is_standard_format = false;
-            if (format_str) {
-                /* Standard formats: starts with # or 0, no decorators like _ or spaces after
-                 * numbers */
-                if (strcmp(format_str, "0") == 0 || strcmp(format_str, "0.00") == 0 ||
-                    strcmp(format_str, "0.00E+00") == 0 || strcmp(format_str, "0.00e+00") == 0 ||
-                    strncmp(format_str, "#,##0", 5) == 0) {
-                    is_standard_format = true;
-                }
-            }
-
-            bool has_custom_format =
-                format_str && !is_standard_format && strncmp(format_str, "0.0", 3) == 0;
+            bool is_standard_format = style->flags & STYLE_FLOAT_STANDARD;
+            bool starts_with_0_0    = style->flags & STYLE_FLOAT_DECIMALS;
+            bool has_custom_format  = !is_standard_format && starts_with_0_0;
 
             /* Apply Excel format in these cases:
              * 1. No --floatformat: apply any format starting with "0.0"
@@ -671,7 +812,7 @@ char *format_cell_value(const char        *value,
              *    (will be handled in floatformat path with custom stripping logic)
              */
             bool should_apply_excel = false;
-            if (!conv->options.floatformat && format_str && strncmp(format_str, "0.0", 3) == 0) {
+            if (!conv->options.floatformat && starts_with_0_0) {
                 should_apply_excel = true;
             }
             /* Note: When floatformat is present, skip Excel format application
@@ -679,7 +820,7 @@ char *format_cell_value(const char        *value,
 
             if (should_apply_excel) {
                 /* Custom format: apply Excel format and keep precision */
-                char *excel_formatted = apply_excel_format(num_value, format_str);
+                const char *excel_formatted = apply_excel_format(num_value, format_str, buffer);
                 if (excel_formatted) {
                     return excel_formatted;
                 }
@@ -711,14 +852,7 @@ char *format_cell_value(const char        *value,
                         output_decimal_places = decimal_places + modifier_length;
                     }
 
-                    char format_buf[32];
-                    snprintf(format_buf, sizeof(format_buf), "%%.%df", output_decimal_places);
-
-                    char buffer[256];
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-                    snprintf(buffer, sizeof(buffer), format_buf, num_value);
-#pragma GCC diagnostic pop
+                    dtoa_fixed(num_value, output_decimal_places, buffer);
 
                     /* Strip trailing zeros for custom formats
                      * Python behavior differs based on --floatformat:
@@ -757,7 +891,7 @@ char *format_cell_value(const char        *value,
                         }
                     }
 
-                    return str_duplicate(buffer);
+                    return buffer;
                 }
             }
 
@@ -767,42 +901,59 @@ char *format_cell_value(const char        *value,
              * - For custom formats (0.00_ , etc.): apply floatformat EVEN for integer values
              */
             /* Check if original value string contains negative zero */
-            double parsed_value = atof(value);
-            bool   is_negative_zero =
+            bool is_negative_zero =
                 (strcmp(value, "-0") == 0) ||
-                (value[0] == '-' && fabs(parsed_value) < 1e-300 && signbit(parsed_value));
+                (value[0] == '-' && fabs(num_value) < 1e-300 && signbit(num_value));
 
             if (conv->options.floatformat && has_custom_format) {
                 /* With --floatformat and custom format: apply floatformat */
                 /* For custom formats, even integer values should be formatted with decimals */
-                char format_buf[256];
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-                snprintf(format_buf, sizeof(format_buf), conv->options.floatformat, num_value);
+                snprintf(buffer, CELL_TEXT_BUFFER_SIZE, conv->options.floatformat, num_value);
 #pragma GCC diagnostic pop
-                return str_duplicate(format_buf);
+                return buffer;
             } else if (conv->options.floatformat && !is_standard_format) {
                 /* With --floatformat but no Excel format: apply for floats only */
-                char *result = format_float(
-                    num_value, conv->options.floatformat, conv->options.scifloat, value);
-                if (is_negative_zero && strcmp(result, "0") == 0) {
-                    free(result);
-                    return str_duplicate("-0");
+                format_float(num_value,
+                             conv->options.floatformat,
+                             conv->options.scifloat,
+                             conv->options.shortest_floats,
+                             number.has_exponent,
+                             buffer);
+                if (is_negative_zero && strcmp(buffer, "0") == 0) {
+                    return "-0";
                 }
-                return result;
+                return buffer;
             } else {
                 /* Without --floatformat OR with standard format: default formatting */
-                return format_float(num_value, NULL, conv->options.scifloat, value);
+                format_float(num_value,
+                             NULL,
+                             conv->options.scifloat,
+                             conv->options.shortest_floats,
+                             number.has_exponent,
+                             buffer);
+                return buffer;
             }
         }
     }
 
     /* Default numeric handling */
-    if (type_attr && strcmp(type_attr, "n") == 0) {
-        double num_value = atof(value);
+    if (type == CELL_TYPE_NUMBER) {
+        conv->format_stats.numbers++;
+
+        /* Stored as "%f" with its trailing zeros stripped would print it */
+        if (!conv->options.scifloat && number_is_canonical(value, 6)) {
+            conv->format_stats.verbatim_numbers++;
+            return value;
+        }
+
+        parsedNumber number;
+        number_parse(value, &number);
+        double num_value = number.value;
 
         /* Check if original value contains scientific notation */
-        bool has_scientific = strchr(value, 'e') != NULL || strchr(value, 'E') != NULL;
+        bool has_scientific = number.has_exponent;
 
         /* Check if value is integer (or very close to integer)
          * BUT: if original value was in scientific notation, treat as float
@@ -820,41 +971,51 @@ char *format_cell_value(const char        *value,
          */
         if (conv->options.floatformat && has_scientific) {
             /* Scientific notation: always apply floatformat */
-            return format_float(
-                num_value, conv->options.floatformat, conv->options.scifloat, value);
+            format_float(num_value,
+                         conv->options.floatformat,
+                         conv->options.scifloat,
+                         conv->options.shortest_floats,
+                         number.has_exponent,
+                         buffer);
+            return buffer;
         }
 
         /* For cells without Excel format: do NOT apply --floatformat option
          * (This branch is for cells without style or with style but no custom number format)
          * Use default formatting instead */
         if (conv->options.scifloat && !is_integer) {
-            return format_float(num_value, NULL, conv->options.scifloat, value);
+            format_float(num_value,
+                         NULL,
+                         conv->options.scifloat,
+                         conv->options.shortest_floats,
+                         number.has_exponent,
+                         buffer);
+            return buffer;
         }
 
         /* Otherwise use default formatting */
-        char buffer[256];
 
         if (is_integer) {
             /* Integer: display as integer (no decimal point) */
             if (is_negative_zero && conv->options.floatformat) {
                 /* When floatformat is specified, preserve negative zero */
-                snprintf(buffer, sizeof(buffer), "-0");
+                return "-0";
             } else if (fabs(num_value) < 1e-10) {
                 /* Python xlsx2csv: "%i" % Decimal(repr(float("-0"))) -> "0" */
-                snprintf(buffer, sizeof(buffer), "0");
+                return "0";
             } else {
-                snprintf(buffer, sizeof(buffer), "%.0f", num_value);
+                dtoa_fixed(num_value, 0, buffer);
             }
-        } else if (strchr(value, 'e') || strchr(value, 'E')) {
+        } else if (has_scientific) {
             /* Original was in scientific notation, convert to decimal format with %f
              * Keep the default 6 decimal places to match Python's behavior
              */
-            snprintf(buffer, sizeof(buffer), "%f", num_value);
+            dtoa_fixed(num_value, 6, buffer);
         } else {
             /* Use %f (6 decimal places by default), then strip trailing zeros
              * This matches Python's behavior: ("%f" % data).rstrip('0').rstrip('.')
              */
-            snprintf(buffer, sizeof(buffer), "%f", num_value);
+            dtoa_fixed(num_value, 6, buffer);
 
             /* Strip trailing zeros */
             char *p = strchr(buffer, '.');
@@ -870,9 +1031,39 @@ char *format_cell_value(const char        *value,
             }
         }
 
-        return str_duplicate(buffer);
+        return buffer;
     }
 
     /* Default: return as-is */
-    return str_duplicate(value);
+    return value;
+}
+
+/* Main cell formatting function: shared strings are returned as views into the table,
+ * anything else as a view into value or buffer (CELL_TEXT_BUFFER_SIZE bytes)
+ */
+void format_cell_value(const char        *value,
+                       cellType           type,
+                       int                style_id,
+                       xlsx2csvConverter *conv,
+                       char              *buffer,
+                       cellText          *text)
+{
+    if (value && type == CELL_TYPE_SHARED_STRING) {
+        size_t       len  = 0;
+        csvFieldForm form = CSV_FIELD_UNKNOWN;
+        const char  *data = shared_string_csv(&conv->shared_strings, atoi(value), &len, &form);
+        if (data) {
+            text->data   = data;
+            text->len    = len;
+            text->form   = form;
+            text->stable = true;
+            return;
+        }
+    }
+
+    const char *data = format_cell_string(value, type, style_id, conv, buffer);
+    text->data       = data;
+    text->len        = strlen(data);
+    text->form       = CSV_FIELD_UNKNOWN;
+    text->stable     = false;
 }
@@ -2,17 +2,61 @@
 #define _FORMAT_HANDLER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
+#include "csv_writer.h"
+#include "dtoa.h"
 #include "xlsx2csv.h"
 
+/* Size of the buffer a cell is formatted into; longer output is cut like snprintf's */
+#define CELL_TEXT_BUFFER_SIZE DTOA_BUFFER_SIZE
+
+/* The t attribute of a cell */
+typedef enum {
+    CELL_TYPE_NONE = 0,      /* No t attribute */
+    CELL_TYPE_NUMBER,        /* "n" */
+    CELL_TYPE_SHARED_STRING, /* "s" */
+    CELL_TYPE_BOOLEAN,       /* "b" */
+    CELL_TYPE_STRING,        /* "str", a formula result */
+    CELL_TYPE_INLINE_STRING, /* "inlineStr" */
+    CELL_TYPE_OTHER          /* "e", "d" or anything else: the value is shown as is */
+} cellType;
+
+/* Style id of a cell without an s attribute */
+#define CELL_STYLE_NONE (-1)
+
+/* Formatted cell text. Nothing is allocated for it: data points into the shared
+ * strings, which outlive the sheet (stable), or into the cell value or the
+ * caller's buffer, which the next cell reuses.
+ */
+typedef struct {
+    const char  *data;
+    size_t       len;
+    csvFieldForm form;   /* How the writer outputs it, if known in advance */
+    bool         stable; /* data stays valid after the next cell is formatted */
+} cellText;
+
 /* Format handler functions */
-char      *format_cell_value(const char        *value,
-                             const char        *type_attr,
-                             const char        *style_attr,
-                             xlsx2csvConverter *conv);
+void       format_cell_value(const char        *value,
+                             cellType           type,
+                             int                style_id,
+                             xlsx2csvConverter *conv,
+                             char              *buffer,
+                             cellText          *text);
+int        styles_resolve(styleInfo *styles, bool compile);
+void       styles_free(styleInfo *styles);
 formatType get_format_type(int style_id, styleInfo *styles);
-char      *format_date(double value, const char *format, bool date1904);
-char      *format_time(double value, const char *format);
-char      *format_float(double value, const char *format, bool scifloat, const char *original_str);
+
+/* Each writes a NUL-terminated string into buffer (CELL_TEXT_BUFFER_SIZE bytes)
+ * and returns its length
+ */
+int format_date(double value, const char *format, bool date1904, char *buffer);
+int format_time(double value, const char *format, char *buffer);
+int format_float(double      value,
+                 const char *format,
+                 bool        scifloat,
+                 bool        shortest,
+                 bool        has_scientific,
+                 char       *buffer);
 
 #endif /* _FORMAT_HANDLER_H */
@@ -0,0 +1,133 @@
+/* Standard library headers */
+#include <string.h>
+#include <time.h>
+
+/* Third-party library headers */
+#include <zlib.h>
+
+/* Project headers */
+#include "fast_inflate.h"
+#include "inflate_backend.h"
+
+/* Largest chunk handed to zlib at once (avail_in/avail_out are 32-bit) */
+#define INFLATE_MAX_CHUNK (1u << 30)
+
+/* One-shot zlib inflate */
+static int zlib_inflate(const unsigned char *src,
+                        size_t               src_len,
+                        unsigned char       *dst,
+                        size_t               dst_len)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+        return -1;
+    }
+
+    size_t in_left  = src_len;
+    size_t out_left = dst_len;
+    int    ret      = Z_OK;
+
+    strm.next_in  = (Bytef *)(uintptr_t)src;
+    strm.next_out = dst;
+
+    while (ret == Z_OK) {
+        if (strm.avail_in == 0 && in_left > 0) {
+            strm.avail_in = (uInt)(in_left < INFLATE_MAX_CHUNK ? in_left : INFLATE_MAX_CHUNK);
+            in_left -= strm.avail_in;
+        }
+        if (strm.avail_out == 0 && out_left > 0) {
+            strm.avail_out = (uInt)(out_left < INFLATE_MAX_CHUNK ? out_left : INFLATE_MAX_CHUNK);
+            out_left -= strm.avail_out;
+        }
+        ret = inflate(&strm, Z_NO_FLUSH);
+    }
+
+    size_t produced = (size_t)strm.total_out;
+    inflateEnd(&strm);
+
+    return (ret == Z_STREAM_END && produced == dst_len) ? 0 : -1;
+}
+
+/* Available backends; the first one is the default */
+static const inflateBackend backends[] = {
+    {"fast", fast_inflate},
+    {"zlib", zlib_inflate},
+};
+
+#define BACKEND_COUNT (sizeof(backends) / sizeof(backends[0]))
+
+/* Find backend by name (NULL selects the default) */
+const inflateBackend *inflate_backend_find(const char *name)
+{
+    if (!name) {
+        return &backends[0];
+    }
+
+    for (size_t i = 0; i < BACKEND_COUNT; i++) {
+        if (strcmp(backends[i].name, name) == 0) {
+            return &backends[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Backend names for error messages */
+const char *inflate_backend_list(void)
+{
+    return "fast, zlib";
+}
+
+/* Monotonic time in seconds */
+double inflate_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Decode with a backend and account for it in stats */
+int inflate_backend_run(const inflateBackend *backend,
+                        inflateStats         *stats,
+                        const unsigned char  *src,
+                        size_t                src_len,
+                        unsigned char        *dst,
+                        size_t                dst_len)
+{
+    double start  = inflate_clock();
+    int    result = backend->decode(src, src_len, dst, dst_len);
+
+    if (stats && result == 0) {
+        stats->whole_calls++;
+        stats->bytes_in += src_len;
+        stats->bytes_out += dst_len;
+        stats->seconds += inflate_clock() - start;
+    }
+
+    return result;
+}
+
+/* Accumulate counters */
+void inflate_stats_add(inflateStats *total, const inflateStats *stats)
+{
+    total->whole_calls += stats->whole_calls;
+    total->stream_calls += stats->stream_calls;
+    total->bytes_in += stats->bytes_in;
+    total->bytes_out += stats->bytes_out;
+    total->seconds += stats->seconds;
+}
+
+/* Print counters with output throughput */
+void inflate_stats_print(const inflateStats *stats, const char *backend_name, FILE *out)
+{
+    double rate = stats->seconds > 0 ? (double)stats->bytes_out / stats->seconds : 0;
+
+    fprintf(out, "inflate backend:   %s\n", backend_name);
+    fprintf(out, "entries inflated:  %llu whole, %llu streamed\n",
+            (unsigned long long)stats->whole_calls, (unsigned long long)stats->stream_calls);
+    fprintf(out, "bytes in/out:      %llu / %llu\n", (unsigned long long)stats->bytes_in,
+            (unsigned long long)stats->bytes_out);
+    fprintf(out, "inflate time:      %.3f s\n", stats->seconds);
+    fprintf(out, "inflate rate:      %.1f MB/s\n", rate / (1024.0 * 1024.0));
+}
@@ -0,0 +1,48 @@
+#ifndef _INFLATE_BACKEND_H
+#define _INFLATE_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Whole-buffer decoder: inflate a raw DEFLATE stream into exactly dst_len bytes.
+ * Returns 0 on success, -1 if the stream is corrupt or of a different size.
+ */
+typedef int (*inflateFunc)(const unsigned char *src,
+                           size_t               src_len,
+                           unsigned char       *dst,
+                           size_t               dst_len);
+
+/* Named inflate backend */
+typedef struct {
+    const char *name;
+    inflateFunc decode;
+} inflateBackend;
+
+/* Decompression counters, used to compare backends */
+typedef struct {
+    uint64_t whole_calls;  /* Entries inflated in one shot by the backend */
+    uint64_t stream_calls; /* Entries inflated incrementally by zlib/libzip */
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    double   seconds;
+} inflateStats;
+
+/* Backend selection (NULL name selects the default backend) */
+const inflateBackend *inflate_backend_find(const char *name);
+const char           *inflate_backend_list(void);
+
+/* Decode with a backend and account for it in stats */
+int inflate_backend_run(const inflateBackend *backend,
+                        inflateStats         *stats,
+                        const unsigned char  *src,
+                        size_t                src_len,
+                        unsigned char        *dst,
+                        size_t                dst_len);
+
+/* Statistics */
+double inflate_clock(void);
+void   inflate_stats_add(inflateStats *total, const inflateStats *stats);
+void   inflate_stats_print(const inflateStats *stats, const char *backend_name, FILE *out);
+
+#endif /* _INFLATE_BACKEND_H */
@@ -0,0 +1,372 @@
+/* Checkpoint index for random access into a deflated worksheet (zran-style).
+ *
+ * While a worksheet is inflated, a resume point is recorded at a deflate block
+ * boundary roughly every span bytes of output: the compressed bit position,
+ * the 32 KB of history the decoder needs and the row that is open there. A
+ * reader can later restart decoding at any point instead of at the start of
+ * the entry, e.g. to begin near a given row or to split one sheet between
+ * several workers.
+ */
+
+/* Standard library headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Project headers */
+#include "inflate_index.h"
+
+#define INDEX_MAGIC   "XLSXCIDX"
+#define INDEX_VERSION 1
+
+/* Row scanner states */
+enum {
+    SCAN_TEXT,  /* Outside a tag */
+    SCAN_NAME,  /* Matching "<row" */
+    SCAN_TAG,   /* Inside a row tag, looking for r=" */
+    SCAN_VALUE  /* Inside the r attribute value */
+};
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* Create an empty index for an entry with the given identity */
+inflateIndex *inflate_index_create(uint64_t span,
+                                   uint64_t size,
+                                   uint64_t comp_size,
+                                   uint32_t crc32)
+{
+    inflateIndex *index = calloc(1, sizeof(inflateIndex));
+    if (!index) {
+        return NULL;
+    }
+
+    index->span      = span;
+    index->size      = size;
+    index->comp_size = comp_size;
+    index->crc32     = crc32;
+    return index;
+}
+
+/* Free index and its windows */
+void inflate_index_free(inflateIndex *index)
+{
+    if (!index) {
+        return;
+    }
+
+    for (size_t i = 0; i < index->count; i++) {
+        free(index->points[i].window);
+    }
+    free(index->points);
+    free(index);
+}
+
+/* True if a point at out_offset would be at least span past the previous one */
+bool inflate_index_wants_point(const inflateIndex *index, uint64_t out_offset)
+{
+    uint64_t last = index->count > 0 ? index->points[index->count - 1].out_offset : 0;
+    return out_offset > last && out_offset - last >= index->span;
+}
+
+/* Record a resume point; its row is filled in once the scanner gets past it */
+int inflate_index_add_point(inflateIndex        *index,
+                            uint64_t             out_offset,
+                            uint64_t             in_offset,
+                            int                  bits,
+                            const unsigned char *window,
+                            unsigned             window_len)
+{
+    if (window_len > INFLATE_WINDOW_SIZE) {
+        return -1;
+    }
+
+    if (index->count == index->capacity) {
+        size_t        new_capacity = index->capacity ? index->capacity * 2 : 16;
+        inflatePoint *new_points   = realloc(index->points, new_capacity * sizeof(inflatePoint));
+        if (!new_points) {
+            return -1;
+        }
+        index->points   = new_points;
+        index->capacity = new_capacity;
+    }
+
+    inflatePoint *point = &index->points[index->count];
+    point->window       = malloc(window_len ? window_len : 1);
+    if (!point->window) {
+        return -1;
+    }
+
+    memcpy(point->window, window, window_len);
+    point->out_offset = out_offset;
+    point->in_offset  = in_offset;
+    point->bits       = bits;
+    point->window_len = window_len;
+    point->row        = 0;
+    index->count++;
+
+    return 0;
+}
+
+/* A row tag starts at the scanner's tag offset */
+static void row_started(inflateIndex *index)
+{
+    /* Points before this tag sit inside the previous row */
+    while (index->pending < index->count &&
+           index->points[index->pending].out_offset <= index->scanner.tag_offset) {
+        index->points[index->pending++].row = index->current_row;
+    }
+
+    /* Rows without an r attribute follow the previous one */
+    index->current_row++;
+}
+
+/* Feed the next uncompressed bytes of the entry to the row scanner */
+void inflate_index_scan(inflateIndex *index, const char *data, size_t len)
+{
+    rowScanner *sc = &index->scanner;
+    size_t      i  = 0;
+
+    while (i < len) {
+        switch (sc->state) {
+            case SCAN_TEXT: {
+                const char *lt = memchr(data + i, '<', len - i);
+                if (!lt) {
+                    i = len;
+                    break;
+                }
+                i              = (size_t)(lt - data) + 1;
+                sc->tag_offset = index->scanned + i - 1;
+                sc->state      = SCAN_NAME;
+                sc->match      = 1;
+                break;
+            }
+            case SCAN_NAME:
+                if (sc->match < 4) {
+                    /* A mismatch is rescanned as text (it may be another '<') */
+                    if (data[i] == "<row"[sc->match]) {
+                        sc->match++;
+                        i++;
+                    } else {
+                        sc->state = SCAN_TEXT;
+                    }
+                } else if (is_space(data[i]) || data[i] == '>' || data[i] == '/') {
+                    row_started(index);
+                    sc->state = SCAN_TAG;
+                    sc->match = 0;
+                } else {
+                    sc->state = SCAN_TEXT;
+                }
+                break;
+            case SCAN_TAG: {
+                char c = data[i++];
+                if (c == '>') {
+                    sc->state = SCAN_TEXT;
+                } else if (sc->match == 0 || is_space(c)) {
+                    sc->match = is_space(c) ? 1 : 0;
+                } else if (sc->match == 1) {
+                    sc->match = (c == 'r') ? 2 : 0;
+                } else if (sc->match == 2) {
+                    sc->match = (c == '=') ? 3 : 0;
+                } else if (c == '"' || c == '\'') {
+                    sc->state = SCAN_VALUE;
+                    sc->value = 0;
+                } else {
+                    sc->match = 0;
+                }
+                break;
+            }
+            case SCAN_VALUE:
+                if (data[i] >= '0' && data[i] <= '9') {
+                    sc->value = sc->value * 10 + (uint64_t)(data[i] - '0');
+                    i++;
+                } else {
+                    if (sc->value > 0) {
+                        index->current_row = sc->value;
+                    }
+                    sc->state = SCAN_TAG;
+                    sc->match = 0;
+                }
+                break;
+            default:
+                sc->state = SCAN_TEXT;
+                break;
+        }
+    }
+
+    index->scanned += len;
+}
+
+/* The entry has been fully inflated and scanned */
+void inflate_index_finish(inflateIndex *index)
+{
+    while (index->pending < index->count) {
+        index->points[index->pending++].row = index->current_row;
+    }
+    index->complete = true;
+}
+
+/* Last point whose following data contains the start of the given row
+ * Returns NULL if decoding has to start at the beginning of the entry
+ */
+const inflatePoint *inflate_index_find_row(const inflateIndex *index, uint64_t row)
+{
+    if (!index || !index->complete) {
+        return NULL;
+    }
+
+    /* Point rows never decrease, so binary search for the last row < target */
+    size_t lo = 0;
+    size_t hi = index->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->points[mid].row < row) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo > 0 ? &index->points[lo - 1] : NULL;
+}
+
+/* Fixed-width little-endian fields */
+static int write_u64(FILE *fp, uint64_t value)
+{
+    unsigned char buf[8];
+    for (int i = 0; i < 8; i++) {
+        buf[i] = (unsigned char)(value >> (8 * i));
+    }
+    return fwrite(buf, 1, sizeof(buf), fp) == sizeof(buf) ? 0 : -1;
+}
+
+static int read_u64(FILE *fp, uint64_t *value)
+{
+    unsigned char buf[8];
+    if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf)) {
+        return -1;
+    }
+    *value = 0;
+    for (int i = 7; i >= 0; i--) {
+        *value = (*value << 8) | buf[i];
+    }
+    return 0;
+}
+
+/* Write a complete index under a temporary name, then rename it into place */
+int inflate_index_save(const inflateIndex *index, const char *path)
+{
+    if (!index || !index->complete || !path) {
+        return -1;
+    }
+
+    /* A unique name in the index directory, so concurrent runs never share it */
+    size_t tmp_len  = strlen(path) + 8;
+    char  *tmp_path = malloc(tmp_len);
+    if (!tmp_path) {
+        return -1;
+    }
+    snprintf(tmp_path, tmp_len, "%s.XXXXXX", path);
+
+    int   fd = mkstemp(tmp_path);
+    FILE *fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!fp) {
+        if (fd >= 0) {
+            close(fd);
+            remove(tmp_path);
+        }
+        free(tmp_path);
+        return -1;
+    }
+
+    int status = 0;
+    if (fwrite(INDEX_MAGIC, 1, 8, fp) != 8 || write_u64(fp, INDEX_VERSION) < 0 ||
+        write_u64(fp, index->size) < 0 || write_u64(fp, index->comp_size) < 0 ||
+        write_u64(fp, index->crc32) < 0 || write_u64(fp, index->span) < 0 ||
+        write_u64(fp, index->count) < 0) {
+        status = -1;
+    }
+
+    for (size_t i = 0; status == 0 && i < index->count; i++) {
+        const inflatePoint *point = &index->points[i];
+        if (write_u64(fp, point->out_offset) < 0 || write_u64(fp, point->in_offset) < 0 ||
+            write_u64(fp, point->row) < 0 || write_u64(fp, (uint64_t)point->bits) < 0 ||
+            write_u64(fp, point->window_len) < 0 ||
+            fwrite(point->window, 1, point->window_len, fp) != point->window_len) {
+            status = -1;
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        status = -1;
+    }
+    if (status == 0 && rename(tmp_path, path) != 0) {
+        status = -1;
+    }
+    if (status < 0) {
+        remove(tmp_path);
+    }
+
+    free(tmp_path);
+    return status;
+}
+
+/* Load an index, checking that it was built for this exact entry */
+inflateIndex *inflate_index_load(const char *path,
+                                 uint64_t    size,
+                                 uint64_t    comp_size,
+                                 uint32_t    crc32)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    char     magic[8];
+    uint64_t version, file_size, file_comp_size, file_crc, span, count;
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+        memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || read_u64(fp, &version) < 0 ||
+        read_u64(fp, &file_size) < 0 || read_u64(fp, &file_comp_size) < 0 ||
+        read_u64(fp, &file_crc) < 0 || read_u64(fp, &span) < 0 || read_u64(fp, &count) < 0 ||
+        version != INDEX_VERSION || file_size != size || file_comp_size != comp_size ||
+        file_crc != crc32) {
+        fclose(fp);
+        return NULL;
+    }
+
+    inflateIndex *index = inflate_index_create(span, size, comp_size, crc32);
+    if (!index) {
+        fclose(fp);
+        return NULL;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t out_offset, in_offset, row, bits, window_len;
+        if (read_u64(fp, &out_offset) < 0 || read_u64(fp, &in_offset) < 0 ||
+            read_u64(fp, &row) < 0 || read_u64(fp, &bits) < 0 || read_u64(fp, &window_len) < 0 ||
+            bits > 7 || window_len > INFLATE_WINDOW_SIZE || out_offset > size ||
+            in_offset > comp_size) {
+            inflate_index_free(index);
+            fclose(fp);
+            return NULL;
+        }
+
+        unsigned char window[INFLATE_WINDOW_SIZE];
+        if (fread(window, 1, (size_t)window_len, fp) != window_len ||
+            inflate_index_add_point(index, out_offset, in_offset, (int)bits, window,
+                                    (unsigned)window_len) < 0) {
+            inflate_index_free(index);
+            fclose(fp);
+            return NULL;
+        }
+        index->points[index->count - 1].row = row;
+    }
+
+    fclose(fp);
+    index->pending  = index->count;
+    index->complete = true;
+    return index;
+}
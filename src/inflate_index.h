@@ -0,0 +1,75 @@
+#ifndef _INFLATE_INDEX_H
+#define _INFLATE_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* DEFLATE history needed to resume decoding at an arbitrary block boundary */
+#define INFLATE_WINDOW_SIZE 32768
+
+/* Resume point inside a deflate stream */
+typedef struct {
+    uint64_t       out_offset; /* Uncompressed offset */
+    uint64_t       in_offset;  /* Compressed offset of the first byte not fully consumed */
+    uint64_t       row;        /* Row open at out_offset (0 = before the first row) */
+    int            bits;       /* Unused bits (0-7) of the byte before in_offset */
+    unsigned       window_len;
+    unsigned char *window; /* Last window_len bytes of output before out_offset */
+} inflatePoint;
+
+/* Row scanner state, tracks <row r="..."> tags across buffer boundaries */
+typedef struct {
+    int      state;
+    int      match;
+    uint64_t value;
+    uint64_t tag_offset; /* Uncompressed offset of the current tag's '<' */
+} rowScanner;
+
+/* Checkpoint index for one deflated ZIP entry */
+typedef struct {
+    inflatePoint *points;
+    size_t        count;
+    size_t        capacity;
+    uint64_t      span; /* Minimum uncompressed distance between points */
+    uint64_t      size; /* Entry identity: uncompressed size, compressed size, CRC-32 */
+    uint64_t      comp_size;
+    uint32_t      crc32;
+    bool          complete; /* Built from a fully decoded entry (or loaded) */
+
+    /* Builder state */
+    rowScanner scanner;
+    uint64_t   scanned;     /* Uncompressed bytes scanned for rows */
+    uint64_t   current_row; /* Row open at the scan position */
+    size_t     pending;     /* First point whose row is not known yet */
+} inflateIndex;
+
+/* Lifetime */
+inflateIndex *inflate_index_create(uint64_t span,
+                                   uint64_t size,
+                                   uint64_t comp_size,
+                                   uint32_t crc32);
+void          inflate_index_free(inflateIndex *index);
+
+/* Building (driven by the ZIP reader while it inflates the entry) */
+bool inflate_index_wants_point(const inflateIndex *index, uint64_t out_offset);
+int  inflate_index_add_point(inflateIndex        *index,
+                             uint64_t             out_offset,
+                             uint64_t             in_offset,
+                             int                  bits,
+                             const unsigned char *window,
+                             unsigned             window_len);
+void inflate_index_scan(inflateIndex *index, const char *data, size_t len);
+void inflate_index_finish(inflateIndex *index);
+
+/* Lookup: last point from which the given row (1-based) can be reached */
+const inflatePoint *inflate_index_find_row(const inflateIndex *index, uint64_t row);
+
+/* Persistence (load returns NULL if missing, corrupt or built for a different entry) */
+inflateIndex *inflate_index_load(const char *path,
+                                 uint64_t    size,
+                                 uint64_t    comp_size,
+                                 uint32_t    crc32);
+int           inflate_index_save(const inflateIndex *index, const char *path);
+
+#endif /* _INFLATE_INDEX_H */
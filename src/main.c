@@ -2,8 +2,10 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 /* Project headers */
+#include "inflate_backend.h"
 #include "xlsx2csv.h"
 
 static void print_usage(const char *prog_name)
@@ -19,6 +21,11 @@ static void print_usage(const char *prog_name)
     printf("                [-l LINETERMINATOR] [-m] [-n SHEETNAME] [-i]\n");
     printf("                [--skipemptycolumns] [-p SHEETDELIMITER] [-q QUOTING]\n");
     printf("                [-s SHEETID] [--include-hidden-rows]\n");
+    printf("                [--inflate-backend INFLATE_BACKEND] [--stats]\n");
+    printf("                [--inflate-index SPAN_MB] [--index-dir INDEX_DIR] [--jobs JOBS]\n");
+    printf("                [--fast-scanner] [--lazy-shared-strings]\n");
+    printf("                [--strings-memory MB] [--cache-dir CACHE_DIR]\n");
+    printf("                [--excel-formats] [--shortest-floats] [--output-buffer KB]\n");
     printf("                xlsxfile [outfile]\n\n");
     printf("xlsx to csv converter\n\n");
     printf("positional arguments:\n");
@@ -61,6 +68,29 @@ static void print_usage(const char *prog_name)
     printf("                        quoting mode: none, minimal, nonnumeric, all\n");
     printf("  -s, --sheet SHEETID   sheet number to convert\n");
     printf("  --include-hidden-rows include hidden rows\n");
+    printf("  --inflate-backend INFLATE_BACKEND\n");
+    printf("                        decoder for compressed entries: %s (default: %s)\n",
+           inflate_backend_list(), inflate_backend_find(NULL)->name);
+    printf("  --stats               print decompression statistics to stderr\n");
+    printf("  --inflate-index SPAN_MB\n");
+    printf("                        build a checkpoint index every SPAN_MB of sheet XML\n");
+    printf("  --index-dir INDEX_DIR\n");
+    printf("                        checkpoint index directory (default: next to xlsxfile);\n");
+    printf("                        also keeps the indexes --jobs builds\n");
+    printf("  --jobs JOBS           threads for parsing large sheets, 0 = all CPUs (default: 1)\n");
+    printf("                        compressed sheets over 64 MB of XML take an extra inflate\n");
+    printf("                        pass to split, unless --inflate-index or --index-dir keeps\n");
+    printf("                        the index for later runs\n");
+    printf("  --fast-scanner        scan sheet rows without the generic XML parser\n");
+    printf("  --lazy-shared-strings decode shared strings when first referenced\n");
+    printf("  --strings-memory MB   keep at most MB of shared strings in memory, map the rest\n");
+    printf("                        from a temporary file (default: no limit)\n");
+    printf("  --cache-dir CACHE_DIR keep parsed shared strings and styles in CACHE_DIR\n");
+    printf("                        for later runs on the same xlsxfile\n");
+    printf("  --excel-formats       render numbers and dates with their Excel number format\n");
+    printf("  --shortest-floats     write the fewest digits that read back as the same number\n");
+    printf("                        instead of 15 significant digits\n");
+    printf("  --output-buffer KB    collect KB of CSV before each write (default: 1024)\n");
 }
 
 int main(int argc, char **argv)
@@ -96,6 +126,18 @@ int main(int argc, char **argv)
     options.ignore_formats              = NULL;
     options.ignore_formats_count        = 0;
     options.skip_hidden_rows            = true;
+    options.inflate_backend             = NULL;
+    options.print_stats                 = false;
+    options.index_span_mb               = 0;
+    options.index_dir                   = NULL;
+    options.jobs                        = 1;
+    options.fast_scanner                = false;
+    options.lazy_strings                = false;
+    options.sst_memory_mb               = 0;
+    options.cache_dir                   = NULL;
+    options.excel_formats               = false;
+    options.shortest_floats             = false;
+    options.write_buffer_kb             = 1024;
 
     /* Parse command line options */
     static struct option long_options[] = {
@@ -124,6 +166,18 @@ int main(int argc, char **argv)
         {"quoting",               required_argument, 0, 'q' },
         {"sheet",                 required_argument, 0, 's' },
         {"include-hidden-rows",   no_argument,       0, 1008},
+        {"inflate-backend",       required_argument, 0, 1009},
+        {"stats",                 no_argument,       0, 1010},
+        {"inflate-index",         required_argument, 0, 1011},
+        {"index-dir",             required_argument, 0, 1012},
+        {"jobs",                  required_argument, 0, 1013},
+        {"fast-scanner",          no_argument,       0, 1014},
+        {"lazy-shared-strings",   no_argument,       0, 1015},
+        {"strings-memory",        required_argument, 0, 1016},
+        {"cache-dir",             required_argument, 0, 1017},
+        {"excel-formats",         no_argument,       0, 1018},
+        {"shortest-floats",       no_argument,       0, 1019},
+        {"output-buffer",         required_argument, 0, 1020},
         {0,                       0,                 0, 0   }
     };
 
@@ -232,6 +286,67 @@ int main(int argc, char **argv)
             case 1008:
                 options.skip_hidden_rows = false;
                 break;
+            case 1009:
+                if (!inflate_backend_find(optarg)) {
+                    fprintf(stderr, "Error: invalid inflate backend (available: %s)\n",
+                            inflate_backend_list());
+                    return 1;
+                }
+                options.inflate_backend = optarg;
+                break;
+            case 1010:
+                options.print_stats = true;
+                break;
+            case 1011:
+                options.index_span_mb = atoi(optarg);
+                if (options.index_span_mb <= 0) {
+                    fprintf(stderr, "Error: invalid index span\n");
+                    return 1;
+                }
+                break;
+            case 1012:
+                options.index_dir = optarg;
+                break;
+            case 1013:
+                options.jobs = atoi(optarg);
+                if (options.jobs < 0) {
+                    fprintf(stderr, "Error: invalid number of jobs\n");
+                    return 1;
+                }
+                if (options.jobs == 0) {
+                    long cpus    = sysconf(_SC_NPROCESSORS_ONLN);
+                    options.jobs = cpus > 0 ? (int)cpus : 1;
+                }
+                break;
+            case 1014:
+                options.fast_scanner = true;
+                break;
+            case 1015:
+                options.lazy_strings = true;
+                break;
+            case 1016:
+                options.sst_memory_mb = atoi(optarg);
+                if (options.sst_memory_mb < 0) {
+                    fprintf(stderr, "Error: invalid shared strings memory limit\n");
+                    return 1;
+                }
+                break;
+            case 1017:
+                options.cache_dir = optarg;
+                break;
+            case 1018:
+                options.excel_formats = true;
+                break;
+            case 1019:
+                options.shortest_floats = true;
+                break;
+            case 1020:
+                options.write_buffer_kb = atoi(optarg);
+                if (options.write_buffer_kb <= 0 || options.write_buffer_kb > 1024 * 1024) {
+                    fprintf(stderr, "Error: invalid output buffer size\n");
+                    return 1;
+                }
+                break;
             default:
                 print_usage(argv[0]);
                 return 1;
@@ -278,6 +393,11 @@ int main(int argc, char **argv)
         result = -1;
     }
 
+    if (options.print_stats) {
+        fflush(stdout);
+        xlsx2csv_print_stats(conv, stderr);
+    }
+
     /* Cleanup */
     xlsx2csv_free(conv);
 
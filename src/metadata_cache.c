@@ -0,0 +1,389 @@
+/* Shared strings and styles kept between runs of the same workbook.
+ *
+ * Converting sheets one invocation at a time parses sharedStrings.xml and
+ * styles.xml again on every run, although only the worksheets differ. With a
+ * cache directory, the parsed tables are written to one file per workbook,
+ * laid out so the string table can be used straight from a mapping. A later
+ * run maps the file instead of parsing, provided the workbook has the same
+ * path, size and modification time and both parts the same size and CRC.
+ *
+ * The file is written in native byte order and only read back by builds with
+ * the same layout; anything else is treated as a miss and rebuilt.
+ */
+
+/* realpath() */
+#define _GNU_SOURCE
+
+/* Standard library headers */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Project headers */
+#include "format_handler.h"
+#include "metadata_cache.h"
+#include "zip_reader.h"
+
+#define CACHE_MAGIC   "XLSXMETA"
+#define CACHE_VERSION 2 /* 2: shared strings leave out phonetic runs */
+
+/* Written as a number and compared on load to reject other byte orders */
+#define CACHE_BYTE_ORDER UINT64_C(0x0102030405060708)
+
+/* Marks a part the workbook does not have */
+#define CACHE_NO_PART UINT64_MAX
+
+/* What a cache file must match to be used */
+typedef struct {
+    char     path[PATH_MAX];
+    uint64_t size;
+    uint64_t mtime_sec;
+    uint64_t mtime_nsec;
+    uint64_t sst_size;
+    uint64_t sst_crc;
+    uint64_t styles_size;
+    uint64_t styles_crc;
+} cacheKey;
+
+/* Read position in a mapped cache file */
+typedef struct {
+    const unsigned char *data;
+    size_t               len;
+    size_t               pos;
+    bool                 failed;
+} cacheReader;
+
+static size_t pad8(size_t len)
+{
+    return (len + 7) & ~(size_t)7;
+}
+
+/* FNV-1a, to tell workbooks with the same name apart */
+static uint64_t hash_path(const char *path)
+{
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash = (hash ^ *p) * UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+static void key_part(void *zip_handle, const char *name, uint64_t *size, uint64_t *crc)
+{
+    zipEntryInfo info;
+    if (zip_file_stat(zip_handle, name, &info) < 0) {
+        *size = CACHE_NO_PART;
+        *crc  = CACHE_NO_PART;
+        return;
+    }
+    *size = info.size;
+    *crc  = info.crc32;
+}
+
+/* Identify the workbook; -1 if it cannot be cached (STDIN, no cache directory) */
+static int cache_key(const xlsx2csvConverter *conv, cacheKey *key, char *file, size_t file_size)
+{
+    const char *dir = conv->options.cache_dir;
+    if (!dir || strcmp(conv->filename, "-") == 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(conv->filename, &st) != 0 || !realpath(conv->filename, key->path)) {
+        return -1;
+    }
+    key->size       = (uint64_t)st.st_size;
+    key->mtime_sec  = (uint64_t)st.st_mtim.tv_sec;
+    key->mtime_nsec = (uint64_t)st.st_mtim.tv_nsec;
+
+    key_part(conv->zip_handle, "xl/sharedStrings.xml", &key->sst_size, &key->sst_crc);
+    key_part(conv->zip_handle, "xl/styles.xml", &key->styles_size, &key->styles_crc);
+
+    const char *slash   = strrchr(key->path, '/');
+    int         written = snprintf(file, file_size, "%s/%s.%016llx.meta", dir,
+                                   slash ? slash + 1 : key->path,
+                                   (unsigned long long)hash_path(key->path));
+    return (written > 0 && (size_t)written < file_size) ? 0 : -1;
+}
+
+static int write_u64(FILE *fp, uint64_t value)
+{
+    return fwrite(&value, sizeof(value), 1, fp) == 1 ? 0 : -1;
+}
+
+/* Write len bytes, padded with zeros to a multiple of 8 */
+static int write_padded(FILE *fp, const void *data, size_t len)
+{
+    static const char zeros[8] = {0};
+    if (len > 0 && fwrite(data, 1, len, fp) != len) {
+        return -1;
+    }
+    size_t pad = pad8(len) - len;
+    return (pad == 0 || fwrite(zeros, 1, pad, fp) == pad) ? 0 : -1;
+}
+
+static int write_key(FILE *fp, const cacheKey *key)
+{
+    size_t path_len = strlen(key->path);
+    if (fwrite(CACHE_MAGIC, 1, 8, fp) != 8 || write_u64(fp, CACHE_VERSION) < 0 ||
+        write_u64(fp, CACHE_BYTE_ORDER) < 0 || write_u64(fp, sizeof(sharedString)) < 0 ||
+        write_u64(fp, key->size) < 0 || write_u64(fp, key->mtime_sec) < 0 ||
+        write_u64(fp, key->mtime_nsec) < 0 || write_u64(fp, key->sst_size) < 0 ||
+        write_u64(fp, key->sst_crc) < 0 || write_u64(fp, key->styles_size) < 0 ||
+        write_u64(fp, key->styles_crc) < 0 || write_u64(fp, path_len) < 0 ||
+        write_padded(fp, key->path, path_len) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int write_shared_strings(FILE *fp, const sharedStrings *sst)
+{
+    size_t entries_len = (size_t)sst->count * sizeof(sharedString);
+    if (write_u64(fp, (uint64_t)sst->count) < 0 || write_u64(fp, sst->arena_len) < 0 ||
+        write_padded(fp, sst->entries, entries_len) < 0 ||
+        write_padded(fp, sst->arena, sst->arena_len) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int write_styles(FILE *fp, const styleInfo *styles)
+{
+    if (write_u64(fp, (uint64_t)styles->format_count) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < styles->format_count; i++) {
+        const numFormat *format = &styles->formats[i];
+        size_t           len    = format->format_code ? strlen(format->format_code) + 1 : 0;
+        if (write_u64(fp, (uint64_t)(int64_t)format->id) < 0 ||
+            write_u64(fp, (uint64_t)format->type) < 0 || write_u64(fp, len) < 0 ||
+            write_padded(fp, format->format_code, len) < 0) {
+            return -1;
+        }
+    }
+
+    if (write_u64(fp, (uint64_t)styles->cell_xfs_count) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < styles->cell_xfs_count; i++) {
+        if (write_u64(fp, (uint64_t)(int64_t)styles->cell_xfs[i]) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Save the parsed tables; only a fully built (not lazy) string table is saved */
+int metadata_cache_save(const xlsx2csvConverter *conv)
+{
+    const sharedStrings *sst = &conv->shared_strings;
+    cacheKey             key;
+    char                 path[PATH_MAX + 64];
+    if (sst->lazy || cache_key(conv, &key, path, sizeof(path)) < 0) {
+        return -1;
+    }
+
+    /* A unique name in the cache directory, so concurrent runs never share it */
+    char tmp_path[sizeof(path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        return -1;
+    }
+    FILE *fp = fdopen(fd, "wb");
+    if (!fp) {
+        close(fd);
+        remove(tmp_path);
+        return -1;
+    }
+
+    int status = 0;
+    if (write_key(fp, &key) < 0 || write_shared_strings(fp, sst) < 0 ||
+        write_styles(fp, &conv->styles) < 0) {
+        status = -1;
+    }
+
+    if (fclose(fp) != 0) {
+        status = -1;
+    }
+    if (status == 0 && rename(tmp_path, path) != 0) {
+        status = -1;
+    }
+    if (status < 0) {
+        remove(tmp_path);
+    }
+    return status;
+}
+
+static uint64_t read_u64(cacheReader *reader)
+{
+    uint64_t value = 0;
+    if (reader->failed || reader->len - reader->pos < sizeof(value)) {
+        reader->failed = true;
+        return 0;
+    }
+    memcpy(&value, reader->data + reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    return value;
+}
+
+/* Take len bytes and their padding, NULL if the file is too short */
+static const void *read_bytes(cacheReader *reader, uint64_t len)
+{
+    if (reader->failed || len > reader->len - reader->pos ||
+        pad8((size_t)len) > reader->len - reader->pos) {
+        reader->failed = true;
+        return NULL;
+    }
+    const void *data = reader->data + reader->pos;
+    reader->pos += pad8((size_t)len);
+    return data;
+}
+
+static bool read_key(cacheReader *reader, const cacheKey *key)
+{
+    const char *magic = read_bytes(reader, 8);
+    if (!magic || memcmp(magic, CACHE_MAGIC, 8) != 0 || read_u64(reader) != CACHE_VERSION ||
+        read_u64(reader) != CACHE_BYTE_ORDER || read_u64(reader) != sizeof(sharedString) ||
+        read_u64(reader) != key->size || read_u64(reader) != key->mtime_sec ||
+        read_u64(reader) != key->mtime_nsec || read_u64(reader) != key->sst_size ||
+        read_u64(reader) != key->sst_crc || read_u64(reader) != key->styles_size ||
+        read_u64(reader) != key->styles_crc) {
+        return false;
+    }
+
+    size_t      path_len = strlen(key->path);
+    const char *path     = read_u64(reader) == path_len ? read_bytes(reader, path_len) : NULL;
+    return path && memcmp(path, key->path, path_len) == 0;
+}
+
+/* Point sst into the mapping after checking every entry lies inside the arena */
+static bool read_shared_strings(cacheReader *reader, sharedStrings *sst)
+{
+    uint64_t count     = read_u64(reader);
+    uint64_t arena_len = read_u64(reader);
+    if (reader->failed || count > INT_MAX || count > (reader->len / sizeof(sharedString))) {
+        return false;
+    }
+
+    const sharedString *entries = read_bytes(reader, count * sizeof(sharedString));
+    const char         *arena   = read_bytes(reader, arena_len);
+    if (!entries || !arena) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        const sharedString *entry = &entries[i];
+        if (entry->offset >= arena_len || entry->len >= arena_len - entry->offset ||
+            arena[entry->offset + entry->len] != '\0') {
+            return false;
+        }
+    }
+
+    /* The mapping is read-only; nothing writes through these pointers */
+    sst->entries   = (sharedString *)(uintptr_t)entries;
+    sst->arena     = (char *)(uintptr_t)arena;
+    sst->arena_len = (size_t)arena_len;
+    sst->count     = (int)count;
+    return true;
+}
+
+static bool read_styles(cacheReader *reader, styleInfo *styles)
+{
+    uint64_t format_count = read_u64(reader);
+    if (reader->failed || format_count > INT_MAX || format_count > reader->len / 24) {
+        return false;
+    }
+    if (format_count > 0) {
+        styles->formats = calloc((size_t)format_count, sizeof(numFormat));
+        if (!styles->formats) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < format_count; i++) {
+        numFormat *format = &styles->formats[styles->format_count++];
+        format->id        = (int)(int64_t)read_u64(reader);
+        uint64_t type     = read_u64(reader);
+        uint64_t len      = read_u64(reader);
+        if (type > FORMAT_PERCENTAGE) {
+            return false;
+        }
+        format->type = (formatType)type;
+        if (len == 0) {
+            continue;
+        }
+        const char *code = read_bytes(reader, len);
+        if (!code || code[len - 1] != '\0' || !(format->format_code = malloc((size_t)len))) {
+            return false;
+        }
+        memcpy(format->format_code, code, (size_t)len);
+    }
+
+    uint64_t xf_count = read_u64(reader);
+    if (reader->failed || xf_count > INT_MAX || xf_count > reader->len / 8) {
+        return false;
+    }
+    if (xf_count > 0) {
+        styles->cell_xfs = malloc((size_t)xf_count * sizeof(int));
+        if (!styles->cell_xfs) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < xf_count; i++) {
+        styles->cell_xfs[styles->cell_xfs_count++] = (int)(int64_t)read_u64(reader);
+    }
+    return !reader->failed && reader->pos == reader->len;
+}
+
+/* Take shared strings and styles from the cache file, if it matches this workbook */
+int metadata_cache_load(xlsx2csvConverter *conv)
+{
+    cacheKey key;
+    char     path[PATH_MAX + 64];
+    if (cache_key(conv, &key, path, sizeof(path)) < 0) {
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    struct stat st;
+    void       *map = MAP_FAILED;
+    if (fstat(fileno(fp), &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    }
+    fclose(fp);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    cacheReader   reader = {map, (size_t)st.st_size, 0, false};
+    sharedStrings sst    = {0};
+    styleInfo     styles = {0};
+    if (!read_key(&reader, &key) || !read_shared_strings(&reader, &sst) ||
+        !read_styles(&reader, &styles) ||
+        styles_resolve(&styles, conv->options.excel_formats) < 0) {
+        styles_free(&styles);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    /* The string table keeps the mapping; an empty one does not need it */
+    if (sst.count > 0) {
+        sst.maps[0]     = map;
+        sst.map_lens[0] = (size_t)st.st_size;
+    } else {
+        memset(&sst, 0, sizeof(sst));
+        munmap(map, (size_t)st.st_size);
+    }
+    conv->shared_strings = sst;
+    conv->styles         = styles;
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef _METADATA_CACHE_H
+#define _METADATA_CACHE_H
+
+#include "xlsx2csv.h"
+
+/* Shared strings and styles cached in conv->options.cache_dir between runs.
+ * load returns 0 if both were taken from a cache file written for this
+ * archive (same path, size, mtime and entry CRCs), -1 if they must be parsed.
+ */
+int metadata_cache_load(xlsx2csvConverter *conv);
+int metadata_cache_save(const xlsx2csvConverter *conv);
+
+#endif /* _METADATA_CACHE_H */
@@ -0,0 +1,967 @@
+/* Excel number formats, compiled once and run per cell.
+ *
+ * A format code such as #,##0.00;[Red](#,##0.00);"-" is parsed once into up
+ * to four sections of instructions: literal text, digit placeholders, the
+ * decimal point, exponent, date and time fields and AM/PM. Rendering a cell
+ * picks the section for the value (or its condition), scales it for % and
+ * trailing commas, rounds it once to the digits the section shows and runs
+ * the instructions into the caller's buffer. Nothing is parsed per cell.
+ *
+ * Numbers are rounded half away from zero on their 15 significant digits,
+ * and dates follow Excel's calendar, including its 1900-02-29.
+ */
+
+/* Standard library headers */
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Project headers */
+#include "dtoa.h"
+#include "number_format.h"
+
+#define FORMAT_MAX_SECTIONS 4
+
+/* Longest digit string a number renders to (DBL_MAX has 309 integer digits) */
+#define FORMAT_MAX_DIGITS 400
+
+/* Largest serial Excel shows as a date (9999-12-31) */
+#define FORMAT_MAX_SERIAL 2958466.0
+
+/* Instructions */
+typedef enum {
+    OP_LITERAL,        /* len bytes of text at offset */
+    OP_DIGIT,          /* Integer placeholder, arg '0', '#' or '?' */
+    OP_POINT,          /* Decimal point */
+    OP_FRACTION,       /* Placeholder after the point, arg '0', '#' or '?' */
+    OP_EXPONENT,       /* arg 'E' or 'e', len 1 if "+" is shown for positive exponents */
+    OP_EXP_DIGIT,      /* Exponent placeholder, arg '0', '#' or '?' */
+    OP_GENERAL,        /* The number as General shows it */
+    OP_YEAR,           /* arg 2 or 4 digits */
+    OP_MONTH,          /* arg 1-2 digits, 3 abbreviated, 4 full name, 5 initial */
+    OP_MINUTE,         /* arg 1-2 digits */
+    OP_DAY,            /* arg 1-2 digits, 3 abbreviated weekday, 4 full weekday */
+    OP_HOUR,           /* arg 1-2 digits */
+    OP_SECOND,         /* arg 1-2 digits */
+    OP_SUBSECOND,      /* arg 1-3 digits */
+    OP_ELAPSED_HOURS,  /* arg minimum digits */
+    OP_ELAPSED_MINUTES,
+    OP_ELAPSED_SECONDS,
+    OP_AMPM /* arg 0 AM/PM, 1 am/pm, 2 A/P, 3 a/p */
+} formatOpCode;
+
+typedef struct {
+    uint8_t  code;
+    uint8_t  arg;
+    uint16_t len;
+    uint32_t offset;
+} formatOp;
+
+typedef enum {
+    COND_NONE,
+    COND_LT,
+    COND_LE,
+    COND_GT,
+    COND_GE,
+    COND_EQ,
+    COND_NE
+} formatCondition;
+
+typedef struct {
+    size_t          first; /* First instruction */
+    size_t          count;
+    formatCondition condition;
+    double          operand;
+    bool            date;          /* Has date or time fields */
+    bool            twelve_hour;   /* Has AM/PM */
+    bool            thousands;     /* Group integer digits by three */
+    int             scale;         /* Trailing commas: divide by 1000 each */
+    int             percent;       /* Each % multiplies by 100 */
+    int             int_digits;    /* Integer placeholders */
+    int             int_zeros;     /* '0' among them */
+    bool            int_optional;  /* Leading integer placeholder is '#' or '?' */
+    int             frac_digits;   /* Placeholders after the point */
+    int             exp_digits;    /* Exponent placeholders, > 0 for scientific */
+    int             subsec_digits; /* Fractional second digits */
+    bool            general;       /* Shows the number as General */
+} formatSection;
+
+struct numberFormat {
+    formatSection sections[FORMAT_MAX_SECTIONS];
+    int           section_count;
+    formatOp     *ops;
+    size_t        op_count;
+    size_t        op_capacity;
+    char         *text;
+    size_t        text_len;
+    size_t        text_capacity;
+};
+
+/* Output into the caller's buffer */
+typedef struct {
+    char  *data;
+    size_t size;
+    size_t len;
+    bool   overflow;
+} formatOutput;
+
+static const char *const month_names[] = {"January",   "February", "March",    "April",
+                                          "May",       "June",     "July",     "August",
+                                          "September", "October",  "November", "December"};
+
+static const char *const day_names[] = {"Sunday",   "Monday", "Tuesday", "Wednesday",
+                                        "Thursday", "Friday", "Saturday"};
+
+static bool add_op(numberFormat *format, formatOpCode code, int arg)
+{
+    if (format->op_count == format->op_capacity) {
+        size_t    capacity = format->op_capacity ? format->op_capacity * 2 : 16;
+        formatOp *ops      = realloc(format->ops, capacity * sizeof(formatOp));
+        if (!ops) {
+            return false;
+        }
+        format->ops         = ops;
+        format->op_capacity = capacity;
+    }
+
+    formatOp *op = &format->ops[format->op_count++];
+    op->code     = (uint8_t)code;
+    op->arg      = (uint8_t)arg;
+    op->len      = 0;
+    op->offset   = 0;
+    return true;
+}
+
+/* Append literal text, extending the previous literal if it is the last one written */
+static bool add_literal(numberFormat *format, size_t first, const char *s, size_t len)
+{
+    if (len == 0) {
+        return true;
+    }
+    if (format->text_len + len > format->text_capacity) {
+        size_t capacity = format->text_capacity ? format->text_capacity * 2 : 64;
+        while (capacity < format->text_len + len) {
+            capacity *= 2;
+        }
+        char *text = realloc(format->text, capacity);
+        if (!text) {
+            return false;
+        }
+        format->text          = text;
+        format->text_capacity = capacity;
+    }
+
+    formatOp *last = format->op_count > first ? &format->ops[format->op_count - 1] : NULL;
+    if (!last || last->code != OP_LITERAL || last->offset + last->len != format->text_len ||
+        last->len + len > UINT16_MAX) {
+        if (format->text_len > UINT32_MAX || !add_op(format, OP_LITERAL, 0)) {
+            return false;
+        }
+        last         = &format->ops[format->op_count - 1];
+        last->offset = (uint32_t)format->text_len;
+    }
+    memcpy(format->text + format->text_len, s, len);
+    format->text_len += len;
+    last->len = (uint16_t)(last->len + len);
+    return true;
+}
+
+static bool is_placeholder(char c)
+{
+    return c == '0' || c == '#' || c == '?';
+}
+
+/* Length of the run of c (either case) starting at p */
+static size_t run_length(const char *p, const char *end, char c)
+{
+    size_t n = 0;
+    while (p + n < end && tolower((unsigned char)p[n]) == c) {
+        n++;
+    }
+    return n;
+}
+
+static bool starts_with_nocase(const char *p, const char *end, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    return (size_t)(end - p) >= len && strncasecmp(p, prefix, len) == 0;
+}
+
+/* Bracketed part: elapsed time, condition, currency or locale; colors are ignored */
+static bool compile_bracket(numberFormat  *format,
+                            formatSection *section,
+                            const char    *p,
+                            const char    *end)
+{
+    size_t len = (size_t)(end - p);
+    char   c   = (char)tolower((unsigned char)p[0]);
+
+    if (len > 0 && (c == 'h' || c == 'm' || c == 's') && run_length(p, end, c) == len) {
+        formatOpCode code = c == 'h' ? OP_ELAPSED_HOURS
+                          : c == 'm' ? OP_ELAPSED_MINUTES
+                                     : OP_ELAPSED_SECONDS;
+        section->date     = true;
+        return add_op(format, code, len > 9 ? 9 : (int)len);
+    }
+
+    if (len > 0 && (p[0] == '<' || p[0] == '>' || p[0] == '=')) {
+        formatCondition condition = COND_EQ;
+        size_t          skip      = 1;
+        if (p[0] == '<' && len > 1 && p[1] == '=') {
+            condition = COND_LE;
+            skip      = 2;
+        } else if (p[0] == '<' && len > 1 && p[1] == '>') {
+            condition = COND_NE;
+            skip      = 2;
+        } else if (p[0] == '>' && len > 1 && p[1] == '=') {
+            condition = COND_GE;
+            skip      = 2;
+        } else if (p[0] == '<') {
+            condition = COND_LT;
+        } else if (p[0] == '>') {
+            condition = COND_GT;
+        }
+
+        char operand[64];
+        if (len - skip == 0 || len - skip >= sizeof(operand)) {
+            return false;
+        }
+        memcpy(operand, p + skip, len - skip);
+        operand[len - skip] = '\0';
+        char *operand_end;
+        section->operand = strtod(operand, &operand_end);
+        if (operand_end == operand || *operand_end != '\0') {
+            return false;
+        }
+        section->condition = condition;
+        return true;
+    }
+
+    if (len > 0 && p[0] == '$') {
+        /* [$€-407]: currency symbol before the locale */
+        const char *dash = memchr(p, '-', len);
+        return add_literal(format, section->first, p + 1, (size_t)((dash ? dash : end) - p - 1));
+    }
+
+    return true;
+}
+
+/* Minutes are m or mm after hours or before seconds; otherwise they are months */
+static void resolve_minutes(numberFormat *format, const formatSection *section)
+{
+    formatOp *ops   = format->ops + section->first;
+    size_t    count = format->op_count - section->first;
+
+    for (size_t i = 0; i < count; i++) {
+        if (ops[i].code != OP_MONTH || ops[i].arg > 2) {
+            continue;
+        }
+
+        bool minute = false;
+        for (size_t j = i; j-- > 0;) {
+            if (ops[j].code != OP_LITERAL) {
+                minute = ops[j].code == OP_HOUR || ops[j].code == OP_ELAPSED_HOURS;
+                break;
+            }
+        }
+        for (size_t j = i + 1; !minute && j < count; j++) {
+            if (ops[j].code != OP_LITERAL) {
+                minute = ops[j].code == OP_SECOND || ops[j].code == OP_ELAPSED_SECONDS;
+                break;
+            }
+        }
+        if (minute) {
+            ops[i].code = OP_MINUTE;
+        }
+    }
+}
+
+/* Compile one section; false if it uses something not supported */
+static bool compile_section(numberFormat  *format,
+                            formatSection *section,
+                            const char    *p,
+                            const char    *end)
+{
+    bool after_point = false;
+    bool in_exponent = false;
+    bool numeric     = false; /* Has digit placeholders */
+    bool after_digit = false; /* Last token was a placeholder or scaling comma */
+    bool after_sec   = false; /* Last token was seconds, so ".0" is a fraction of a second */
+    int  scale       = 0;
+
+    section->first = format->op_count;
+    while (p < end) {
+        char c     = *p;
+        char lower = (char)tolower((unsigned char)c);
+        bool ok    = true;
+        bool digit = false;
+
+        if (c == '"') {
+            const char *close = memchr(p + 1, '"', (size_t)(end - p - 1));
+            if (!close) {
+                return false;
+            }
+            ok = add_literal(format, section->first, p + 1, (size_t)(close - p - 1));
+            p  = close + 1;
+        } else if (c == '\\' || c == '_' || c == '*') {
+            if (p + 1 >= end) {
+                return false;
+            }
+            /* \x is x, _x is a space as wide as x, *x repeats x to fill the cell */
+            if (c == '\\') {
+                ok = add_literal(format, section->first, p + 1, 1);
+            } else if (c == '_') {
+                ok = add_literal(format, section->first, " ", 1);
+            }
+            p += 2;
+        } else if (c == '[') {
+            const char *close = memchr(p, ']', (size_t)(end - p));
+            if (!close) {
+                return false;
+            }
+            ok = compile_bracket(format, section, p + 1, close);
+            p  = close + 1;
+        } else if (is_placeholder(c)) {
+            numeric = true;
+            digit   = true;
+            if (in_exponent) {
+                section->exp_digits++;
+                ok = add_op(format, OP_EXP_DIGIT, c);
+            } else if (after_point) {
+                section->frac_digits++;
+                ok = add_op(format, OP_FRACTION, c);
+            } else {
+                if (section->int_digits == 0) {
+                    section->int_optional = c != '0';
+                }
+                section->int_digits++;
+                section->int_zeros += c == '0';
+                ok = add_op(format, OP_DIGIT, c);
+                /* Commas seen so far were separators, not scaling */
+                section->thousands = section->thousands || scale > 0;
+                scale              = 0;
+            }
+            p++;
+        } else if (c == '.' && after_sec && p + 1 < end && p[1] == '0') {
+            size_t n               = run_length(p + 1, end, '0');
+            section->subsec_digits = n > 3 ? 3 : (int)n;
+            ok                     = add_op(format, OP_SUBSECOND, section->subsec_digits);
+            p += 1 + n;
+        } else if (c == '.' && !after_point && !section->date &&
+                   (numeric || (p + 1 < end && is_placeholder(p[1])))) {
+            after_point = true;
+            ok          = add_op(format, OP_POINT, 0);
+            p++;
+        } else if (c == ',' && after_digit && !in_exponent) {
+            scale++;
+            digit = true;
+            p++;
+        } else if (c == '%') {
+            section->percent++;
+            ok = add_literal(format, section->first, "%", 1);
+            p++;
+        } else if (lower == 'e' && numeric && !in_exponent && p + 1 < end &&
+                   (p[1] == '+' || p[1] == '-')) {
+            in_exponent = true;
+            ok          = add_op(format, OP_EXPONENT, c);
+            if (ok) {
+                format->ops[format->op_count - 1].len = p[1] == '+';
+            }
+            p += 2;
+        } else if (starts_with_nocase(p, end, "general") || c == '@') {
+            section->general = true;
+            ok               = add_op(format, OP_GENERAL, 0);
+            p += c == '@' ? 1 : 7;
+        } else if (c == '/' && numeric && p + 1 < end &&
+                   (is_placeholder(p[1]) || isdigit((unsigned char)p[1]))) {
+            /* Fractions (# ?/?) are not supported */
+            return false;
+        } else if (lower == 'y' || lower == 'm' || lower == 'd' || lower == 'h' || lower == 's') {
+            size_t n      = run_length(p, end, lower);
+            section->date = true;
+            switch (lower) {
+                case 'y':
+                    ok = add_op(format, OP_YEAR, n <= 2 ? 2 : 4);
+                    break;
+                case 'm':
+                    ok = add_op(format, OP_MONTH, n > 5 ? 4 : (int)n);
+                    break;
+                case 'd':
+                    ok = add_op(format, OP_DAY, n > 4 ? 4 : (int)n);
+                    break;
+                case 'h':
+                    ok = add_op(format, OP_HOUR, n > 2 ? 2 : (int)n);
+                    break;
+                default:
+                    ok = add_op(format, OP_SECOND, n > 2 ? 2 : (int)n);
+                    break;
+            }
+            p += n;
+        } else if (starts_with_nocase(p, end, "am/pm")) {
+            section->twelve_hour = true;
+            ok                   = add_op(format, OP_AMPM, islower((unsigned char)c) ? 1 : 0);
+            p += 5;
+        } else if (starts_with_nocase(p, end, "a/p")) {
+            section->twelve_hour = true;
+            ok                   = add_op(format, OP_AMPM, islower((unsigned char)c) ? 3 : 2);
+            p += 3;
+        } else {
+            ok = add_literal(format, section->first, p, 1);
+            p++;
+        }
+
+        if (!ok) {
+            return false;
+        }
+        const formatOp *last = format->op_count > section->first
+                                 ? &format->ops[format->op_count - 1]
+                                 : NULL;
+        after_sec   = last && (last->code == OP_SECOND || last->code == OP_ELAPSED_SECONDS);
+        after_digit = digit;
+    }
+
+    /* Digit placeholders and date fields do not mix */
+    if (numeric && section->date) {
+        return false;
+    }
+
+    section->scale = scale;
+    section->count = format->op_count - section->first;
+    resolve_minutes(format, section);
+    return true;
+}
+
+/* Compile a format code into a program */
+numberFormat *number_format_compile(const char *code)
+{
+    if (!code || !*code || strcasecmp(code, "general") == 0 || strcmp(code, "@") == 0) {
+        return NULL;
+    }
+
+    numberFormat *format = calloc(1, sizeof(numberFormat));
+    if (!format) {
+        return NULL;
+    }
+
+    /* Split at ';' outside quotes, escapes and brackets */
+    const char *start = code;
+    const char *p     = code;
+    bool        ok    = true;
+    while (ok) {
+        if (*p == '"') {
+            const char *close = strchr(p + 1, '"');
+            p                 = close ? close + 1 : p + strlen(p);
+            continue;
+        }
+        if ((*p == '\\' || *p == '_' || *p == '*') && p[1]) {
+            p += 2;
+            continue;
+        }
+        if (*p == '[') {
+            const char *close = strchr(p, ']');
+            p                 = close ? close + 1 : p + strlen(p);
+            continue;
+        }
+        if (*p != ';' && *p != '\0') {
+            p++;
+            continue;
+        }
+
+        if (format->section_count == FORMAT_MAX_SECTIONS) {
+            ok = false;
+            break;
+        }
+        formatSection *section = &format->sections[format->section_count++];
+        ok                     = compile_section(format, section, start, p);
+        if (*p == '\0') {
+            break;
+        }
+        start = ++p;
+    }
+
+    if (!ok) {
+        number_format_free(format);
+        return NULL;
+    }
+    return format;
+}
+
+void number_format_free(numberFormat *format)
+{
+    if (!format) {
+        return;
+    }
+    free(format->ops);
+    free(format->text);
+    free(format);
+}
+
+static void put(formatOutput *out, const char *s, size_t len)
+{
+    if (out->len + len >= out->size) {
+        out->overflow = true;
+        return;
+    }
+    memcpy(out->data + out->len, s, len);
+    out->len += len;
+}
+
+static void put_char(formatOutput *out, char c)
+{
+    put(out, &c, 1);
+}
+
+/* Non-negative number, zero-padded to at least width digits */
+static void put_number(formatOutput *out, long long value, int width)
+{
+    char buffer[32];
+    int  len = snprintf(buffer, sizeof(buffer), "%0*lld", width, value);
+    if (len > 0) {
+        put(out, buffer, (size_t)len);
+    }
+}
+
+/* Decimal digits of x >= 0 rounded half away from zero to frac places, on its
+ * 15 significant digits. The integer part has no leading zeros (empty for 0).
+ * Returns false if x has more integer digits than fit.
+ */
+static bool round_decimal(double x, int frac, char *int_part, char *frac_part)
+{
+    char   sci[32];
+    char   digits[FORMAT_MAX_DIGITS];
+    size_t count = 0;
+
+    snprintf(sci, sizeof(sci), "%.14e", x);
+    for (const char *s = sci; *s && *s != 'e'; s++) {
+        if (isdigit((unsigned char)*s)) {
+            digits[count++] = *s;
+        }
+    }
+    const char *e     = strchr(sci, 'e');
+    int         point = (e ? atoi(e + 1) : 0) + 1; /* Digits before the decimal point */
+    if (x == 0.0) {
+        point = 1;
+    }
+    if (point > FORMAT_MAX_DIGITS / 2) {
+        return false;
+    }
+
+    /* Round at the last digit shown */
+    int keep = point + frac;
+    if (keep < 0) {
+        count = 0;
+    } else if ((size_t)keep < count) {
+        bool up = digits[keep] >= '5';
+        count   = (size_t)keep;
+        for (size_t i = count; up && i-- > 0;) {
+            up        = digits[i] == '9';
+            digits[i] = up ? '0' : (char)(digits[i] + 1);
+        }
+        if (up) {
+            memmove(digits + 1, digits, count);
+            digits[0] = '1';
+            count++;
+            point++;
+        }
+    }
+
+    /* Integer part without leading zeros */
+    size_t len = 0;
+    for (int i = 0; i < point; i++) {
+        char d = (size_t)i < count ? digits[i] : '0';
+        if (len > 0 || d != '0') {
+            int_part[len++] = d;
+        }
+    }
+    int_part[len] = '\0';
+
+    for (int i = 0; i < frac; i++) {
+        int pos      = point + i;
+        frac_part[i] = (pos >= 0 && (size_t)pos < count) ? digits[pos] : '0';
+    }
+    frac_part[frac] = '\0';
+    return true;
+}
+
+/* Integer placeholders: digits fill them from the right, extra digits go to the first */
+typedef struct {
+    const char *digits;
+    int         len;
+    int         placeholders;
+    int         index;   /* Placeholder being written */
+    int         total;   /* Characters the digits and '0' fillers take */
+    int         written;
+    bool        grouped; /* Thousands separators */
+} digitFill;
+
+static void digit_fill_init(digitFill *fill, const char *digits, int placeholders, bool grouped)
+{
+    fill->digits       = digits;
+    fill->len          = (int)strlen(digits);
+    fill->placeholders = placeholders;
+    fill->index        = 0;
+    fill->total        = 0;
+    fill->written      = 0;
+    fill->grouped      = grouped;
+}
+
+static void digit_fill_put(digitFill *fill, formatOutput *out, char digit)
+{
+    put_char(out, digit);
+    fill->written++;
+    int left = fill->total - fill->written;
+    if (fill->grouped && left > 0 && left % 3 == 0) {
+        put_char(out, ',');
+    }
+}
+
+static void digit_fill_next(digitFill *fill, formatOutput *out, char placeholder)
+{
+    int from_right = fill->placeholders - 1 - fill->index;
+    int available  = fill->len - 1 - from_right; /* Digit for this placeholder */
+    int first      = fill->index == 0 ? 0 : available;
+    fill->index++;
+
+    if (available < 0) {
+        if (placeholder == '0') {
+            digit_fill_put(fill, out, '0');
+        } else if (placeholder == '?') {
+            put_char(out, ' ');
+        }
+        return;
+    }
+    for (int i = first; i <= available; i++) {
+        digit_fill_put(fill, out, fill->digits[i]);
+    }
+}
+
+/* Count what the digits and '0' fillers of a placeholder run will take */
+static void digit_fill_measure(digitFill *fill, const formatOp *ops, size_t count, uint8_t code)
+{
+    int index = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (ops[i].code != code) {
+            continue;
+        }
+        int from_right = fill->placeholders - 1 - index++;
+        if (fill->len - 1 - from_right < 0 && ops[i].arg == '0') {
+            fill->total++;
+        }
+    }
+    fill->total += fill->len;
+}
+
+static void render_number(const numberFormat  *format,
+                          const formatSection *section,
+                          double               x,
+                          formatOutput        *out)
+{
+    char int_part[FORMAT_MAX_DIGITS + 1];
+    char frac_part[FORMAT_MAX_DIGITS + 1];
+    char exp_part[16] = "";
+    int  exponent     = 0;
+    int  frac         = section->frac_digits > 64 ? 64 : section->frac_digits;
+
+    x *= pow(100.0, section->percent);
+    x /= pow(1000.0, section->scale);
+    if (!isfinite(x)) {
+        out->overflow = true;
+        return;
+    }
+
+    if (section->exp_digits > 0) {
+        /* ##0.0E+0 keeps the exponent a multiple of the integer placeholders,
+         * 0.00E+00 shows as many integer digits as it has zeros
+         */
+        int step = section->int_optional && section->int_digits > 1 ? section->int_digits : 1;
+        int shown = step > 1 ? 1 : (section->int_zeros > 0 ? section->int_zeros : 1);
+        if (x != 0.0) {
+            exponent = (int)floor(log10(x)) - (shown - 1);
+            if (step > 1) {
+                exponent = (int)floor((double)exponent / step) * step;
+            }
+        }
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (!round_decimal(x / pow(10.0, exponent), frac, int_part, frac_part)) {
+                out->overflow = true;
+                return;
+            }
+            if ((int)strlen(int_part) <= (step > 1 ? step : shown)) {
+                break;
+            }
+            exponent += step;
+        }
+        snprintf(exp_part, sizeof(exp_part), "%d", abs(exponent));
+        if (strcmp(exp_part, "0") == 0) {
+            exp_part[0] = '\0';
+        }
+    } else if (!round_decimal(x, frac, int_part, frac_part)) {
+        out->overflow = true;
+        return;
+    }
+
+    const formatOp *ops = format->ops + section->first;
+    digitFill       int_fill;
+    digitFill       exp_fill;
+    digit_fill_init(&int_fill, int_part, section->int_digits, section->thousands);
+    digit_fill_init(&exp_fill, exp_part, section->exp_digits, false);
+    digit_fill_measure(&int_fill, ops, section->count, OP_DIGIT);
+    digit_fill_measure(&exp_fill, ops, section->count, OP_EXP_DIGIT);
+
+    /* Trailing zeros after the point are hidden by '#' and blanked by '?' */
+    int significant = frac;
+    while (significant > 0 && frac_part[significant - 1] == '0') {
+        significant--;
+    }
+
+    int  frac_index = 0;
+    bool int_shown  = section->int_digits > 0;
+    for (size_t i = 0; i < section->count && !out->overflow; i++) {
+        const formatOp *op = &ops[i];
+        switch (op->code) {
+            case OP_LITERAL:
+                put(out, format->text + op->offset, op->len);
+                break;
+            case OP_DIGIT:
+                digit_fill_next(&int_fill, out, (char)op->arg);
+                break;
+            case OP_POINT:
+                if (!int_shown) {
+                    /* No integer placeholders: Excel still shows the integer digits */
+                    put(out, int_part, strlen(int_part));
+                    int_shown = true;
+                }
+                put_char(out, '.');
+                break;
+            case OP_FRACTION:
+                if (frac_index < frac && frac_index < significant) {
+                    put_char(out, frac_part[frac_index]);
+                } else if (op->arg == '0') {
+                    put_char(out, '0');
+                } else if (op->arg == '?') {
+                    put_char(out, ' ');
+                }
+                frac_index++;
+                break;
+            case OP_EXPONENT:
+                put_char(out, (char)op->arg);
+                if (exponent < 0) {
+                    put_char(out, '-');
+                } else if (op->len) {
+                    put_char(out, '+');
+                }
+                break;
+            case OP_EXP_DIGIT:
+                digit_fill_next(&exp_fill, out, (char)op->arg);
+                break;
+            case OP_GENERAL: {
+                char general[DTOA_BUFFER_SIZE];
+                put(out, general, (size_t)dtoa_general(x, general));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+/* Civil date from days since 1970-01-01 (proleptic Gregorian) */
+static void civil_from_days(long long days, int *year, int *month, int *day)
+{
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    long long doe = days - era * 146097;
+    long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long long mp  = (5 * doy + 2) / 153;
+    *day          = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month        = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year         = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+static void render_date(const numberFormat  *format,
+                        const formatSection *section,
+                        double               value,
+                        bool                 date1904,
+                        formatOutput        *out)
+{
+    if (value < 0.0 || value >= FORMAT_MAX_SERIAL) {
+        out->overflow = true;
+        return;
+    }
+
+    /* Round to the shown fraction of a second */
+    static const long long units[] = {1000, 100, 10, 1};
+    long long              unit    = units[section->subsec_digits];
+    long long              ms      = llround(value * 86400000.0);
+    ms                             = (ms + unit / 2) / unit * unit;
+
+    long long days = ms / 86400000;
+    long long time = ms % 86400000;
+    int       year;
+    int       month;
+    int       day;
+    int       weekday;
+
+    if (date1904) {
+        civil_from_days(days - 24107, &year, &month, &day);
+        weekday = (int)((days + 5) % 7);
+    } else {
+        /* Excel counts a 1900-02-29 and calls serial 0 1900-01-00 */
+        if (days == 0) {
+            year  = 1900;
+            month = 1;
+            day   = 0;
+        } else if (days == 60) {
+            year  = 1900;
+            month = 2;
+            day   = 29;
+        } else {
+            civil_from_days(days - (days < 60 ? 25568 : 25569), &year, &month, &day);
+        }
+        weekday = (int)((days + 6) % 7);
+    }
+
+    int hour = (int)(time / 3600000);
+    for (size_t i = 0; i < section->count && !out->overflow; i++) {
+        const formatOp *op = &format->ops[section->first + i];
+        switch (op->code) {
+            case OP_LITERAL:
+                put(out, format->text + op->offset, op->len);
+                break;
+            case OP_YEAR:
+                put_number(out, op->arg == 2 ? year % 100 : year, op->arg);
+                break;
+            case OP_MONTH:
+                if (op->arg <= 2) {
+                    put_number(out, month, op->arg);
+                } else {
+                    const char *name = month_names[month - 1];
+                    put(out, name, op->arg == 3 ? 3 : op->arg == 4 ? strlen(name) : 1);
+                }
+                break;
+            case OP_DAY:
+                if (op->arg <= 2) {
+                    put_number(out, day, op->arg);
+                } else {
+                    const char *name = day_names[weekday];
+                    put(out, name, op->arg == 3 ? 3 : strlen(name));
+                }
+                break;
+            case OP_HOUR: {
+                int shown = section->twelve_hour ? (hour % 12 == 0 ? 12 : hour % 12) : hour;
+                put_number(out, shown, op->arg);
+                break;
+            }
+            case OP_MINUTE:
+                put_number(out, (ms / 60000) % 60, op->arg);
+                break;
+            case OP_SECOND:
+                put_number(out, (ms / 1000) % 60, op->arg);
+                break;
+            case OP_SUBSECOND:
+                put_char(out, '.');
+                put_number(out, (ms % 1000) / (op->arg == 1 ? 100 : op->arg == 2 ? 10 : 1),
+                           op->arg);
+                break;
+            case OP_ELAPSED_HOURS:
+                put_number(out, ms / 3600000, op->arg);
+                break;
+            case OP_ELAPSED_MINUTES:
+                put_number(out, ms / 60000, op->arg);
+                break;
+            case OP_ELAPSED_SECONDS:
+                put_number(out, ms / 1000, op->arg);
+                break;
+            case OP_AMPM: {
+                static const char *const markers[][2] = {
+                    {"AM", "PM"},
+                    {"am", "pm"},
+                    {"A",  "P" },
+                    {"a",  "p" }
+                };
+                const char *marker = markers[op->arg][hour >= 12];
+                put(out, marker, strlen(marker));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+static bool condition_holds(const formatSection *section, double value)
+{
+    switch (section->condition) {
+        case COND_LT:
+            return value < section->operand;
+        case COND_LE:
+            return value <= section->operand;
+        case COND_GT:
+            return value > section->operand;
+        case COND_GE:
+            return value >= section->operand;
+        case COND_EQ:
+            return value == section->operand;
+        case COND_NE:
+            return value != section->operand;
+        default:
+            return true;
+    }
+}
+
+/* Render value with the section Excel would pick for it */
+int number_format_render(const numberFormat *format,
+                         double              value,
+                         bool                date1904,
+                         char               *buffer,
+                         size_t              size)
+{
+    if (!format || !buffer || size == 0 || !isfinite(value)) {
+        return -1;
+    }
+
+    /* A fourth section is for text */
+    int  sections  = format->section_count < 4 ? format->section_count : 3;
+    int  index     = 0;
+    bool show_sign = true; /* False if the section is the one for negative numbers */
+
+    if (format->sections[0].condition != COND_NONE) {
+        if (condition_holds(&format->sections[0], value)) {
+            index = 0;
+        } else if (sections >= 2 && condition_holds(&format->sections[1], value)) {
+            index = 1;
+        } else if (sections >= 3) {
+            index = 2;
+        } else {
+            return -1;
+        }
+    } else if (sections >= 2 && value < 0.0) {
+        index     = 1;
+        show_sign = false;
+    } else if (sections >= 3 && value == 0.0) {
+        index = 2;
+    }
+
+    const formatSection *section = &format->sections[index];
+    formatOutput         out     = {buffer, size, 0, false};
+    if (section->date) {
+        render_date(format, section, value, date1904, &out);
+    } else {
+        bool shows_value = section->int_digits + section->frac_digits > 0 || section->general;
+        if (value < 0.0 && show_sign && shows_value) {
+            put_char(&out, '-');
+        }
+        render_number(format, section, fabs(value), &out);
+    }
+
+    if (out.overflow) {
+        return -1;
+    }
+    buffer[out.len] = '\0';
+    return (int)out.len;
+}
@@ -0,0 +1,23 @@
+#ifndef _NUMBER_FORMAT_H
+#define _NUMBER_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "xlsx2csv.h"
+
+/* Compile a format code once; NULL if it is General, text only or not supported */
+numberFormat *number_format_compile(const char *code);
+void          number_format_free(numberFormat *format);
+
+/* Render value as Excel displays it into buffer (NUL-terminated).
+ * Returns the length, or -1 if it does not fit or the format cannot show the value
+ * (e.g. a negative date).
+ */
+int number_format_render(const numberFormat *format,
+                         double              value,
+                         bool                date1904,
+                         char               *buffer,
+                         size_t              size);
+
+#endif /* _NUMBER_FORMAT_H */
@@ -0,0 +1,242 @@
+/* Decimal text to double for cell values.
+ *
+ * A numeric cell used to be read by atof or strtod, then scanned again by
+ * is_numeric and by strchr looking for an exponent. number_parse reads the
+ * text once: it collects up to 19 significant digits into an integer and the
+ * decimal exponent, and tells what the text looks like on the way.
+ *
+ * The digits w and exponent q are turned into the nearest double exactly:
+ * - w below 2^53 and |q| <= 22 need one correctly rounded multiply or divide
+ *   by an exact power of ten (Clinger's fast path);
+ * - otherwise, for |q| <= 27, w * 5^q or w * 2^s / 5^-q is computed in 128-bit
+ *   integers (the 2^q part only moves the binary exponent) and rounded half to
+ *   even from its top 53 bits and the rest, which covers the 17 digit values
+ *   spreadsheets write;
+ * - longer mantissas, larger exponents and the spellings only strtod knows
+ *   (hexadecimal, inf, nan) are left to strtod, whose result this matches.
+ */
+
+/* Standard library headers */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project headers */
+#include "number_parse.h"
+
+__extension__ typedef unsigned __int128 uint128;
+
+#define MANTISSA_DIGITS 19 /* Digits that always fit in a uint64_t */
+
+static const double exact_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                     1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                     1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* 5^k for 0 <= k <= 27, the odd part of 10^k */
+static const uint64_t pow5[] = {1ULL,
+                                5ULL,
+                                25ULL,
+                                125ULL,
+                                625ULL,
+                                3125ULL,
+                                15625ULL,
+                                78125ULL,
+                                390625ULL,
+                                1953125ULL,
+                                9765625ULL,
+                                48828125ULL,
+                                244140625ULL,
+                                1220703125ULL,
+                                6103515625ULL,
+                                30517578125ULL,
+                                152587890625ULL,
+                                762939453125ULL,
+                                3814697265625ULL,
+                                19073486328125ULL,
+                                95367431640625ULL,
+                                476837158203125ULL,
+                                2384185791015625ULL,
+                                11920928955078125ULL,
+                                59604644775390625ULL,
+                                298023223876953125ULL,
+                                1490116119384765625ULL,
+                                7450580596923828125ULL};
+
+#define POW5_MAX 27
+
+static int bit_length(uint128 n)
+{
+    uint64_t high = (uint64_t)(n >> 64);
+    if (high) {
+        return 128 - __builtin_clzll(high);
+    }
+    uint64_t low = (uint64_t)n;
+    return low ? 64 - __builtin_clzll(low) : 0;
+}
+
+/* Nearest double to n * 2^exponent, where sticky says some nonzero bits below n were cut.
+ * n must have more than 54 bits whenever sticky is set.
+ */
+static double round_binary(uint128 n, int exponent, bool sticky)
+{
+    int bits = bit_length(n);
+    if (bits <= 53) {
+        return ldexp((double)(uint64_t)n, exponent);
+    }
+
+    int     shift = bits - 53;
+    uint128 kept  = n >> shift;
+    uint128 rest  = n - (kept << shift);
+    uint128 half  = (uint128)1 << (shift - 1);
+
+    if (rest > half || (rest == half && (sticky || (kept & 1)))) {
+        kept++;
+    }
+    return ldexp((double)(uint64_t)kept, exponent + shift);
+}
+
+/* w * 10^q correctly rounded; false if q is outside what is handled here */
+static bool decimal_to_double(uint64_t w, int q, double *value)
+{
+    if (w == 0) {
+        *value = 0.0;
+        return true;
+    }
+
+    if (w <= (1ULL << 53) && q >= -22 && q <= 22) {
+        *value = q < 0 ? (double)w / exact_pow10[-q] : (double)w * exact_pow10[q];
+        return true;
+    }
+
+    /* 10^q = 5^q * 2^q: only the power of five needs integer arithmetic */
+    if (q >= 0 && q <= POW5_MAX) {
+        *value = round_binary((uint128)w * pow5[q], q, false);
+        return true;
+    }
+
+    if (q < 0 && q >= -POW5_MAX) {
+        /* Shift w so the quotient has 62 or 63 bits (one hardware divide) */
+        uint64_t divisor   = pow5[-q];
+        int      shift     = 63 + bit_length(divisor) - bit_length(w);
+        uint128  scaled    = (uint128)w << shift;
+        uint128  quotient  = scaled / divisor;
+        bool     remainder = scaled - quotient * divisor != 0;
+        *value             = round_binary(quotient, q - shift, remainder);
+        return true;
+    }
+
+    return false;
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/* The whitespace strtod and isspace skip in the C locale */
+static bool is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* Text strtod reads differently, or that has no digits: it decides */
+static const char *parse_with_strtod(const char *text, parsedNumber *number)
+{
+    char *end            = NULL;
+    number->value        = strtod(text, &end);
+    number->has_exponent = strpbrk(text, "eE") != NULL;
+    return end;
+}
+
+const char *number_parse(const char *text, parsedNumber *number)
+{
+    memset(number, 0, sizeof(*number));
+
+    const char *p = text;
+    while (is_space(*p)) {
+        p++;
+    }
+
+    bool negative = *p == '-';
+    if (*p == '+' || *p == '-') {
+        p++;
+    }
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        return parse_with_strtod(text, number); /* Hexadecimal */
+    }
+
+    /* Mantissa: up to 19 significant digits, the rest only scale it */
+    uint64_t mantissa  = 0;
+    int      exponent  = 0;
+    int      digits    = 0;
+    bool     any_digit = false;
+    bool     truncated = false;
+    bool     has_point = false;
+
+    for (;; p++) {
+        if (is_digit(*p)) {
+            any_digit = true;
+            if (*p == '0' && digits == 0) {
+                exponent -= has_point; /* Leading zero */
+            } else if (digits < MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits++;
+                exponent -= has_point;
+            } else {
+                digits++;
+                truncated = truncated || *p != '0';
+                exponent += !has_point;
+            }
+        } else if (*p == '.' && !has_point) {
+            has_point = true;
+        } else {
+            break;
+        }
+    }
+
+    if (!any_digit) {
+        return parse_with_strtod(text, number); /* inf, nan, or no number at all */
+    }
+
+    /* Exponent, only if digits follow the e */
+    bool has_exponent = false;
+    if (*p == 'e' || *p == 'E') {
+        const char *e             = p + 1;
+        bool        negative_exp  = *e == '-';
+        int         exponent_part = 0;
+        if (*e == '+' || *e == '-') {
+            e++;
+        }
+        if (is_digit(*e)) {
+            has_exponent = true;
+            for (; is_digit(*e); e++) {
+                if (exponent_part < 100000) {
+                    exponent_part = exponent_part * 10 + (*e - '0');
+                }
+            }
+            exponent += negative_exp ? -exponent_part : exponent_part;
+            p = e;
+        }
+    }
+
+    const char *end  = p;
+    const char *rest = p;
+    while (is_space(*rest)) {
+        rest++;
+    }
+
+    number->digits       = digits;
+    number->numeric      = *rest == '\0';
+    number->integer      = number->numeric && !has_point && !has_exponent;
+    number->has_exponent = has_exponent || (*rest && strpbrk(rest, "eE") != NULL);
+
+    double value;
+    if (truncated || !decimal_to_double(mantissa, exponent, &value)) {
+        value = strtod(text, NULL);
+    } else if (negative) {
+        value = -value;
+    }
+    number->value = value;
+    return end;
+}
@@ -0,0 +1,20 @@
+#ifndef _NUMBER_PARSE_H
+#define _NUMBER_PARSE_H
+
+#include <stdbool.h>
+
+/* A cell value read as a number */
+typedef struct {
+    double value;        /* What strtod reads in the C locale, 0 if there is no number */
+    int    digits;       /* Significant digits written, leading zeros not counted */
+    bool   numeric;      /* The whole text is a decimal number, spaces around it allowed */
+    bool   integer;      /* numeric, without a decimal point or exponent */
+    bool   has_exponent; /* The text contains an e or E anywhere */
+} parsedNumber;
+
+/* Read text as a number in one pass, exactly and independent of the locale.
+ * Returns where the number ends, as strtod's endptr would, or text if it has none.
+ */
+const char *number_parse(const char *text, parsedNumber *number);
+
+#endif /* _NUMBER_PARSE_H */
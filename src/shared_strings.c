@@ -0,0 +1,661 @@
+/* Shared string table: building, access and an optional lazy mode.
+ *
+ * The table is built in memory while sharedStrings.xml is parsed. With a
+ * memory limit, finished strings and their entries are moved to temporary
+ * files whenever the in-memory part reaches the limit, and the finished table
+ * maps those files: lookups stay the same, and the kernel keeps the pages
+ * that are used in memory and can drop the rest.
+ *
+ * A workbook's sharedStrings.xml serves every sheet, so converting one small
+ * sheet out of a large workbook can spend most of its time decoding strings
+ * nobody asks for. In lazy mode the part is only indexed: one memmem() pass
+ * records where each <si> element starts, and a string is decoded by expat
+ * the first time a cell references it. Decoded text goes to fixed blocks
+ * that never move, so views handed out stay valid while later strings are
+ * decoded, and lookups from parallel workers only take the lock on a miss.
+ */
+
+/* memmem() */
+#define _GNU_SOURCE
+
+/* Standard library headers */
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Third-party library headers */
+#include <expat.h>
+
+/* Project headers */
+#include "shared_strings.h"
+#include "sheet_scanner.h"
+
+/* Smallest text buffer a memory limit leaves the builder */
+#define BUILDER_MIN_TEXT (64 * 1024)
+
+/* Decoded text is stored in blocks of at least this size */
+#define TEXT_BLOCK_SIZE (256 * 1024)
+
+typedef struct textBlock {
+    struct textBlock *next;
+    size_t            used;
+    size_t            size;
+    char              data[];
+} textBlock;
+
+struct sharedStringIndex {
+    char                  *xml;
+    size_t                 xml_len;
+    size_t                *starts; /* Offset of each <si>, then the end of the last one */
+    int                    count;
+    _Atomic(const char *) *texts; /* Decoded text, NULL until first use */
+    size_t                *lengths;
+    textBlock             *blocks;
+    pthread_mutex_t        lock;
+
+    /* Decoder state, under lock */
+    XML_Parser parser;
+    char      *out;
+    size_t     out_len;
+    size_t     out_capacity;
+    int        depth;
+    bool       in_t;
+    bool       in_rph; /* Phonetic runs are not part of the text */
+    bool       done;
+    bool       failed;
+};
+
+struct sharedStringForms {
+    const xlsxOptions      *options;
+    _Atomic(unsigned char) *forms; /* csvFieldForm of each string, CSV_FIELD_UNKNOWN until used */
+};
+
+/* Marks a string that could not be decoded */
+static const char decode_failed[1] = "";
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* Whether the byte after "<si" ends the element name */
+static bool is_name_end(char c)
+{
+    return c == '>' || c == '/' || is_space(c);
+}
+
+/* Next <si> start tag at or after from, NULL if none */
+static const char *find_si(const char *from, const char *end)
+{
+    while (from < end) {
+        const char *p = memmem(from, (size_t)(end - from), "<si", 3);
+        if (!p || p + 3 >= end) {
+            return NULL;
+        }
+        if (is_name_end(p[3])) {
+            return p;
+        }
+        from = p + 3;
+    }
+    return NULL;
+}
+
+/* Bytes of text held in memory before finished strings are spilled */
+static size_t builder_text_limit(const sharedStringBuilder *builder)
+{
+    size_t limit = builder->limit / 2;
+    return limit > BUILDER_MIN_TEXT ? limit : BUILDER_MIN_TEXT;
+}
+
+/* Entries held in memory before they are spilled */
+static int builder_entry_limit(const sharedStringBuilder *builder)
+{
+    size_t limit = builder->limit / 2 / sizeof(sharedString);
+    if (limit < 1024) {
+        return 1024;
+    }
+    return limit > INT_MAX ? INT_MAX : (int)limit;
+}
+
+/* Temporary spill file, deleted once closed */
+static bool builder_open(FILE **file)
+{
+    if (!*file) {
+        *file = tmpfile();
+    }
+    return *file != NULL;
+}
+
+/* Move the finished strings to the text file, keeping the one being built */
+static bool builder_spill_text(sharedStringBuilder *builder)
+{
+    sharedStrings *sst  = builder->sst;
+    size_t         done = builder->string_start;
+
+    if (!builder_open(&builder->text_file) ||
+        fwrite(sst->arena, 1, done, builder->text_file) != done) {
+        builder->failed = true;
+        return false;
+    }
+
+    memmove(sst->arena, sst->arena + done, sst->arena_len - done);
+    sst->arena_len -= done;
+    builder->text_spilled += done;
+    builder->string_start = 0;
+    return true;
+}
+
+/* Move the entries held in memory to the entry file */
+static bool builder_spill_entries(sharedStringBuilder *builder)
+{
+    sharedStrings *sst       = builder->sst;
+    size_t         in_memory = (size_t)(sst->count - builder->entries_spilled);
+
+    if (!builder_open(&builder->entry_file) ||
+        fwrite(sst->entries, sizeof(sharedString), in_memory, builder->entry_file) != in_memory) {
+        builder->failed = true;
+        return false;
+    }
+
+    builder->entries_spilled = sst->count;
+    return true;
+}
+
+/* Make room for len more bytes (and a NUL) at the end of the arena */
+static bool builder_reserve(sharedStringBuilder *builder, size_t len)
+{
+    sharedStrings *sst    = builder->sst;
+    size_t         needed = sst->arena_len + len + 1;
+
+    if (needed <= builder->arena_capacity) {
+        return true;
+    }
+
+    /* Over the limit: spill what is finished before growing */
+    if (builder->limit > 0 && builder->string_start > 0 && needed > builder_text_limit(builder)) {
+        if (!builder_spill_text(builder)) {
+            return false;
+        }
+        needed = sst->arena_len + len + 1;
+        if (needed <= builder->arena_capacity) {
+            return true;
+        }
+    }
+
+    size_t capacity = builder->arena_capacity * 2;
+    if (builder->limit > 0 && capacity > builder_text_limit(builder)) {
+        capacity = builder_text_limit(builder);
+    }
+    if (capacity < needed) {
+        capacity = needed;
+    }
+    char *arena = realloc(sst->arena, capacity);
+    if (!arena) {
+        builder->failed = true;
+        return false;
+    }
+    sst->arena              = arena;
+    builder->arena_capacity = capacity;
+    return true;
+}
+
+/* Make room for count entries in memory */
+static bool builder_reserve_entries(sharedStringBuilder *builder, int count)
+{
+    if (count <= builder->entry_capacity) {
+        return true;
+    }
+
+    int capacity = builder->entry_capacity > 0 ? builder->entry_capacity : 16;
+    while (capacity < count) {
+        capacity = capacity > INT_MAX / 2 ? INT_MAX : capacity * 2;
+    }
+    sharedString *entries = realloc(builder->sst->entries, (size_t)capacity * sizeof(sharedString));
+    if (!entries) {
+        builder->failed = true;
+        return false;
+    }
+    builder->sst->entries   = entries;
+    builder->entry_capacity = capacity;
+    return true;
+}
+
+/* Start building into an empty table; size_hint is the length of sharedStrings.xml */
+void shared_string_builder_init(sharedStringBuilder *builder,
+                                sharedStrings       *sst,
+                                size_t               size_hint,
+                                size_t               limit)
+{
+    memset(builder, 0, sizeof(*builder));
+    builder->sst   = sst;
+    builder->limit = limit;
+
+    /* In UTF-8 documents the text is never longer than its markup, so without a limit
+     * the arena is sized once and trimmed when the table is finished
+     */
+    if (limit > 0 && size_hint > builder_text_limit(builder)) {
+        size_hint = builder_text_limit(builder);
+    }
+    builder_reserve(builder, size_hint);
+    builder->failed = false;
+}
+
+/* Presize for the number of strings the document announces */
+void shared_string_builder_expect(sharedStringBuilder *builder, int count)
+{
+    if (builder->limit > 0 && count > builder_entry_limit(builder)) {
+        count = builder_entry_limit(builder);
+    }
+    builder_reserve_entries(builder, count);
+    builder->failed = false;
+}
+
+/* Start a string, dropping the text of an unterminated one */
+void shared_string_builder_begin(sharedStringBuilder *builder)
+{
+    builder->sst->arena_len = builder->string_start;
+}
+
+void shared_string_builder_append(sharedStringBuilder *builder, const char *s, size_t len)
+{
+    if (builder_reserve(builder, len)) {
+        sharedStrings *sst = builder->sst;
+        memcpy(sst->arena + sst->arena_len, s, len);
+        sst->arena_len += len;
+    }
+}
+
+/* Finish a string and add its entry */
+void shared_string_builder_end(sharedStringBuilder *builder)
+{
+    sharedStrings *sst       = builder->sst;
+    int            in_memory = sst->count - builder->entries_spilled;
+
+    if (!builder_reserve(builder, 0)) {
+        return;
+    }
+    if (builder->limit > 0 && in_memory >= builder_entry_limit(builder)) {
+        if (!builder_spill_entries(builder)) {
+            return;
+        }
+        in_memory = 0;
+    }
+    if (!builder_reserve_entries(builder, in_memory + 1)) {
+        return;
+    }
+
+    sharedString *entry        = &sst->entries[in_memory];
+    entry->offset              = builder->text_spilled + builder->string_start;
+    entry->len                 = sst->arena_len - builder->string_start;
+    sst->arena[sst->arena_len] = '\0';
+    sst->arena_len++;
+    sst->count++;
+    builder->string_start = sst->arena_len;
+}
+
+/* Map a finished spill file, NULL if it is empty or cannot be mapped */
+static void *builder_map(FILE *file, size_t len)
+{
+    if (len == 0 || fflush(file) != 0) {
+        return NULL;
+    }
+    void *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+/* Finish the table: trim it, or map its spill files if the limit was reached */
+int shared_string_builder_finish(sharedStringBuilder *builder)
+{
+    sharedStrings *sst = builder->sst;
+
+    sst->arena_len = builder->string_start;
+    if (!builder->text_file && !builder->entry_file) {
+        if (sst->arena_len > 0 && sst->arena_len < builder->arena_capacity) {
+            char *arena = realloc(sst->arena, sst->arena_len);
+            if (arena) {
+                sst->arena = arena;
+            }
+        }
+        return builder->failed ? -1 : 0;
+    }
+
+    /* Spill the rest, then read both files through mappings */
+    char         *text    = NULL;
+    sharedString *entries = NULL;
+    if (!builder->failed && builder_spill_text(builder) && builder_spill_entries(builder)) {
+        text    = builder_map(builder->text_file, builder->text_spilled);
+        entries = builder_map(builder->entry_file, (size_t)sst->count * sizeof(sharedString));
+    }
+
+    bool mapped = (text || builder->text_spilled == 0) && (entries || sst->count == 0);
+    free(sst->arena);
+    free(sst->entries);
+    if (builder->text_file) {
+        fclose(builder->text_file);
+    }
+    if (builder->entry_file) {
+        fclose(builder->entry_file);
+    }
+
+    if (!mapped) {
+        if (text) {
+            munmap(text, builder->text_spilled);
+        }
+        if (entries) {
+            munmap(entries, (size_t)sst->count * sizeof(sharedString));
+        }
+        memset(sst, 0, sizeof(*sst));
+        return -1;
+    }
+
+    sst->arena       = text;
+    sst->arena_len   = builder->text_spilled;
+    sst->entries     = entries;
+    sst->maps[0]     = text;
+    sst->map_lens[0] = builder->text_spilled;
+    sst->maps[1]     = entries;
+    sst->map_lens[1] = (size_t)sst->count * sizeof(sharedString);
+    return builder->failed ? -1 : 0;
+}
+
+/* Index the <si> elements of xml; NULL if it is not plain UTF-8 markup */
+sharedStringIndex *shared_string_index_create(char *xml, size_t len)
+{
+    const char *end   = xml + len;
+    const char *first = find_si(xml, end);
+    size_t      head  = first ? (size_t)(first - xml) : len;
+
+    /* UTF-8 without a DTD, and nothing (comments, CDATA, PIs) that could hide a "<si" */
+    if (!sheet_scanner_prologue_ok(xml, head) || memchr(xml, '\0', head) ||
+        memmem(xml + head, len - head, "<!", 2) || memmem(xml + head, len - head, "<?", 2)) {
+        return NULL;
+    }
+
+    sharedStringIndex *index = calloc(1, sizeof(sharedStringIndex));
+    if (!index) {
+        return NULL;
+    }
+
+    /* One extra slot holds the end of the last string */
+    size_t capacity = 1024;
+    bool   ok       = (index->starts = malloc(capacity * sizeof(size_t))) != NULL;
+    for (const char *p = first; p && ok; p = find_si(p + 3, end)) {
+        if ((size_t)index->count + 2 > capacity) {
+            size_t *starts = index->count < INT_MAX - 1
+                                 ? realloc(index->starts, capacity * 2 * sizeof(size_t))
+                                 : NULL;
+            ok = starts != NULL;
+            if (!ok) {
+                break;
+            }
+            index->starts = starts;
+            capacity *= 2;
+        }
+        index->starts[index->count++] = (size_t)(p - xml);
+    }
+
+    if (!ok) {
+        free(index->starts);
+        free(index);
+        return NULL;
+    }
+
+    /* The last string ends where </sst> starts */
+    const char *last    = index->count > 0 ? xml + index->starts[index->count - 1] : xml;
+    const char *sst_end = memmem(last, (size_t)(end - last), "</sst", 5);
+
+    index->starts[index->count] = sst_end ? (size_t)(sst_end - xml) : len;
+
+    index->texts   = calloc((size_t)index->count + 1, sizeof(*index->texts));
+    index->lengths = calloc((size_t)index->count + 1, sizeof(size_t));
+    index->parser  = XML_ParserCreate("UTF-8");
+    if (!index->texts || !index->lengths || !index->parser) {
+        if (index->parser) {
+            XML_ParserFree(index->parser);
+        }
+        free(index->texts);
+        free(index->lengths);
+        free(index->starts);
+        free(index);
+        return NULL;
+    }
+
+    index->xml     = xml;
+    index->xml_len = len;
+    pthread_mutex_init(&index->lock, NULL);
+    return index;
+}
+
+int shared_string_index_count(const sharedStringIndex *index)
+{
+    return index->count;
+}
+
+static void index_start_element(void *userData, const XML_Char *name, const XML_Char **atts)
+{
+    (void)atts; /* Unused */
+    sharedStringIndex *index = (sharedStringIndex *)userData;
+
+    index->depth++;
+    if (strcmp(name, "t") == 0 && !index->in_rph) {
+        index->in_t = true;
+    } else if (strcmp(name, "rPh") == 0) {
+        index->in_rph = true;
+    }
+}
+
+static void index_end_element(void *userData, const XML_Char *name)
+{
+    sharedStringIndex *index = (sharedStringIndex *)userData;
+
+    if (strcmp(name, "t") == 0) {
+        index->in_t = false;
+    } else if (strcmp(name, "rPh") == 0) {
+        index->in_rph = false;
+    }
+
+    /* Anything after </si> belongs to the next string or to the end of <sst> */
+    if (--index->depth == 0) {
+        index->done = true;
+        XML_StopParser(index->parser, XML_FALSE);
+    }
+}
+
+static void index_char_data(void *userData, const XML_Char *s, int len)
+{
+    sharedStringIndex *index = (sharedStringIndex *)userData;
+
+    if (!index->in_t) {
+        return;
+    }
+    if ((size_t)len > index->out_capacity - index->out_len) {
+        index->failed = true;
+        XML_StopParser(index->parser, XML_FALSE);
+        return;
+    }
+    memcpy(index->out + index->out_len, s, (size_t)len);
+    index->out_len += (size_t)len;
+}
+
+/* Room for len bytes in the current text block, NULL if out of memory */
+static char *index_reserve(sharedStringIndex *index, size_t len)
+{
+    textBlock *block = index->blocks;
+    if (block && block->size - block->used >= len) {
+        return block->data + block->used;
+    }
+
+    size_t size = len > TEXT_BLOCK_SIZE ? len : TEXT_BLOCK_SIZE;
+    block       = malloc(sizeof(textBlock) + size);
+    if (!block) {
+        return NULL;
+    }
+    block->next   = index->blocks;
+    block->used   = 0;
+    block->size   = size;
+    index->blocks = block;
+    return block->data;
+}
+
+/* Decode string i into a text block (called with the lock held) */
+static const char *index_decode(sharedStringIndex *index, int i, size_t *len)
+{
+    const char *span     = index->xml + index->starts[i];
+    size_t      span_len = index->starts[i + 1] - index->starts[i];
+
+    if (span_len > INT_MAX) {
+        return NULL;
+    }
+
+    /* UTF-8 text is never longer than the markup it was decoded from */
+    index->out = index_reserve(index, span_len + 1);
+    if (!index->out || !XML_ParserReset(index->parser, "UTF-8")) {
+        return NULL;
+    }
+
+    index->out_len      = 0;
+    index->out_capacity = span_len;
+    index->depth        = 0;
+    index->in_t         = false;
+    index->in_rph       = false;
+    index->done         = false;
+    index->failed       = false;
+    XML_SetUserData(index->parser, index);
+    XML_SetElementHandler(index->parser, index_start_element, index_end_element);
+    XML_SetCharacterDataHandler(index->parser, index_char_data);
+    XML_Parse(index->parser, span, (int)span_len, 1);
+
+    if (!index->done || index->failed) {
+        return NULL;
+    }
+
+    index->out[index->out_len] = '\0';
+    index->blocks->used += index->out_len + 1;
+    *len = index->out_len;
+    return index->out;
+}
+
+/* Text of lazy string i, decoding it on first use */
+static const char *index_get(sharedStringIndex *index, int i, size_t *len)
+{
+    const char *text = atomic_load_explicit(&index->texts[i], memory_order_acquire);
+
+    if (!text) {
+        pthread_mutex_lock(&index->lock);
+        text = atomic_load_explicit(&index->texts[i], memory_order_relaxed);
+        if (!text) {
+            size_t text_len = 0;
+            text            = index_decode(index, i, &text_len);
+            if (!text) {
+                text = decode_failed;
+            }
+            index->lengths[i] = text_len;
+            atomic_store_explicit(&index->texts[i], text, memory_order_release);
+        }
+        pthread_mutex_unlock(&index->lock);
+    }
+
+    if (text == decode_failed) {
+        return NULL;
+    }
+    *len = index->lengths[i];
+    return text;
+}
+
+const char *shared_string_get(const sharedStrings *sst, int index, size_t *len)
+{
+    if (index < 0 || index >= sst->count) {
+        return NULL;
+    }
+
+    if (sst->lazy) {
+        return index_get(sst->lazy, index, len);
+    }
+
+    const sharedString *entry = &sst->entries[index];
+    *len                      = entry->len;
+    return sst->arena + entry->offset;
+}
+
+/* Decide the CSV form of each string once, on its first use */
+int shared_strings_cache_forms(sharedStrings *sst, const xlsxOptions *options)
+{
+    if (sst->count == 0) {
+        return 0;
+    }
+
+    sharedStringForms *forms = calloc(1, sizeof(sharedStringForms));
+    if (!forms) {
+        return -1;
+    }
+    forms->forms = calloc((size_t)sst->count, sizeof(*forms->forms));
+    if (!forms->forms) {
+        free(forms);
+        return -1;
+    }
+    forms->options = options;
+    sst->forms     = forms;
+    return 0;
+}
+
+/* Text of a shared string and how it is written; the form is CSV_FIELD_UNKNOWN if not cached */
+const char *shared_string_csv(const sharedStrings *sst, int index, size_t *len, csvFieldForm *form)
+{
+    const char *text = shared_string_get(sst, index, len);
+
+    *form = CSV_FIELD_UNKNOWN;
+    if (!text || !sst->forms || *len == 0) {
+        return text;
+    }
+
+    /* Threads deciding the same string concurrently store the same value */
+    _Atomic(unsigned char) *slot  = &sst->forms->forms[index];
+    unsigned char           known = atomic_load_explicit(slot, memory_order_relaxed);
+    if (known == CSV_FIELD_UNKNOWN) {
+        known = (unsigned char)csv_field_form(sst->forms->options, text, *len);
+        atomic_store_explicit(slot, known, memory_order_relaxed);
+    }
+    *form = (csvFieldForm)known;
+    return text;
+}
+
+void shared_strings_free(sharedStrings *sst)
+{
+    sharedStringIndex *index = sst->lazy;
+
+    if (sst->forms) {
+        free(sst->forms->forms);
+        free(sst->forms);
+    }
+
+    if (index) {
+        while (index->blocks) {
+            textBlock *next = index->blocks->next;
+            free(index->blocks);
+            index->blocks = next;
+        }
+        XML_ParserFree(index->parser);
+        pthread_mutex_destroy(&index->lock);
+        free(index->texts);
+        free(index->lengths);
+        free(index->starts);
+        free(index->xml);
+        free(index);
+    }
+
+    if (sst->maps[0] || sst->maps[1]) {
+        for (int i = 0; i < 2; i++) {
+            if (sst->maps[i]) {
+                munmap(sst->maps[i], sst->map_lens[i]);
+            }
+        }
+    } else {
+        free(sst->arena);
+        free(sst->entries);
+    }
+    memset(sst, 0, sizeof(*sst));
+}
@@ -0,0 +1,56 @@
+#ifndef _SHARED_STRINGS_H
+#define _SHARED_STRINGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "csv_writer.h"
+#include "xlsx2csv.h"
+
+/* Builds the table while sharedStrings.xml is parsed. With a limit, strings beyond it
+ * are moved to temporary files that the finished table maps instead of holding in memory.
+ */
+typedef struct {
+    sharedStrings *sst;
+    size_t         arena_capacity;
+    int            entry_capacity;
+    size_t         string_start; /* Arena offset of the string being built */
+    size_t         limit;        /* Bytes of text and entries held in memory, 0 = no limit */
+    FILE          *text_file;    /* Spilled text, NULL until the limit is reached */
+    FILE          *entry_file;   /* Spilled entries */
+    size_t         text_spilled;
+    int            entries_spilled;
+    bool           failed; /* Out of memory or disk */
+} sharedStringBuilder;
+
+void shared_string_builder_init(sharedStringBuilder *builder,
+                                sharedStrings       *sst,
+                                size_t               size_hint,
+                                size_t               limit);
+void shared_string_builder_expect(sharedStringBuilder *builder, int count);
+void shared_string_builder_begin(sharedStringBuilder *builder);
+void shared_string_builder_append(sharedStringBuilder *builder, const char *s, size_t len);
+void shared_string_builder_end(sharedStringBuilder *builder);
+int  shared_string_builder_finish(sharedStringBuilder *builder);
+
+/* Lazy mode: index the <si> elements of sharedStrings.xml, taking ownership of xml.
+ * Returns NULL (xml still owned by the caller) if the document cannot be indexed
+ * safely; it has to be parsed up front then.
+ */
+sharedStringIndex *shared_string_index_create(char *xml, size_t len);
+int                shared_string_index_count(const sharedStringIndex *index);
+
+/* Text of a shared string (len bytes, NUL-terminated), NULL if out of range or malformed.
+ * Safe to call from several threads; a lazy string is decoded by the first caller.
+ */
+const char *shared_string_get(const sharedStrings *sst, int index, size_t *len);
+
+/* Remember how each string is written with these options, deciding it on first use */
+int         shared_strings_cache_forms(sharedStrings *sst, const xlsxOptions *options);
+const char *shared_string_csv(const sharedStrings *sst, int index, size_t *len, csvFieldForm *form);
+
+/* Release the table and its index */
+void shared_strings_free(sharedStrings *sst);
+
+#endif /* _SHARED_STRINGS_H */
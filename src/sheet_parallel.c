@@ -0,0 +1,556 @@
+/* Parallel conversion of a single large worksheet.
+ *
+ * The rows inside <sheetData> are split into chunks at <row> tag boundaries.
+ * Worker threads parse chunks with their own expat parser and worksheet state
+ * into in-memory CSV, and the calling thread writes the results in order. Each
+ * chunk is parsed after the worksheet prologue, so <dimension> (and with it
+ * the column padding) is seen exactly as in a serial parse.
+ *
+ * The worksheet XML comes either from memory (stored entries, or entries small
+ * enough to inflate in one shot) or, for larger entries, from a checkpoint
+ * index: every worker then inflates its own chunk starting at a checkpoint,
+ * so decompression runs in parallel too and memory stays bounded.
+ */
+
+/* memmem(), open_memstream() */
+#define _GNU_SOURCE
+
+/* Standard library headers */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project headers */
+#include "csv_writer.h"
+#include "inflate_index.h"
+#include "sheet_parallel.h"
+#include "sheet_scanner.h"
+#include "utils.h"
+#include "xml_parser.h"
+#include "zip_reader.h"
+
+/* Target amount of worksheet XML per chunk when the sheet is in memory */
+#define PARALLEL_CHUNK_SIZE (4 * 1024 * 1024)
+
+/* Checkpoint spacing when an index has to be built for the parallel run */
+#define PARALLEL_INDEX_SPAN (4 * 1024 * 1024)
+
+/* Bytes inflated per read */
+#define PARALLEL_READ_SIZE (256 * 1024)
+
+/* Give up looking for <sheetData> after this much prologue */
+#define PARALLEL_PROLOGUE_LIMIT (16 * 1024 * 1024)
+
+/* Finished chunks each worker may be ahead of the writer */
+#define PARALLEL_CHUNKS_AHEAD 2
+
+/* One run of rows: those whose <row> tag starts in [lo, hi) */
+typedef struct {
+    uint64_t            lo;
+    uint64_t            hi;    /* UINT64_MAX for the last chunk */
+    const inflatePoint *point; /* Index mode: checkpoint at lo, NULL = start of the entry */
+
+    /* Results */
+    char          *output;
+    size_t         output_len;
+    worksheetRange range;
+    bool           date_error;
+    formatStats    format_stats;
+    bool           failed;
+    bool           done;
+} sheetChunk;
+
+/* Shared state of one parallel conversion */
+typedef struct {
+    xlsx2csvConverter  *conv;
+    const char         *filename;
+    const char         *data; /* Memory mode: the whole worksheet XML */
+    size_t              data_len;
+    const inflateIndex *index; /* Index mode */
+    const char         *prologue;
+    size_t              prologue_len;
+    sheetChunk         *chunks;
+    size_t              chunk_count;
+    size_t              next_chunk; /* Next chunk to hand out */
+    size_t              written;    /* Chunks already written by the calling thread */
+    size_t              max_pending;
+    bool                stop;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+} parallelSheet;
+
+/* Offset of the first <row> start tag at or after from, SIZE_MAX if none */
+static size_t find_row_tag(const char *buf, size_t len, size_t from)
+{
+    while (from < len) {
+        const char *p = memmem(buf + from, len - from, "<row", 4);
+        if (!p) {
+            return SIZE_MAX;
+        }
+
+        size_t pos = (size_t)(p - buf);
+        if (pos + 4 >= len) {
+            return SIZE_MAX;
+        }
+
+        char c = buf[pos + 4];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '>' || c == '/') {
+            return pos;
+        }
+        from = pos + 1;
+    }
+
+    return SIZE_MAX;
+}
+
+/* Locate a chunk's rows in buf, which holds the worksheet XML from offset base.
+ * Returns false if buf does not reach the end of the chunk yet (and complete is false).
+ */
+static bool chunk_bounds(const sheetChunk *chunk,
+                         const char       *buf,
+                         size_t            len,
+                         uint64_t          base,
+                         bool              complete,
+                         size_t           *start,
+                         size_t           *end)
+{
+    size_t hi = (chunk->hi == UINT64_MAX || chunk->hi - base > len) ? len
+                                                                    : (size_t)(chunk->hi - base);
+
+    size_t next_row = find_row_tag(buf, len, hi);
+    if (next_row == SIZE_MAX && !complete) {
+        return false;
+    }
+
+    *start = find_row_tag(buf, next_row == SIZE_MAX ? len : next_row, (size_t)(chunk->lo - base));
+    *end   = next_row == SIZE_MAX ? len : next_row;
+
+    /* The last rows end where sheetData does */
+    size_t      from      = *start == SIZE_MAX ? (size_t)(chunk->lo - base) : *start;
+    const char *data_end  = from < *end ? memmem(buf + from, *end - from, "</sheetData", 11) : NULL;
+    if (data_end) {
+        *end = (size_t)(data_end - buf);
+    }
+    if (*start == SIZE_MAX || *start > *end) {
+        *start = *end;
+    }
+
+    return true;
+}
+
+/* Index mode: inflate from the chunk's checkpoint until the chunk is complete */
+static char *inflate_chunk(parallelSheet *ps, const sheetChunk *chunk, size_t *start, size_t *end)
+{
+    xlsx2csvConverter *conv = ps->conv;
+    void              *file = chunk->point
+                                  ? zip_file_open_at(conv->zip_handle, ps->filename, chunk->point)
+                                  : zip_file_open(conv->zip_handle, ps->filename);
+    if (!file) {
+        return NULL;
+    }
+
+    uint64_t base     = chunk->point ? chunk->point->out_offset : 0;
+    size_t   hi       = chunk->hi == UINT64_MAX ? 0 : (size_t)(chunk->hi - base);
+    size_t   capacity = hi + 2 * PARALLEL_READ_SIZE;
+    size_t   len      = 0;
+    char    *buf      = malloc(capacity);
+
+    while (buf) {
+        if (capacity - len < PARALLEL_READ_SIZE) {
+            char *new_buf = realloc(buf, capacity * 2);
+            if (!new_buf) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = new_buf;
+            capacity *= 2;
+        }
+
+        int read_size = zip_file_read(file, buf + len, PARALLEL_READ_SIZE);
+        if (read_size < 0) {
+            free(buf);
+            buf = NULL;
+            break;
+        }
+        len += (size_t)read_size;
+
+        bool complete = read_size == 0;
+        if ((complete || (hi > 0 && len > hi)) &&
+            chunk_bounds(chunk, buf, len, base, complete, start, end)) {
+            break;
+        }
+    }
+
+    zip_file_close(file);
+    return buf;
+}
+
+/* Parse one chunk into memory; last_row < 0 lets the first row set the numbering */
+static void process_chunk(parallelSheet *ps, sheetChunk *chunk, int last_row, bool date_error)
+{
+    char       *owned = NULL;
+    const char *buf   = ps->data;
+    size_t      start = 0;
+    size_t      end   = 0;
+
+    if (ps->data) {
+        chunk_bounds(chunk, ps->data, ps->data_len, 0, true, &start, &end);
+    } else {
+        owned = inflate_chunk(ps, chunk, &start, &end);
+        buf   = owned;
+    }
+
+    FILE *out = buf ? open_memstream(&chunk->output, &chunk->output_len) : NULL;
+    if (!out) {
+        free(owned);
+        chunk->failed = true;
+        return;
+    }
+
+    /* Workers share the read-only tables; error flag, counters and scratch buffers are private */
+    xlsx2csvConverter local = *ps->conv;
+    local.has_date_error    = date_error;
+    memset(&local.buffers, 0, sizeof(local.buffers));
+    memset(&local.format_stats, 0, sizeof(local.format_stats));
+
+    int status = parse_worksheet_rows(&local, out, ps->prologue, ps->prologue_len, buf + start,
+                                      end - start, last_row, &chunk->range);
+    if (fclose(out) != 0) {
+        status = -1;
+    }
+
+    buffer_pool_free(&local.buffers);
+    free(owned);
+
+    chunk->date_error   = local.has_date_error;
+    chunk->format_stats = local.format_stats;
+    chunk->failed       = status < 0;
+}
+
+static void *worker_main(void *arg)
+{
+    parallelSheet *ps = (parallelSheet *)arg;
+
+    pthread_mutex_lock(&ps->lock);
+    while (1) {
+        while (!ps->stop && ps->next_chunk < ps->chunk_count &&
+               ps->next_chunk >= ps->written + ps->max_pending) {
+            pthread_cond_wait(&ps->cond, &ps->lock);
+        }
+        if (ps->stop || ps->next_chunk >= ps->chunk_count) {
+            break;
+        }
+
+        sheetChunk *chunk = &ps->chunks[ps->next_chunk++];
+        pthread_mutex_unlock(&ps->lock);
+
+        process_chunk(ps, chunk, -1, false);
+
+        pthread_mutex_lock(&ps->lock);
+        chunk->done = true;
+        pthread_cond_broadcast(&ps->cond);
+    }
+    pthread_mutex_unlock(&ps->lock);
+
+    return NULL;
+}
+
+/* Write chunks in order as workers finish them */
+static int write_chunks(parallelSheet *ps, FILE *outfile)
+{
+    xlsxOptions *options    = &ps->conv->options;
+    int          last_row   = 0;
+    bool         date_error = false;
+    int          status     = 0;
+
+    for (size_t i = 0; i < ps->chunk_count && status == 0; i++) {
+        sheetChunk *chunk = &ps->chunks[i];
+
+        pthread_mutex_lock(&ps->lock);
+        while (!chunk->done) {
+            pthread_cond_wait(&ps->cond, &ps->lock);
+        }
+        pthread_mutex_unlock(&ps->lock);
+
+        /* Chunks whose output depends on earlier rows are redone with the known state:
+         * a first row without a number, or anything after a date error (which
+         * suppresses all following rows in a serial parse)
+         */
+        bool redo = !chunk->failed && (chunk->range.first_row_implicit || date_error);
+        if (redo) {
+            free(chunk->output);
+            chunk->output     = NULL;
+            chunk->output_len = 0;
+            process_chunk(ps, chunk, last_row, date_error);
+        }
+
+        if (chunk->failed) {
+            status = -1;
+        } else {
+            if (!redo && chunk->range.first_row > 0) {
+                if (!options->skip_empty_lines && chunk->range.first_row > last_row + 1) {
+                    csv_write_repeated(outfile,
+                                       options->lineterminator,
+                                       (size_t)(chunk->range.first_row - last_row - 1));
+                }
+                last_row = chunk->range.last_row;
+            } else if (redo) {
+                last_row = chunk->range.last_row;
+            }
+            date_error = date_error || chunk->date_error;
+
+            ps->conv->format_stats.numbers          += chunk->format_stats.numbers;
+            ps->conv->format_stats.verbatim_numbers += chunk->format_stats.verbatim_numbers;
+
+            if (chunk->output_len > 0 &&
+                fwrite(chunk->output, 1, chunk->output_len, outfile) != chunk->output_len) {
+                status = -1;
+            }
+        }
+
+        free(chunk->output);
+        chunk->output = NULL;
+
+        pthread_mutex_lock(&ps->lock);
+        ps->written++;
+        pthread_cond_broadcast(&ps->cond);
+        pthread_mutex_unlock(&ps->lock);
+    }
+
+    if (date_error) {
+        ps->conv->has_date_error = true;
+    }
+    return status;
+}
+
+/* Index mode: read the prologue from the start of the entry */
+static char *read_prologue(xlsx2csvConverter *conv, const char *filename, size_t *prologue_len)
+{
+    void *file = zip_file_open(conv->zip_handle, filename);
+    if (!file) {
+        return NULL;
+    }
+
+    size_t capacity = 2 * PARALLEL_READ_SIZE;
+    size_t len      = 0;
+    char  *buf      = malloc(capacity);
+
+    while (buf) {
+        if (capacity - len < PARALLEL_READ_SIZE) {
+            char *new_buf = capacity < PARALLEL_PROLOGUE_LIMIT ? realloc(buf, capacity * 2) : NULL;
+            if (!new_buf) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = new_buf;
+            capacity *= 2;
+        }
+
+        int read_size = zip_file_read(file, buf + len, PARALLEL_READ_SIZE);
+        if (read_size <= 0) {
+            free(buf);
+            buf = NULL;
+            break;
+        }
+        len += (size_t)read_size;
+
+        *prologue_len = sheet_scanner_rows_start(buf, len);
+        if (*prologue_len > 0) {
+            break;
+        }
+    }
+
+    zip_file_close(file);
+    return buf;
+}
+
+/* Load the worksheet's checkpoint index, or build one with a quick inflate-only pass */
+static inflateIndex *load_index(xlsx2csvConverter  *conv,
+                                const char         *filename,
+                                const zipEntryInfo *info,
+                                const char         *index_path)
+{
+    if (index_path) {
+        inflateIndex *index =
+            inflate_index_load(index_path, info->size, info->comp_size, info->crc32);
+        if (index) {
+            return index;
+        }
+    }
+
+    uint64_t span = conv->options.index_span_mb > 0
+                        ? (uint64_t)conv->options.index_span_mb * 1024 * 1024
+                        : PARALLEL_INDEX_SPAN;
+
+    inflateIndex *index = inflate_index_create(span, info->size, info->comp_size, info->crc32);
+    void         *file  = index ? zip_file_open(conv->zip_handle, filename) : NULL;
+    if (!file || zip_file_build_index(file, index) < 0) {
+        zip_file_close(file);
+        inflate_index_free(index);
+        return NULL;
+    }
+
+    char *chunk = buffer_pool_acquire(&conv->buffers, PARALLEL_READ_SIZE);
+    while (chunk && zip_file_read(file, chunk, PARALLEL_READ_SIZE) > 0) {
+    }
+    buffer_pool_release(&conv->buffers, chunk);
+    zip_file_close(file);
+
+    if (!index->complete) {
+        inflate_index_free(index);
+        return NULL;
+    }
+
+    if (index_path && inflate_index_save(index, index_path) < 0) {
+        fprintf(stderr, "Warning: Could not write inflate index %s\n", index_path);
+    }
+    return index;
+}
+
+/* Split the rows into chunks; returns the number of chunks (0 on failure) */
+static size_t plan_chunks(parallelSheet *ps, uint64_t rows_start)
+{
+    size_t count = 0;
+
+    if (ps->data) {
+        uint64_t rows_len = ps->data_len - rows_start;
+        count             = (size_t)((rows_len + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE);
+    } else {
+        count = 1;
+        for (size_t i = 0; i < ps->index->count; i++) {
+            count += ps->index->points[i].out_offset > rows_start;
+        }
+    }
+
+    ps->chunks = calloc(count, sizeof(sheetChunk));
+    if (!ps->chunks) {
+        return 0;
+    }
+
+    ps->chunks[0].lo = rows_start;
+    if (ps->data) {
+        for (size_t i = 1; i < count; i++) {
+            ps->chunks[i].lo = rows_start + (uint64_t)i * PARALLEL_CHUNK_SIZE;
+        }
+    } else {
+        size_t n = 1;
+        for (size_t i = 0; i < ps->index->count; i++) {
+            const inflatePoint *point = &ps->index->points[i];
+            if (point->out_offset > rows_start) {
+                ps->chunks[n].lo    = point->out_offset;
+                ps->chunks[n].point = point;
+                n++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ps->chunks[i].hi = i + 1 < count ? ps->chunks[i + 1].lo : UINT64_MAX;
+    }
+
+    return count;
+}
+
+/* Run the workers and write their output */
+static int run_parallel(parallelSheet *ps, FILE *outfile)
+{
+    size_t thread_count = (size_t)ps->conv->options.jobs;
+    if (thread_count > ps->chunk_count) {
+        thread_count = ps->chunk_count;
+    }
+
+    pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+    if (!threads) {
+        return 1;
+    }
+
+    ps->max_pending = thread_count * PARALLEL_CHUNKS_AHEAD;
+    pthread_mutex_init(&ps->lock, NULL);
+    pthread_cond_init(&ps->cond, NULL);
+
+    size_t started = 0;
+    while (started < thread_count &&
+           pthread_create(&threads[started], NULL, worker_main, ps) == 0) {
+        started++;
+    }
+
+    int status = 1;
+    if (started > 0) {
+        status = write_chunks(ps, outfile);
+    }
+
+    pthread_mutex_lock(&ps->lock);
+    ps->stop = true;
+    pthread_cond_broadcast(&ps->cond);
+    pthread_mutex_unlock(&ps->lock);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (size_t i = 0; i < ps->chunk_count; i++) {
+        free(ps->chunks[i].output);
+    }
+
+    pthread_cond_destroy(&ps->cond);
+    pthread_mutex_destroy(&ps->lock);
+    free(threads);
+    return status;
+}
+
+/* Convert a worksheet by parsing row ranges on several threads */
+int parse_worksheet_parallel(xlsx2csvConverter *conv,
+                             const char        *filename,
+                             const char        *index_path,
+                             FILE              *outfile)
+{
+    zipEntryInfo info;
+    if (conv->options.jobs < 2 || zip_file_stat(conv->zip_handle, filename, &info) < 0 ||
+        info.size < 2 * PARALLEL_CHUNK_SIZE) {
+        return 1;
+    }
+
+    parallelSheet ps = {0};
+    ps.conv          = conv;
+    ps.filename      = filename;
+
+    /* Stored and moderately sized sheets are split in memory, others via checkpoints */
+    char         *inflated = NULL;
+    char         *prologue = NULL;
+    inflateIndex *index    = NULL;
+    size_t        rows_start;
+
+    ps.data = zip_file_map(conv->zip_handle, filename, &ps.data_len);
+    if (!ps.data && info.size <= XML_INFLATE_WHOLE_LIMIT) {
+        inflated = zip_file_inflate(conv->zip_handle, filename, &conv->buffers, &ps.data_len);
+        ps.data  = inflated;
+    }
+
+    if (ps.data) {
+        rows_start      = sheet_scanner_rows_start(ps.data, ps.data_len);
+        ps.prologue     = ps.data;
+        ps.prologue_len = rows_start;
+    } else {
+        index      = load_index(conv, filename, &info, index_path);
+        prologue   = index ? read_prologue(conv, filename, &rows_start) : NULL;
+        ps.index        = index;
+        ps.prologue     = prologue;
+        ps.prologue_len = prologue ? rows_start : 0;
+    }
+
+    int status = 1;
+    if (ps.prologue_len > 0) {
+        ps.chunk_count = plan_chunks(&ps, ps.prologue_len);
+    }
+    if (ps.chunk_count > 1) {
+        status = run_parallel(&ps, outfile);
+    }
+
+    free(ps.chunks);
+    free(prologue);
+    inflate_index_free(index);
+    buffer_pool_release(&conv->buffers, inflated);
+    return status;
+}
@@ -0,0 +1,17 @@
+#ifndef _SHEET_PARALLEL_H
+#define _SHEET_PARALLEL_H
+
+#include <stdio.h>
+
+#include "xlsx2csv.h"
+
+/* Convert a worksheet by parsing row ranges on conv->options.jobs threads.
+ * Returns 0 on success, -1 on error, or 1 if the sheet is not worth splitting
+ * (or cannot be split); nothing has been written in that case.
+ */
+int parse_worksheet_parallel(xlsx2csvConverter *conv,
+                             const char        *filename,
+                             const char        *index_path,
+                             FILE              *outfile);
+
+#endif /* _SHEET_PARALLEL_H */
@@ -0,0 +1,664 @@
+/* Pull scanner for worksheet rows.
+ *
+ * Worksheets spend nearly all of their bytes in a tiny grammar:
+ * <row r=".."><c r=".." s=".." t=".."><v>..</v></c>...</row>. Instead of
+ * tokenizing every element with expat and matching names in callbacks, this
+ * scanner walks one row at a time with memchr() and a byte class table,
+ * leaves attribute values in place and reports only what the worksheet
+ * handlers act on. A row is reported once it has been checked completely,
+ * so anything the scanner does not handle (comments, CDATA, odd references,
+ * malformed markup) can be handed to expat starting at that row.
+ */
+
+/* memmem() */
+#define _GNU_SOURCE
+
+/* Standard library headers */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Project headers */
+#include "sheet_scanner.h"
+
+/* Limits of what the scanner takes on; anything beyond falls back to expat */
+#define SCAN_MAX_ATTS  16
+#define SCAN_MAX_DEPTH 32
+#define SCAN_VALUE_MAX 31 /* Longest row/cell attribute value passed on */
+
+/* Parse status of a single tag */
+typedef enum {
+    TAG_OK,
+    TAG_MORE,
+    TAG_FALLBACK
+} tagStatus;
+
+/* Start tag with its attributes located in the input */
+typedef struct {
+    scanSpan    name;
+    scanSpan    att_names[SCAN_MAX_ATTS];
+    scanSpan    att_values[SCAN_MAX_ATTS];
+    int         att_count;
+    bool        empty; /* <name/> */
+    const char *end;   /* Just past the closing '>' */
+} scanTag;
+
+/* Bytes that end a run of plain character data:
+ * '<', '&', ']' (for "]]>"), CR (newline normalization), control characters
+ * and everything non-ASCII (validated as UTF-8)
+ */
+static const unsigned char text_special[256] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, /* 0x00 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x10 */
+    0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x20 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, /* 0x30 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x40 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, /* 0x50 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x60 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x70 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x80 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0x90 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xA0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xB0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xC0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xD0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xE0 */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 0xF0 */
+};
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_name_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':';
+}
+
+static bool is_name_char(char c)
+{
+    return is_name_start(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+static bool name_is(const scanSpan *name, const char *literal)
+{
+    size_t len = strlen(literal);
+    return name->len == len && memcmp(name->data, literal, len) == 0;
+}
+
+/* Whether a code point is allowed in an XML 1.0 document */
+static bool is_xml_char(uint32_t code)
+{
+    return code == 0x9 || code == 0xA || code == 0xD || (code >= 0x20 && code <= 0xD7FF) ||
+           (code >= 0xE000 && code <= 0xFFFD) || (code >= 0x10000 && code <= 0x10FFFF);
+}
+
+/* Length of the UTF-8 sequence at p (first byte >= 0x80): 0 if invalid, -1 if cut off */
+static int utf8_sequence(const char *p, const char *end)
+{
+    const unsigned char *s = (const unsigned char *)p;
+    uint32_t             code;
+    int                  n;
+
+    if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+        n    = 2;
+        code = s[0] & 0x1Fu;
+    } else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+        n    = 3;
+        code = s[0] & 0x0Fu;
+    } else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+        n    = 4;
+        code = s[0] & 0x07u;
+    } else {
+        return 0;
+    }
+
+    if (end - p < n) {
+        return -1;
+    }
+    for (int i = 1; i < n; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        code = (code << 6) | (s[i] & 0x3Fu);
+    }
+
+    if ((n == 3 && code < 0x800) || (n == 4 && code < 0x10000) || !is_xml_char(code)) {
+        return 0;
+    }
+    return n;
+}
+
+/* Length of the predefined entity or character reference at p ('&'), with its code point.
+ * Returns 0 for anything else (left to expat) and -1 if the reference is cut off.
+ */
+static int scan_reference(const char *p, const char *end, uint32_t *code)
+{
+    size_t      avail = (size_t)(end - p);
+    const char *semi  = memchr(p, ';', avail < 12 ? avail : 12);
+    if (!semi) {
+        return avail < 12 ? -1 : 0;
+    }
+
+    scanSpan body = {p + 1, (size_t)(semi - p - 1)};
+    int      len  = (int)(semi - p) + 1;
+
+    if (name_is(&body, "lt")) {
+        *code = '<';
+    } else if (name_is(&body, "gt")) {
+        *code = '>';
+    } else if (name_is(&body, "amp")) {
+        *code = '&';
+    } else if (name_is(&body, "quot")) {
+        *code = '"';
+    } else if (name_is(&body, "apos")) {
+        *code = '\'';
+    } else if (body.len >= 2 && body.data[0] == '#') {
+        bool        hex    = body.data[1] == 'x';
+        const char *digit  = body.data + (hex ? 2 : 1);
+        uint32_t    value  = 0;
+        size_t      digits = 0;
+
+        for (; digit < semi; digit++, digits++) {
+            char     c = *digit;
+            uint32_t d;
+            if (c >= '0' && c <= '9') {
+                d = (uint32_t)(c - '0');
+            } else if (hex && c >= 'a' && c <= 'f') {
+                d = (uint32_t)(c - 'a' + 10);
+            } else if (hex && c >= 'A' && c <= 'F') {
+                d = (uint32_t)(c - 'A' + 10);
+            } else {
+                return 0;
+            }
+            value = value * (hex ? 16 : 10) + d;
+            if (value > 0x10FFFF) {
+                return 0;
+            }
+        }
+
+        if (digits == 0 || !is_xml_char(value)) {
+            return 0;
+        }
+        *code = value;
+    } else {
+        return 0;
+    }
+
+    return len;
+}
+
+/* End of the (ASCII) XML name at p, NULL if p does not start a name */
+static const char *scan_name(const char *p, const char *end)
+{
+    if (p == end) {
+        return end;
+    }
+    if (!is_name_start(*p)) {
+        return NULL;
+    }
+
+    p++;
+    while (p < end && is_name_char(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/* Parse a start tag; p points just past its '<' */
+static tagStatus scan_start_tag(const char *p, const char *end, scanTag *tag)
+{
+    const char *q = scan_name(p, end);
+    if (!q) {
+        return TAG_FALLBACK;
+    }
+    if (q == end) {
+        return TAG_MORE;
+    }
+
+    tag->name.data = p;
+    tag->name.len  = (size_t)(q - p);
+    tag->att_count = 0;
+
+    while (1) {
+        const char *space = q;
+        while (q < end && is_space(*q)) {
+            q++;
+        }
+        if (q == end) {
+            return TAG_MORE;
+        }
+
+        if (*q == '>') {
+            tag->empty = false;
+            tag->end   = q + 1;
+            return TAG_OK;
+        }
+        if (*q == '/') {
+            if (q + 1 == end) {
+                return TAG_MORE;
+            }
+            if (q[1] != '>') {
+                return TAG_FALLBACK;
+            }
+            tag->empty = true;
+            tag->end   = q + 2;
+            return TAG_OK;
+        }
+
+        /* Attribute: name = "value" */
+        if (q == space || tag->att_count == SCAN_MAX_ATTS) {
+            return TAG_FALLBACK;
+        }
+
+        const char *name = q;
+        q                = scan_name(q, end);
+        if (!q) {
+            return TAG_FALLBACK;
+        }
+        scanSpan att_name = {name, (size_t)(q - name)};
+
+        while (q < end && is_space(*q)) {
+            q++;
+        }
+        if (q == end) {
+            return TAG_MORE;
+        }
+        if (*q != '=') {
+            return TAG_FALLBACK;
+        }
+        q++;
+        while (q < end && is_space(*q)) {
+            q++;
+        }
+        if (q == end) {
+            return TAG_MORE;
+        }
+        if (*q != '"' && *q != '\'') {
+            return TAG_FALLBACK;
+        }
+
+        const char *value = q + 1;
+        const char *close = memchr(value, *q, (size_t)(end - value));
+        if (!close) {
+            return TAG_MORE;
+        }
+
+        /* Values that expat would expand or normalize are left to it */
+        for (const char *v = value; v < close; v++) {
+            unsigned char c = (unsigned char)*v;
+            if (c == '\t' || c == '\n') {
+                return TAG_FALLBACK;
+            }
+            if (!text_special[c] || c == ']') {
+                continue;
+            }
+            if (c < 0x80) {
+                return TAG_FALLBACK;
+            }
+            int n = utf8_sequence(v, close);
+            if (n <= 0) {
+                return TAG_FALLBACK;
+            }
+            v += n - 1;
+        }
+
+        for (int i = 0; i < tag->att_count; i++) {
+            if (tag->att_names[i].len == att_name.len &&
+                memcmp(tag->att_names[i].data, att_name.data, att_name.len) == 0) {
+                return TAG_FALLBACK;
+            }
+        }
+
+        tag->att_names[tag->att_count]  = att_name;
+        tag->att_values[tag->att_count] = (scanSpan){value, (size_t)(close - value)};
+        tag->att_count++;
+        q = close + 1;
+    }
+}
+
+/* Value of a row/cell attribute; false if it is too long to be passed on */
+static bool tag_attribute(const scanTag *tag, const char *name, scanSpan *value)
+{
+    value->data = NULL;
+    value->len  = 0;
+
+    for (int i = 0; i < tag->att_count; i++) {
+        if (name_is(&tag->att_names[i], name)) {
+            *value = tag->att_values[i];
+            return value->len <= SCAN_VALUE_MAX;
+        }
+    }
+
+    return true;
+}
+
+/* Append an event, growing the list as needed */
+static scanEvent *push_event(sheetScanner *scanner, scanEventKind kind)
+{
+    if (scanner->count == scanner->capacity) {
+        size_t     capacity = scanner->capacity ? scanner->capacity * 2 : 64;
+        scanEvent *events   = realloc(scanner->events, capacity * sizeof(scanEvent));
+        if (!events) {
+            return NULL;
+        }
+        scanner->events   = events;
+        scanner->capacity = capacity;
+    }
+
+    scanEvent *event = &scanner->events[scanner->count++];
+    memset(event, 0, sizeof(*event));
+    event->kind = kind;
+    return event;
+}
+
+void sheet_scanner_init(sheetScanner *scanner)
+{
+    memset(scanner, 0, sizeof(*scanner));
+}
+
+void sheet_scanner_free(sheetScanner *scanner)
+{
+    free(scanner->events);
+    memset(scanner, 0, sizeof(*scanner));
+}
+
+/* Offset just past the <sheetData> start tag, 0 if missing or empty */
+size_t sheet_scanner_rows_start(const char *data, size_t len)
+{
+    const char *tag = memmem(data, len, "<sheetData", 10);
+    if (!tag) {
+        return 0;
+    }
+
+    const char *gt = memchr(tag, '>', len - (size_t)(tag - data));
+    if (!gt || gt[-1] == '/') {
+        return 0;
+    }
+
+    return (size_t)(gt - data) + 1;
+}
+
+/* Whether rows after this prologue can be scanned (UTF-8, no DTD) */
+bool sheet_scanner_prologue_ok(const char *prologue, size_t len)
+{
+    if (!prologue || len == 0) {
+        return false;
+    }
+
+    /* A DTD can declare entities and default attributes */
+    if (memmem(prologue, len, "<!DOCTYPE", 9)) {
+        return false;
+    }
+
+    const char *p   = prologue;
+    const char *end = prologue + len;
+    if (len >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+    if (end - p < 5 || memcmp(p, "<?xml", 5) != 0) {
+        return true;
+    }
+
+    const char *decl_end = memmem(p, (size_t)(end - p), "?>", 2);
+    if (!decl_end) {
+        return false;
+    }
+    const char *enc = memmem(p, (size_t)(decl_end - p), "encoding", 8);
+    if (!enc) {
+        return true;
+    }
+
+    enc += 8;
+    while (enc < decl_end && (is_space(*enc) || *enc == '=')) {
+        enc++;
+    }
+    return decl_end - enc >= 7 && (*enc == '"' || *enc == '\'') &&
+           strncasecmp(enc + 1, "utf-8", 5) == 0 && enc[6] == *enc;
+}
+
+/* Scan the next row; *consumed is the end of the row, or where the result applies */
+scanResult sheet_scanner_next_row(sheetScanner *scanner,
+                                  const char   *data,
+                                  size_t        len,
+                                  size_t       *consumed)
+{
+    const char *p   = data;
+    const char *end = data + len;
+
+    scanner->count = 0;
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    *consumed = (size_t)(p - data);
+
+    if (end - p < 11) {
+        return SCAN_MORE;
+    }
+    if (memcmp(p, "</sheetData", 11) == 0) {
+        return SCAN_END;
+    }
+    if (memcmp(p, "<row", 4) != 0 || !(is_space(p[4]) || p[4] == '>' || p[4] == '/')) {
+        return SCAN_FALLBACK;
+    }
+
+    scanTag   tag;
+    tagStatus status = scan_start_tag(p + 1, end, &tag);
+    if (status != TAG_OK) {
+        return status == TAG_MORE ? SCAN_MORE : SCAN_FALLBACK;
+    }
+
+    scanEvent *event = push_event(scanner, SCAN_ROW_START);
+    if (!event || !tag_attribute(&tag, "r", &event->value) ||
+        !tag_attribute(&tag, "hidden", &event->hidden)) {
+        return SCAN_FALLBACK;
+    }
+
+    /* Element stack below <row>, and the handler flags it drives */
+    scanSpan stack[SCAN_MAX_DEPTH];
+    int      depth   = 0;
+    bool     in_cell = false;
+    bool     in_v    = false;
+    bool     in_is   = false;
+    bool     in_t    = false;
+
+    const char *q        = tag.end;
+    bool        row_open = !tag.empty;
+
+    while (row_open) {
+        /* Character data up to the next tag */
+        const char *text    = q;
+        bool        escaped = false;
+        while (q < end) {
+            unsigned char c = (unsigned char)*q;
+            if (!text_special[c]) {
+                q++;
+                continue;
+            }
+            if (c == '<') {
+                break;
+            }
+
+            int n;
+            if (c == '&') {
+                uint32_t code;
+                n       = scan_reference(q, end, &code);
+                escaped = true;
+            } else if (c == ']') {
+                n = end - q < 3 ? -1 : (q[1] == ']' && q[2] == '>') ? 0 : 1;
+            } else if (c >= 0x80) {
+                n = utf8_sequence(q, end);
+            } else {
+                n = 0;
+            }
+
+            if (n < 0) {
+                return SCAN_MORE;
+            }
+            if (n == 0) {
+                return SCAN_FALLBACK;
+            }
+            q += n;
+        }
+        if (end - q < 2) {
+            return SCAN_MORE;
+        }
+
+        if (q > text && in_cell && (in_v || (in_t && in_is))) {
+            event = push_event(scanner, SCAN_TEXT);
+            if (!event) {
+                return SCAN_FALLBACK;
+            }
+            event->value.data = text;
+            event->value.len  = (size_t)(q - text);
+            event->escaped    = escaped;
+        }
+
+        /* Comments, CDATA and processing instructions are left to expat */
+        if (q[1] == '!' || q[1] == '?') {
+            return SCAN_FALLBACK;
+        }
+
+        scanSpan name;
+        bool     closing = q[1] == '/';
+        if (closing) {
+            const char *name_end = scan_name(q + 2, end);
+            if (!name_end) {
+                return SCAN_FALLBACK;
+            }
+            name.data = q + 2;
+            name.len  = (size_t)(name_end - name.data);
+
+            q = name_end;
+            while (q < end && is_space(*q)) {
+                q++;
+            }
+            if (q == end) {
+                return SCAN_MORE;
+            }
+            if (*q != '>') {
+                return SCAN_FALLBACK;
+            }
+            q++;
+
+            if (depth == 0) {
+                if (!name_is(&name, "row")) {
+                    return SCAN_FALLBACK;
+                }
+                row_open = false;
+                continue;
+            }
+            depth--;
+            if (stack[depth].len != name.len ||
+                memcmp(stack[depth].data, name.data, name.len) != 0) {
+                return SCAN_FALLBACK;
+            }
+        } else {
+            status = scan_start_tag(q + 1, end, &tag);
+            if (status != TAG_OK) {
+                return status == TAG_MORE ? SCAN_MORE : SCAN_FALLBACK;
+            }
+            name = tag.name;
+            q    = tag.end;
+
+            if (name_is(&name, "row") || name_is(&name, "sheetData") ||
+                name_is(&name, "dimension")) {
+                return SCAN_FALLBACK;
+            } else if (name_is(&name, "c")) {
+                if (in_cell) {
+                    return SCAN_FALLBACK;
+                }
+                event = push_event(scanner, SCAN_CELL_START);
+                if (!event || !tag_attribute(&tag, "r", &event->value) ||
+                    !tag_attribute(&tag, "t", &event->type) ||
+                    !tag_attribute(&tag, "s", &event->style)) {
+                    return SCAN_FALLBACK;
+                }
+                in_cell = true;
+                in_v    = false;
+                in_is   = false;
+                in_t    = false;
+            } else if (name_is(&name, "v")) {
+                in_v = in_v || in_cell;
+            } else if (name_is(&name, "is")) {
+                in_is = in_is || in_cell;
+            } else if (name_is(&name, "t")) {
+                in_t = in_t || (in_cell && (in_is || in_v));
+            }
+
+            if (!tag.empty) {
+                if (depth == SCAN_MAX_DEPTH) {
+                    return SCAN_FALLBACK;
+                }
+                stack[depth++] = name;
+                continue;
+            }
+        }
+
+        /* End of an element (closing tag or <name/>) */
+        if (name_is(&name, "c")) {
+            if (in_cell && !push_event(scanner, SCAN_CELL_END)) {
+                return SCAN_FALLBACK;
+            }
+            in_cell = false;
+        } else if (name_is(&name, "v")) {
+            in_v = false;
+        } else if (name_is(&name, "is")) {
+            in_is = false;
+        } else if (name_is(&name, "t")) {
+            in_t = false;
+        }
+    }
+
+    if (!push_event(scanner, SCAN_ROW_END)) {
+        return SCAN_FALLBACK;
+    }
+    *consumed = (size_t)(q - data);
+    return SCAN_ROW;
+}
+
+/* Decode the references of escaped text into dst (at most len bytes) */
+size_t sheet_scanner_unescape(const char *src, size_t len, char *dst)
+{
+    const char *end = src + len;
+    char       *out = dst;
+
+    while (src < end) {
+        const char *amp = memchr(src, '&', (size_t)(end - src));
+        size_t      run = amp ? (size_t)(amp - src) : (size_t)(end - src);
+        memmove(out, src, run);
+        out += run;
+        src += run;
+        if (!amp) {
+            break;
+        }
+
+        uint32_t code = 0;
+        int      n    = scan_reference(src, end, &code);
+        if (n <= 0) {
+            *out++ = *src++;
+            continue;
+        }
+        src += n;
+
+        if (code < 0x80) {
+            *out++ = (char)code;
+        } else if (code < 0x800) {
+            *out++ = (char)(0xC0 | (code >> 6));
+            *out++ = (char)(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            *out++ = (char)(0xE0 | (code >> 12));
+            *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+            *out++ = (char)(0x80 | (code & 0x3F));
+        } else {
+            *out++ = (char)(0xF0 | (code >> 18));
+            *out++ = (char)(0x80 | ((code >> 12) & 0x3F));
+            *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+            *out++ = (char)(0x80 | (code & 0x3F));
+        }
+    }
+
+    return (size_t)(out - dst);
+}
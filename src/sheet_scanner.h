@@ -0,0 +1,64 @@
+#ifndef _SHEET_SCANNER_H
+#define _SHEET_SCANNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Part of the input, not NUL-terminated; data is NULL if absent */
+typedef struct {
+    const char *data;
+    size_t      len;
+} scanSpan;
+
+/* What the worksheet handlers would have seen, reduced to what they act on */
+typedef enum {
+    SCAN_ROW_START,  /* value: r attribute, hidden: hidden attribute */
+    SCAN_ROW_END,
+    SCAN_CELL_START, /* value: r attribute, type: t attribute, style: s attribute */
+    SCAN_CELL_END,
+    SCAN_TEXT        /* value: cell text, with references left in if escaped is set */
+} scanEventKind;
+
+typedef struct {
+    scanEventKind kind;
+    bool          escaped;
+    scanSpan      value;
+    scanSpan      type;
+    scanSpan      style;
+    scanSpan      hidden;
+} scanEvent;
+
+typedef enum {
+    SCAN_ROW,     /* One row scanned, its events are ready */
+    SCAN_END,     /* Reached </sheetData> */
+    SCAN_MORE,    /* The row continues past the end of the data */
+    SCAN_FALLBACK /* Markup the scanner does not handle: let expat parse from here */
+} scanResult;
+
+/* Pull scanner for the <row>/<c>/<v> grammar of <sheetData> */
+typedef struct {
+    scanEvent *events; /* Events of the last row scanned */
+    size_t     count;
+    size_t     capacity;
+} sheetScanner;
+
+/* Lifetime */
+void sheet_scanner_init(sheetScanner *scanner);
+void sheet_scanner_free(sheetScanner *scanner);
+
+/* Offset just past the <sheetData> start tag, 0 if missing or empty */
+size_t sheet_scanner_rows_start(const char *data, size_t len);
+
+/* Whether rows after this prologue can be scanned (UTF-8, no DTD) */
+bool sheet_scanner_prologue_ok(const char *prologue, size_t len);
+
+/* Scan the next row; *consumed is the end of the row, or where the result applies */
+scanResult sheet_scanner_next_row(sheetScanner *scanner,
+                                  const char   *data,
+                                  size_t        len,
+                                  size_t       *consumed);
+
+/* Decode the references of escaped text into dst (at most len bytes) */
+size_t sheet_scanner_unescape(const char *src, size_t len, char *dst);
+
+#endif /* _SHEET_SCANNER_H */
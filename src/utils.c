@@ -5,6 +5,7 @@
 #include <string.h>
 
 /* Project headers */
+#include "number_parse.h"
 #include "utils.h"
 
 /* Duplicate string */
@@ -115,55 +116,83 @@ char *column_index_to_name(int index)
     return result;
 }
 
-/* Check if string is numeric */
-bool is_numeric(const char *str)
+/* Get a buffer of at least size bytes, reusing a pooled allocation when possible
+ * Falls back to a plain malloc when every slot is busy
+ */
+char *buffer_pool_acquire(bufferPool *pool, size_t size)
 {
-    if (!str || *str == '\0') {
-        return false;
-    }
+    poolBuffer *best = NULL;
 
-    int i = 0;
+    /* Prefer the smallest free buffer that already fits, else the largest free one */
+    for (int i = 0; i < BUFFER_POOL_SLOTS; i++) {
+        poolBuffer *slot = &pool->slots[i];
+        if (slot->in_use) {
+            continue;
+        }
+        if (!best) {
+            best = slot;
+        } else if (slot->capacity >= size) {
+            if (best->capacity < size || slot->capacity < best->capacity) {
+                best = slot;
+            }
+        } else if (best->capacity < size && slot->capacity > best->capacity) {
+            best = slot;
+        }
+    }
 
-    /* Skip leading whitespace */
-    while (isspace(str[i])) {
-        i++;
+    if (!best) {
+        return malloc(size);
     }
 
-    /* Check for sign */
-    if (str[i] == '+' || str[i] == '-') {
-        i++;
+    if (best->capacity < size) {
+        char *data = realloc(best->data, size);
+        if (!data) {
+            return NULL;
+        }
+        best->data     = data;
+        best->capacity = size;
     }
 
-    bool has_digit = false;
-    bool has_dot   = false;
-    bool has_exp   = false;
+    best->in_use = true;
+    return best->data;
+}
 
-    while (str[i] != '\0') {
-        if (isdigit(str[i])) {
-            has_digit = true;
-        } else if (str[i] == '.' && !has_dot && !has_exp) {
-            has_dot = true;
-        } else if ((str[i] == 'e' || str[i] == 'E') && !has_exp && has_digit) {
-            has_exp   = true;
-            has_digit = false; /* Need at least one digit after 'e' */
-            i++;
-            if (str[i] == '+' || str[i] == '-') {
-                i++;
-            }
-            continue;
-        } else if (isspace(str[i])) {
-            /* Trailing whitespace is ok */
-            break;
-        } else {
-            return false;
+/* Return buffer to the pool (or free it if it did not come from a slot) */
+void buffer_pool_release(bufferPool *pool, char *data)
+{
+    if (!data) {
+        return;
+    }
+
+    for (int i = 0; i < BUFFER_POOL_SLOTS; i++) {
+        if (pool->slots[i].data == data) {
+            pool->slots[i].in_use = false;
+            return;
         }
-        i++;
     }
 
-    /* Skip trailing whitespace */
-    while (isspace(str[i])) {
-        i++;
+    free(data);
+}
+
+/* Free all pooled buffers */
+void buffer_pool_free(bufferPool *pool)
+{
+    for (int i = 0; i < BUFFER_POOL_SLOTS; i++) {
+        free(pool->slots[i].data);
+        pool->slots[i].data     = NULL;
+        pool->slots[i].capacity = 0;
+        pool->slots[i].in_use   = false;
+    }
+}
+
+/* Check if string is numeric */
+bool is_numeric(const char *str)
+{
+    if (!str) {
+        return false;
     }
 
-    return has_digit && str[i] == '\0';
+    parsedNumber number;
+    number_parse(str, &number);
+    return number.numeric;
 }
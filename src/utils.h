@@ -2,6 +2,9 @@
 #define _UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "xlsx2csv.h"
 
 /* String utilities */
 char *str_duplicate(const char *str);
@@ -12,6 +15,11 @@ bool  str_match_pattern(const char *str, const char *pattern);
 int   column_name_to_index(const char *column);
 char *column_index_to_name(int index);
 
+/* Scratch buffer pool */
+char *buffer_pool_acquire(bufferPool *pool, size_t size);
+void  buffer_pool_release(bufferPool *pool, char *data);
+void  buffer_pool_free(bufferPool *pool);
+
 /* Validation utilities */
 bool is_numeric(const char *str);
 
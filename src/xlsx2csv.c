@@ -6,6 +6,9 @@
 /* Project headers */
 #include "csv_writer.h"
 #include "format_handler.h"
+#include "inflate_backend.h"
+#include "metadata_cache.h"
+#include "shared_strings.h"
 #include "utils.h"
 #include "xlsx2csv.h"
 #include "xml_parser.h"
@@ -37,6 +40,18 @@ static void init_default_options(xlsxOptions *opts)
     opts->ignore_formats              = NULL;
     opts->ignore_formats_count        = 0;
     opts->skip_hidden_rows            = true;
+    opts->inflate_backend             = NULL;
+    opts->print_stats                 = false;
+    opts->index_span_mb               = 0;
+    opts->index_dir                   = NULL;
+    opts->jobs                        = 1;
+    opts->fast_scanner                = false;
+    opts->lazy_strings                = false;
+    opts->sst_memory_mb               = 0;
+    opts->cache_dir                   = NULL;
+    opts->excel_formats               = false;
+    opts->shortest_floats             = false;
+    opts->write_buffer_kb             = 1024;
 }
 
 /* Create xlsx2csv converter */
@@ -57,6 +72,12 @@ xlsx2csvConverter *xlsx2csv_create(const char *filename, xlsxOptions *options)
         init_default_options(&conv->options);
     }
 
+    conv->filename = str_duplicate(filename ? filename : "-");
+    if (!conv->filename) {
+        free(conv);
+        return NULL;
+    }
+
     /* Open ZIP file */
     if (filename && strcmp(filename, "-") == 0) {
         conv->zip_handle = zip_open_stdin();
@@ -65,10 +86,20 @@ xlsx2csvConverter *xlsx2csv_create(const char *filename, xlsxOptions *options)
     }
 
     if (!conv->zip_handle) {
+        free(conv->filename);
         free(conv);
         return NULL;
     }
 
+    const inflateBackend *backend = inflate_backend_find(conv->options.inflate_backend);
+    if (!backend) {
+        fprintf(stderr, "Error: unknown inflate backend '%s' (available: %s)\n",
+                conv->options.inflate_backend, inflate_backend_list());
+        xlsx2csv_free(conv);
+        return NULL;
+    }
+    zip_set_inflate_backend(conv->zip_handle, backend);
+
     /* Parse metadata */
     if (parse_content_types(conv) < 0) {
         fprintf(stderr, "Warning: Failed to parse content types\n");
@@ -80,13 +111,28 @@ xlsx2csvConverter *xlsx2csv_create(const char *filename, xlsxOptions *options)
         return NULL;
     }
 
-    if (parse_shared_strings(conv) < 0) {
-        fprintf(stderr, "Warning: Failed to parse shared strings\n");
-    }
+    /* Shared strings and styles come from the cache if it has this workbook */
+    if (metadata_cache_load(conv) < 0) {
+        bool parsed = true;
+        if (parse_shared_strings(conv) < 0) {
+            fprintf(stderr, "Warning: Failed to parse shared strings\n");
+            parsed = false;
+        }
+
+        if (parse_styles(conv) < 0) {
+            fprintf(stderr, "Warning: Failed to parse styles\n");
+            parsed = false;
+        }
+        metadata_parser_free(conv);
 
-    if (parse_styles(conv) < 0) {
-        fprintf(stderr, "Warning: Failed to parse styles\n");
+        bool cacheable = conv->options.cache_dir && strcmp(conv->filename, "-") != 0 &&
+                         !conv->shared_strings.lazy;
+        if (parsed && cacheable && metadata_cache_save(conv) < 0) {
+            fprintf(stderr, "Warning: Failed to write metadata cache in %s\n",
+                    conv->options.cache_dir);
+        }
     }
+    shared_strings_cache_forms(&conv->shared_strings, &conv->options);
 
     return conv;
 }
@@ -98,10 +144,13 @@ void xlsx2csv_free(xlsx2csvConverter *conv)
         return;
     }
 
+    metadata_parser_free(conv);
+
     /* Free ZIP handle */
     if (conv->zip_handle) {
         xlsx_zip_close(conv->zip_handle);
     }
+    free(conv->filename);
 
     /* Free workbook data */
     for (int i = 0; i < conv->workbook.sheet_count; i++) {
@@ -112,17 +161,13 @@ void xlsx2csv_free(xlsx2csvConverter *conv)
     free(conv->workbook.sheets);
 
     /* Free shared strings */
-    for (int i = 0; i < conv->shared_strings.count; i++) {
-        free(conv->shared_strings.strings[i]);
-    }
-    free(conv->shared_strings.strings);
+    shared_strings_free(&conv->shared_strings);
 
     /* Free styles */
-    for (int i = 0; i < conv->styles.format_count; i++) {
-        free(conv->styles.formats[i].format_code);
-    }
-    free(conv->styles.formats);
-    free(conv->styles.cell_xfs);
+    styles_free(&conv->styles);
+
+    /* Free scratch buffers */
+    buffer_pool_free(&conv->buffers);
 
     /* Note: We don't free option strings as they may point to static strings or command-line
      * arguments */
@@ -248,3 +293,20 @@ int xlsx2csv_convert_all(xlsx2csvConverter *conv, const char *outdir)
 
     return 0;
 }
+
+/* Print decompression and formatting statistics */
+void xlsx2csv_print_stats(xlsx2csvConverter *conv, FILE *out)
+{
+    if (!conv || !out) {
+        return;
+    }
+
+    const inflateBackend *backend = inflate_backend_find(conv->options.inflate_backend);
+    const inflateStats   *stats   = zip_inflate_stats(conv->zip_handle);
+    if (backend && stats) {
+        inflate_stats_print(stats, backend->name, out);
+    }
+    fprintf(out, "numbers verbatim:  %llu of %llu\n",
+            (unsigned long long)conv->format_stats.verbatim_numbers,
+            (unsigned long long)conv->format_stats.numbers);
+}
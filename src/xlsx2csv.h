@@ -53,6 +53,18 @@ typedef struct {
     char      **ignore_formats;
     int         ignore_formats_count;
     bool        skip_hidden_rows;
+    char       *inflate_backend; /* NULL selects the default backend */
+    bool        print_stats;
+    int         index_span_mb;   /* Worksheet checkpoint spacing in MB, 0 = no index */
+    char       *index_dir;       /* Where checkpoint indexes live, NULL = next to the workbook */
+    int         jobs;            /* Worker threads for large worksheets, 1 = serial */
+    bool        fast_scanner;    /* Scan worksheet rows without expat where possible */
+    bool        lazy_strings;    /* Index shared strings, decode each on first use */
+    int         sst_memory_mb;   /* MB of shared strings held before spilling, 0 = no limit */
+    char       *cache_dir;       /* Cache of parsed shared strings and styles, NULL = off */
+    bool        excel_formats;   /* Render numbers and dates with their Excel number format */
+    bool        shortest_floats; /* Shortest round-trip digits instead of %.15g */
+    int         write_buffer_kb; /* KB of CSV collected before each write, 0 = default */
 } xlsxOptions;
 
 /* Sheet information */
@@ -70,10 +82,26 @@ typedef struct {
     bool       date1904;
 } workbookInfo;
 
-/* Shared strings */
+/* Shared string: len bytes at offset in the arena, followed by a NUL */
 typedef struct {
-    char **strings;
-    int    count;
+    size_t offset;
+    size_t len;
+} sharedString;
+
+/* Index of sharedStrings.xml for lazy decoding, and CSV forms of the strings (shared_strings.c) */
+typedef struct sharedStringIndex sharedStringIndex;
+typedef struct sharedStringForms sharedStringForms;
+
+/* Shared strings, stored back to back in one arena (or decoded on first use if lazy is set) */
+typedef struct {
+    char              *arena;
+    size_t             arena_len;
+    sharedString      *entries;
+    int                count;
+    sharedStringIndex *lazy;
+    sharedStringForms *forms;
+    void              *maps[2]; /* Mappings arena and entries point into, if not allocated */
+    size_t             map_lens[2];
 } sharedStrings;
 
 /* Number format */
@@ -83,22 +111,68 @@ typedef struct {
     formatType type;
 } numFormat;
 
+/* Cell style flags, decided once per style */
+typedef enum {
+    STYLE_FLOAT_STANDARD   = 1 << 0, /* float_code is a standard format, --floatformat skips it */
+    STYLE_FLOAT_DECIMALS   = 1 << 1, /* float_code starts with "0.0" */
+    STYLE_PERCENT_DECIMALS = 1 << 2, /* format_code starts with "0.0" */
+    STYLE_DATE_TIME        = 1 << 3  /* format_code shows the time of day as well as the date */
+} cellStyleFlag;
+
+/* Compiled Excel number format (number_format.c) */
+typedef struct numberFormat numberFormat;
+
+/* Number format of a cellXfs entry, resolved when the styles are loaded */
+typedef struct {
+    formatType          type;
+    const char         *format_code; /* Custom format code, NULL for built-in formats */
+    const char         *float_code;  /* Code applied to floats: custom or built-in, NULL if none */
+    unsigned            flags;       /* cellStyleFlag bits */
+    const numberFormat *program;     /* Compiled format, NULL unless excel_formats is set */
+} cellStyle;
+
 /* Style information */
 typedef struct {
-    numFormat *formats;
-    int        format_count;
-    int       *cell_xfs;
-    int        cell_xfs_count;
+    numFormat     *formats;
+    int            format_count;
+    int           *cell_xfs;
+    int            cell_xfs_count;
+    cellStyle     *cell_styles; /* Resolved cell_xfs, same indexes */
+    numberFormat **programs;    /* Compiled custom formats, then the built-in ones */
+    int            program_count;
 } styleInfo;
 
+/* Reusable scratch buffers (metadata parts, worksheet read chunks) */
+#define BUFFER_POOL_SLOTS 4
+
+typedef struct {
+    char  *data;
+    size_t capacity;
+    bool   in_use;
+} poolBuffer;
+
+typedef struct {
+    poolBuffer slots[BUFFER_POOL_SLOTS];
+} bufferPool;
+
+/* Cell formatting counters, printed by --stats */
+typedef struct {
+    uint64_t numbers;          /* Cells formatted as numbers (not dates or times) */
+    uint64_t verbatim_numbers; /* Of those, copied as stored without converting them */
+} formatStats;
+
 /* Main converter structure */
 typedef struct {
+    char         *filename; /* Input path, "-" for STDIN */
     void         *zip_handle;
     xlsxOptions   options;
     workbookInfo  workbook;
     sharedStrings shared_strings;
     styleInfo     styles;
+    bufferPool    buffers;
+    void         *metadata_parser; /* Expat parser reused across the metadata parts */
     bool          has_date_error; /* Flag for date format errors (Python compatibility) */
+    formatStats   format_stats;
 } xlsx2csvConverter;
 
 /* Main API functions */
@@ -109,5 +183,6 @@ int                xlsx2csv_convert(xlsx2csvConverter *conv,
                                     int                sheetid,
                                     const char        *sheetname);
 int                xlsx2csv_convert_all(xlsx2csvConverter *conv, const char *outdir);
+void               xlsx2csv_print_stats(xlsx2csvConverter *conv, FILE *out);
 
 #endif /* _XLSX2CSV_H */
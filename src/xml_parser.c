@@ -1,5 +1,6 @@
 /* Standard library headers */
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,113 +11,162 @@
 /* Project headers */
 #include "csv_writer.h"
 #include "format_handler.h"
+#include "sheet_parallel.h"
+#include "shared_strings.h"
+#include "sheet_scanner.h"
 #include "utils.h"
 #include "xlsx2csv.h"
 #include "xml_parser.h"
 #include "zip_reader.h"
 
-/* Count sheets state */
-typedef struct {
-    int  *sheet_count;
-    bool *in_sheets;
-} count_sheets_state_t;
+/* Bytes inflated per expat buffer when streaming a worksheet */
+#define XML_STREAM_CHUNK_SIZE (256 * 1024)
+
+/* Give up looking for <sheetData> (and scan nothing) after this much XML */
+#define XML_PROLOGUE_LIMIT (16 * 1024 * 1024)
 
-static void count_sheets_start(void *userData, const XML_Char *name, const XML_Char **atts)
+/* Feed in-memory data to expat in chunks (XML_Parse takes an int length), without finishing */
+static int parse_xml_partial(XML_Parser parser, const char *data, size_t size)
 {
-    (void)atts; /* Unused */
-    count_sheets_state_t *state = (count_sheets_state_t *)userData;
-    if (strcmp(name, "sheets") == 0) {
-        *state->in_sheets = true;
-    } else if (strcmp(name, "sheet") == 0 && *state->in_sheets) {
-        (*state->sheet_count)++;
+    while (size > XML_STREAM_CHUNK_SIZE) {
+        if (XML_Parse(parser, data, XML_STREAM_CHUNK_SIZE, 0) == XML_STATUS_ERROR) {
+            return -1;
+        }
+        data += XML_STREAM_CHUNK_SIZE;
+        size -= XML_STREAM_CHUNK_SIZE;
+    }
+
+    if (XML_Parse(parser, data, (int)size, 0) == XML_STATUS_ERROR) {
+        return -1;
     }
+
+    return 0;
 }
 
-static void count_sheets_end(void *userData, const XML_Char *name)
+/* Parse a complete document held in memory */
+static int parse_xml_buffer(XML_Parser parser, const char *data, size_t size)
 {
-    count_sheets_state_t *state = (count_sheets_state_t *)userData;
-    if (strcmp(name, "sheets") == 0) {
-        *state->in_sheets = false;
+    if (parse_xml_partial(parser, data, size) < 0 ||
+        XML_Parse(parser, NULL, 0, 1) == XML_STATUS_ERROR) {
+        return -1;
     }
-}
 
-/* Count strings state */
-typedef struct {
-    int  *count;
-    bool *in_si;
-} count_strings_state_t;
+    return 0;
+}
 
-static void count_strings_start(void *userData, const XML_Char *name, const XML_Char **atts)
+/* Feed an open ZIP entry to expat in fixed-size chunks.
+ * Data is inflated into one pooled chunk buffer that expat parses in place,
+ * so peak memory does not depend on the size of the entry, handlers fire as
+ * soon as data arrives, and consecutive sheets reuse the same allocation.
+ */
+static int parse_xml_stream(XML_Parser parser, void *file, bufferPool *pool)
 {
-    (void)atts; /* Unused */
-    count_strings_state_t *state = (count_strings_state_t *)userData;
-    if (strcmp(name, "si") == 0) {
-        *state->in_si = true;
-        (*state->count)++;
+    char *chunk = buffer_pool_acquire(pool, XML_STREAM_CHUNK_SIZE);
+    if (!chunk) {
+        return -1;
+    }
+
+    int status = 0;
+    while (1) {
+        int read_size = zip_file_read(file, chunk, XML_STREAM_CHUNK_SIZE);
+        if (read_size < 0) {
+            status = -1;
+            break;
+        }
+
+        bool is_final = (read_size == 0);
+        if (XML_Parse(parser, chunk, read_size, is_final) == XML_STATUS_ERROR) {
+            status = -1;
+            break;
+        }
+
+        if (is_final) {
+            break;
+        }
     }
+
+    buffer_pool_release(pool, chunk);
+    return status;
 }
 
-static void count_strings_end(void *userData, const XML_Char *name)
+/* Expat parser shared by the metadata loaders, reset for each part */
+static XML_Parser metadata_parser(xlsx2csvConverter *conv)
 {
-    count_strings_state_t *state = (count_strings_state_t *)userData;
-    if (strcmp(name, "si") == 0) {
-        *state->in_si = false;
+    if (!conv->metadata_parser) {
+        conv->metadata_parser = XML_ParserCreate(NULL);
+        return conv->metadata_parser;
+    }
+
+    if (!XML_ParserReset(conv->metadata_parser, NULL)) {
+        return NULL;
     }
+    return conv->metadata_parser;
 }
 
-/* Count styles state */
-typedef struct {
-    int  *format_count;
-    int  *xf_count;
-    bool *in_num_fmts;
-    bool *in_cell_xfs;
-} count_styles_state_t;
+/* Free the metadata parser once all parts are loaded */
+void metadata_parser_free(xlsx2csvConverter *conv)
+{
+    if (conv->metadata_parser) {
+        XML_ParserFree(conv->metadata_parser);
+        conv->metadata_parser = NULL;
+    }
+}
 
-static void count_styles_start(void *userData, const XML_Char *name, const XML_Char **atts)
+/* Make room for needed items in a growable array; NULL if out of memory (items stay valid) */
+static void *array_reserve(void *items, int *capacity, int needed, size_t item_size)
 {
-    (void)atts; /* Unused */
-    count_styles_state_t *state = (count_styles_state_t *)userData;
-    if (strcmp(name, "numFmts") == 0) {
-        *state->in_num_fmts = true;
-    } else if (strcmp(name, "numFmt") == 0 && *state->in_num_fmts) {
-        (*state->format_count)++;
-    } else if (strcmp(name, "cellXfs") == 0) {
-        *state->in_cell_xfs = true;
-    } else if (strcmp(name, "xf") == 0 && *state->in_cell_xfs) {
-        (*state->xf_count)++;
+    if (needed <= *capacity) {
+        return items;
+    }
+
+    int new_capacity = *capacity > 0 ? *capacity : 16;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
     }
+
+    void *grown = realloc(items, (size_t)new_capacity * item_size);
+    if (grown) {
+        *capacity = new_capacity;
+    }
+    return grown;
 }
 
-static void count_styles_end(void *userData, const XML_Char *name)
+/* Initial capacity from a count attribute, bounded by what the document can hold */
+static int count_hint(const XML_Char *value, size_t xml_len, size_t min_item_len)
 {
-    count_styles_state_t *state = (count_styles_state_t *)userData;
-    if (strcmp(name, "numFmts") == 0) {
-        *state->in_num_fmts = false;
-    } else if (strcmp(name, "cellXfs") == 0) {
-        *state->in_cell_xfs = false;
+    long   hint  = value ? atol(value) : 0;
+    size_t bound = xml_len / min_item_len + 1;
+
+    if (hint <= 0) {
+        return 0;
     }
+    if ((size_t)hint > bound) {
+        hint = (long)bound;
+    }
+    return hint > INT_MAX ? INT_MAX : (int)hint;
 }
 
 /* Parse Content Types XML */
 int parse_content_types(xlsx2csvConverter *conv)
 {
-    char *xml_data = zip_read_file_to_string(conv->zip_handle, "[Content_Types].xml");
+    size_t xml_len  = 0;
+    char  *xml_data =
+        zip_read_file_pooled(conv->zip_handle, "[Content_Types].xml", &conv->buffers, &xml_len);
     if (!xml_data) {
         fprintf(stderr, "Error: Could not read [Content_Types].xml\n");
         return -1;
     }
 
-    XML_Parser parser = XML_ParserCreate(NULL);
+    XML_Parser parser = metadata_parser(conv);
     if (!parser) {
-        free(xml_data);
+        buffer_pool_release(&conv->buffers, xml_data);
         return -1;
     }
 
-    int status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
-    XML_ParserFree(parser);
-    free(xml_data);
+    int status = parse_xml_buffer(parser, xml_data, xml_len);
+    buffer_pool_release(&conv->buffers, xml_data);
 
-    if (!status) {
+    if (status < 0) {
         fprintf(stderr, "Error: Failed to parse [Content_Types].xml\n");
         return -1;
     }
@@ -128,11 +178,11 @@ int parse_content_types(xlsx2csvConverter *conv)
 /* Workbook parsing state */
 typedef struct {
     xlsx2csvConverter *conv;
-    int                sheet_count;
-    int                current_sheet_idx;
+    int                capacity;
     bool               in_sheets;
     bool               in_sheet;
     bool               in_workbook_pr;
+    bool               failed; /* Out of memory */
     char              *current_name;
     char              *current_rid;
     char              *current_state;
@@ -146,7 +196,9 @@ static void workbook_start_element(void *userData, const XML_Char *name, const X
         state->in_sheets = true;
     } else if (strcmp(name, "sheet") == 0 && state->in_sheets) {
         state->in_sheet = true;
-        state->current_sheet_idx++;
+        free(state->current_name);
+        free(state->current_rid);
+        free(state->current_state);
         state->current_name  = NULL;
         state->current_rid   = NULL;
         state->current_state = NULL;
@@ -174,17 +226,26 @@ static void workbook_start_element(void *userData, const XML_Char *name, const X
 
 static void workbook_end_element(void *userData, const XML_Char *name)
 {
-    workbook_parse_state *state = (workbook_parse_state *)userData;
+    workbook_parse_state *state    = (workbook_parse_state *)userData;
+    workbookInfo         *workbook = &state->conv->workbook;
 
     if (strcmp(name, "sheets") == 0) {
         state->in_sheets = false;
     } else if (strcmp(name, "sheet") == 0 && state->in_sheet) {
-        if (state->current_sheet_idx > 0 && state->current_sheet_idx <= state->sheet_count) {
-            int idx                                       = state->current_sheet_idx - 1;
-            state->conv->workbook.sheets[idx].name        = state->current_name;
-            state->conv->workbook.sheets[idx].relation_id = state->current_rid;
-            state->conv->workbook.sheets[idx].state       = state->current_state;
-            state->conv->workbook.sheets[idx].index       = idx + 1;
+        sheetInfo *sheets = array_reserve(workbook->sheets, &state->capacity,
+                                          workbook->sheet_count + 1, sizeof(sheetInfo));
+        if (sheets) {
+            int idx                 = workbook->sheet_count++;
+            workbook->sheets        = sheets;
+            sheets[idx].name        = state->current_name;
+            sheets[idx].relation_id = state->current_rid;
+            sheets[idx].state       = state->current_state;
+            sheets[idx].index       = idx + 1;
+            state->current_name     = NULL;
+            state->current_rid      = NULL;
+            state->current_state    = NULL;
+        } else {
+            state->failed = true;
         }
         state->in_sheet = false;
     } else if (strcmp(name, "workbookPr") == 0) {
@@ -195,61 +256,33 @@ static void workbook_end_element(void *userData, const XML_Char *name)
 /* Parse Workbook XML */
 int parse_workbook(xlsx2csvConverter *conv)
 {
-    char *xml_data = zip_read_file_to_string(conv->zip_handle, "xl/workbook.xml");
+    size_t xml_len  = 0;
+    char  *xml_data =
+        zip_read_file_pooled(conv->zip_handle, "xl/workbook.xml", &conv->buffers, &xml_len);
     if (!xml_data) {
         fprintf(stderr, "Error: Could not read xl/workbook.xml\n");
         return -1;
     }
 
-    /* First pass: count sheets */
-    XML_Parser parser = XML_ParserCreate(NULL);
+    XML_Parser parser = metadata_parser(conv);
     if (!parser) {
-        free(xml_data);
-        return -1;
-    }
-
-    /* Count sheets by parsing again */
-    parser = XML_ParserCreate(NULL);
-    if (!parser) {
-        free(xml_data);
-        return -1;
-    }
-
-    int                  sheet_count = 0;
-    bool                 in_sheets   = false;
-    count_sheets_state_t count_state = {&sheet_count, &in_sheets};
-    XML_SetUserData(parser, &count_state);
-    XML_SetElementHandler(parser, count_sheets_start, count_sheets_end);
-    int status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
-    XML_ParserFree(parser);
-
-    if (!status) {
-        free(xml_data);
-        fprintf(stderr, "Error: Failed to parse xl/workbook.xml\n");
-        return -1;
-    }
-
-    /* Allocate sheet array */
-    conv->workbook.sheets      = calloc((size_t)sheet_count, sizeof(sheetInfo));
-    conv->workbook.sheet_count = sheet_count;
-
-    /* Second pass: parse sheets */
-    parser = XML_ParserCreate(NULL);
-    if (!parser) {
-        free(xml_data);
+        buffer_pool_release(&conv->buffers, xml_data);
         return -1;
     }
 
+    /* Sheets are appended as they are parsed */
     workbook_parse_state parse_state = {0};
     parse_state.conv                 = conv;
-    parse_state.sheet_count          = sheet_count;
     XML_SetUserData(parser, &parse_state);
     XML_SetElementHandler(parser, workbook_start_element, workbook_end_element);
-    status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
-    XML_ParserFree(parser);
-    free(xml_data);
+    int status = parse_xml_buffer(parser, xml_data, xml_len);
+    buffer_pool_release(&conv->buffers, xml_data);
 
-    if (!status) {
+    free(parse_state.current_name);
+    free(parse_state.current_rid);
+    free(parse_state.current_state);
+
+    if (status < 0 || parse_state.failed) {
         fprintf(stderr, "Error: Failed to parse xl/workbook.xml\n");
         return -1;
     }
@@ -259,32 +292,35 @@ int parse_workbook(xlsx2csvConverter *conv)
 
 /* Shared strings parsing state */
 typedef struct {
-    xlsx2csvConverter *conv;
-    int                string_idx;
-    bool               in_si;
-    bool               in_t;
-    char              *current_text;
-    size_t             text_len;
-    size_t             text_capacity;
+    sharedStringBuilder builder;
+    size_t              xml_len;
+    bool                in_si;
+    bool                in_t;
+    bool                in_rph; /* Phonetic runs are not part of the text */
 } shared_strings_state;
 
 static void shared_strings_start_element(void            *userData,
                                          const XML_Char  *name,
                                          const XML_Char **atts)
 {
-    (void)atts; /* Unused */
     shared_strings_state *state = (shared_strings_state *)userData;
 
     if (strcmp(name, "si") == 0) {
         state->in_si = true;
-        if (state->current_text) {
-            free(state->current_text);
-            state->current_text = NULL;
-        }
-        state->text_len      = 0;
-        state->text_capacity = 0;
-    } else if (strcmp(name, "t") == 0 && state->in_si) {
+        shared_string_builder_begin(&state->builder);
+    } else if (strcmp(name, "t") == 0 && state->in_si && !state->in_rph) {
         state->in_t = true;
+    } else if (strcmp(name, "rPh") == 0) {
+        state->in_rph = true;
+    } else if (strcmp(name, "sst") == 0) {
+        /* Presize from uniqueCount (or count); each <si></si> takes at least 9 bytes */
+        const XML_Char *count = NULL;
+        for (int i = 0; atts[i]; i += 2) {
+            if (strcmp(atts[i], "uniqueCount") == 0 || (!count && strcmp(atts[i], "count") == 0)) {
+                count = atts[i + 1];
+            }
+        }
+        shared_string_builder_expect(&state->builder, count_hint(count, state->xml_len, 9));
     }
 }
 
@@ -293,18 +329,12 @@ static void shared_strings_end_element(void *userData, const XML_Char *name)
     shared_strings_state *state = (shared_strings_state *)userData;
 
     if (strcmp(name, "si") == 0) {
-        if (state->string_idx < state->conv->shared_strings.count) {
-            if (state->current_text) {
-                state->conv->shared_strings.strings[state->string_idx] = state->current_text;
-                state->current_text                                    = NULL;
-            } else {
-                state->conv->shared_strings.strings[state->string_idx] = str_duplicate("");
-            }
-            state->string_idx++;
-        }
+        shared_string_builder_end(&state->builder);
         state->in_si = false;
     } else if (strcmp(name, "t") == 0) {
         state->in_t = false;
+    } else if (strcmp(name, "rPh") == 0) {
+        state->in_rph = false;
     }
 }
 
@@ -313,74 +343,77 @@ static void shared_strings_char_data(void *userData, const XML_Char *s, int len)
     shared_strings_state *state = (shared_strings_state *)userData;
 
     if (state->in_t && state->in_si) {
-        size_t new_len = state->text_len + (size_t)len;
-        if (new_len >= state->text_capacity) {
-            state->text_capacity = new_len + 256;
-            state->current_text  = realloc(state->current_text, state->text_capacity + 1);
-            if (!state->current_text) {
-                return;
-            }
-        }
-        memcpy(state->current_text + state->text_len, s, (size_t)len);
-        state->text_len              = new_len;
-        state->current_text[new_len] = '\0';
+        shared_string_builder_append(&state->builder, s, (size_t)len);
     }
 }
 
 /* Parse Shared Strings XML */
 int parse_shared_strings(xlsx2csvConverter *conv)
 {
-    char *xml_data = zip_read_file_to_string(conv->zip_handle, "xl/sharedStrings.xml");
-    if (!xml_data) {
+    const char   *filename = "xl/sharedStrings.xml";
+    size_t        limit    = (size_t)conv->options.sst_memory_mb * 1024 * 1024;
+    zipEntryInfo  info;
+    if (zip_file_stat(conv->zip_handle, filename, &info) < 0) {
         /* No shared strings is valid */
-        conv->shared_strings.strings = NULL;
-        conv->shared_strings.count   = 0;
+        memset(&conv->shared_strings, 0, sizeof(conv->shared_strings));
         return 0;
     }
 
-    /* First pass: count strings */
-    XML_Parser parser = XML_ParserCreate(NULL);
-    if (!parser) {
-        free(xml_data);
-        return -1;
+    /* With a memory limit the part is streamed and the table spills to disk;
+     * otherwise it is read whole, and lazy mode only indexes it if it can.
+     * The index keeps the part it was built on, so lazy mode reads it outside
+     * the buffer pool and hands that one copy over.
+     */
+    void  *file     = NULL;
+    size_t xml_len  = info.size;
+    char  *xml_data = NULL;
+    if (limit > 0) {
+        file = zip_file_open(conv->zip_handle, filename);
+    } else {
+        bufferPool *pool = conv->options.lazy_strings ? NULL : &conv->buffers;
+        xml_data         = zip_read_file_pooled(conv->zip_handle, filename, pool, &xml_len);
     }
-
-    int                   count       = 0;
-    bool                  in_si       = false;
-    count_strings_state_t count_state = {&count, &in_si};
-    XML_SetUserData(parser, &count_state);
-    XML_SetElementHandler(parser, count_strings_start, count_strings_end);
-    int status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
-    XML_ParserFree(parser);
-
-    if (!status) {
-        free(xml_data);
-        fprintf(stderr, "Error: Failed to parse xl/sharedStrings.xml\n");
-        return -1;
+    if (!file && !xml_data) {
+        memset(&conv->shared_strings, 0, sizeof(conv->shared_strings));
+        return 0;
     }
 
-    /* Allocate string array */
-    conv->shared_strings.strings = calloc((size_t)count, sizeof(char *));
-    conv->shared_strings.count   = count;
+    if (xml_data && conv->options.lazy_strings) {
+        conv->shared_strings.lazy = shared_string_index_create(xml_data, xml_len);
+        if (conv->shared_strings.lazy) {
+            conv->shared_strings.count = shared_string_index_count(conv->shared_strings.lazy);
+            return 0;
+        }
+    }
 
-    /* Second pass: parse strings */
-    parser = XML_ParserCreate(NULL);
+    XML_Parser parser = metadata_parser(conv);
     if (!parser) {
-        free(xml_data);
+        if (file) {
+            zip_file_close(file);
+        }
+        buffer_pool_release(&conv->buffers, xml_data);
         return -1;
     }
 
+    /* Strings are appended to the table as they are parsed */
     shared_strings_state state = {0};
-    state.conv                 = conv;
+    state.xml_len              = xml_len;
+    shared_string_builder_init(&state.builder, &conv->shared_strings, xml_len, limit);
     XML_SetUserData(parser, &state);
     XML_SetElementHandler(parser, shared_strings_start_element, shared_strings_end_element);
     XML_SetCharacterDataHandler(parser, shared_strings_char_data);
-    status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
-    XML_ParserFree(parser);
-    free(xml_data);
 
-    if (!status) {
-        fprintf(stderr, "Error: Failed to parse xl/sharedStrings.xml\n");
+    int status = 0;
+    if (file) {
+        status = parse_xml_stream(parser, file, &conv->buffers);
+        zip_file_close(file);
+    } else {
+        status = parse_xml_buffer(parser, xml_data, xml_len);
+        buffer_pool_release(&conv->buffers, xml_data);
+    }
+
+    if (shared_string_builder_finish(&state.builder) < 0 || status < 0) {
+        fprintf(stderr, "Error: Failed to parse %s\n", filename);
         return -1;
     }
 
@@ -390,24 +423,45 @@ int parse_shared_strings(xlsx2csvConverter *conv)
 /* Styles parsing state */
 typedef struct {
     xlsx2csvConverter *conv;
+    size_t             xml_len;
+    int                format_capacity;
+    int                xf_capacity;
     bool               in_num_fmts;
     bool               in_num_fmt;
     bool               in_cell_xfs;
     bool               in_xf;
-    int                format_idx;
-    int                xf_idx;
+    bool               failed; /* Out of memory */
     char              *current_format_code;
     char              *current_num_fmt_id;
     char              *current_num_fmt_code;
 } styles_state;
 
+/* Value of the count attribute, NULL if absent */
+static const XML_Char *count_attribute(const XML_Char **atts)
+{
+    for (int i = 0; atts[i]; i += 2) {
+        if (strcmp(atts[i], "count") == 0) {
+            return atts[i + 1];
+        }
+    }
+    return NULL;
+}
+
 static void styles_start_element(void *userData, const XML_Char *name, const XML_Char **atts)
 {
-    styles_state *state = (styles_state *)userData;
+    styles_state *state  = (styles_state *)userData;
+    styleInfo    *styles = &state->conv->styles;
 
     if (strcmp(name, "numFmts") == 0) {
         state->in_num_fmts = true;
-        /* Count formats first - we'll do this in a separate pass */
+        /* Presize from count; a <numFmt/> takes at least 10 bytes */
+        int        hint    = count_hint(count_attribute(atts), state->xml_len, 10);
+        numFormat *formats = hint > 0 ? array_reserve(styles->formats, &state->format_capacity,
+                                                      hint, sizeof(numFormat))
+                                      : NULL;
+        if (formats) {
+            styles->formats = formats;
+        }
     } else if (strcmp(name, "numFmt") == 0 && state->in_num_fmts) {
         state->in_num_fmt = true;
         free(state->current_num_fmt_id);
@@ -424,6 +478,14 @@ static void styles_start_element(void *userData, const XML_Char *name, const XML
         }
     } else if (strcmp(name, "cellXfs") == 0) {
         state->in_cell_xfs = true;
+        /* Presize from count; an <xf/> takes at least 5 bytes */
+        int  hint     = count_hint(count_attribute(atts), state->xml_len, 5);
+        int *cell_xfs = hint > 0 ? array_reserve(styles->cell_xfs, &state->xf_capacity, hint,
+                                                 sizeof(int))
+                                 : NULL;
+        if (cell_xfs) {
+            styles->cell_xfs = cell_xfs;
+        }
     } else if (strcmp(name, "xf") == 0 && state->in_cell_xfs) {
         state->in_xf = true;
         free(state->current_format_code);
@@ -439,31 +501,38 @@ static void styles_start_element(void *userData, const XML_Char *name, const XML
 
 static void styles_end_element(void *userData, const XML_Char *name)
 {
-    styles_state *state = (styles_state *)userData;
+    styles_state *state  = (styles_state *)userData;
+    styleInfo    *styles = &state->conv->styles;
 
     if (strcmp(name, "numFmts") == 0) {
         state->in_num_fmts = false;
     } else if (strcmp(name, "numFmt") == 0 && state->in_num_fmt) {
-        if (state->format_idx < state->conv->styles.format_count) {
+        numFormat *formats = array_reserve(styles->formats, &state->format_capacity,
+                                           styles->format_count + 1, sizeof(numFormat));
+        if (formats) {
+            numFormat *format = &formats[styles->format_count++];
+            styles->formats   = formats;
+            memset(format, 0, sizeof(*format));
             if (state->current_num_fmt_id) {
-                state->conv->styles.formats[state->format_idx].id = atoi(state->current_num_fmt_id);
-            }
-            if (state->current_num_fmt_code) {
-                state->conv->styles.formats[state->format_idx].format_code =
-                    state->current_num_fmt_code;
-                state->current_num_fmt_code = NULL;
+                format->id = atoi(state->current_num_fmt_id);
             }
-            state->format_idx++;
+            format->format_code         = state->current_num_fmt_code;
+            state->current_num_fmt_code = NULL;
+        } else {
+            state->failed = true;
         }
         state->in_num_fmt = false;
     } else if (strcmp(name, "cellXfs") == 0) {
         state->in_cell_xfs = false;
     } else if (strcmp(name, "xf") == 0 && state->in_xf) {
-        if (state->xf_idx < state->conv->styles.cell_xfs_count) {
-            if (state->current_format_code) {
-                state->conv->styles.cell_xfs[state->xf_idx] = atoi(state->current_format_code);
-            }
-            state->xf_idx++;
+        int *cell_xfs = array_reserve(styles->cell_xfs, &state->xf_capacity,
+                                      styles->cell_xfs_count + 1, sizeof(int));
+        if (cell_xfs) {
+            styles->cell_xfs                   = cell_xfs;
+            cell_xfs[styles->cell_xfs_count++] =
+                state->current_format_code ? atoi(state->current_format_code) : 0;
+        } else {
+            state->failed = true;
         }
         state->in_xf = false;
     }
@@ -472,73 +541,56 @@ static void styles_end_element(void *userData, const XML_Char *name)
 /* Parse Styles XML */
 int parse_styles(xlsx2csvConverter *conv)
 {
-    char *xml_data = zip_read_file_to_string(conv->zip_handle, "xl/styles.xml");
+    size_t xml_len  = 0;
+    char  *xml_data =
+        zip_read_file_pooled(conv->zip_handle, "xl/styles.xml", &conv->buffers, &xml_len);
     if (!xml_data) {
         /* No styles is valid */
         conv->styles.formats        = NULL;
         conv->styles.format_count   = 0;
         conv->styles.cell_xfs       = NULL;
         conv->styles.cell_xfs_count = 0;
+        conv->styles.cell_styles    = NULL;
         return 0;
     }
 
-    /* First pass: count formats and xfs */
-    XML_Parser parser = XML_ParserCreate(NULL);
-    if (!parser) {
-        free(xml_data);
-        return -1;
-    }
-
-    int  format_count = 0;
-    int  xf_count     = 0;
-    bool in_num_fmts  = false;
-    bool in_cell_xfs  = false;
-
-    count_styles_state_t count_state = {&format_count, &xf_count, &in_num_fmts, &in_cell_xfs};
-    XML_SetUserData(parser, &count_state);
-    XML_SetElementHandler(parser, count_styles_start, count_styles_end);
-    int status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
-    XML_ParserFree(parser);
-
-    if (!status) {
-        free(xml_data);
-        fprintf(stderr, "Error: Failed to parse xl/styles.xml\n");
-        return -1;
-    }
-
-    /* Allocate arrays */
-    conv->styles.formats        = calloc((size_t)format_count, sizeof(numFormat));
-    conv->styles.format_count   = format_count;
-    conv->styles.cell_xfs       = calloc((size_t)xf_count, sizeof(int));
-    conv->styles.cell_xfs_count = xf_count;
-
-    /* Second pass: parse formats and xfs */
-    parser = XML_ParserCreate(NULL);
+    XML_Parser parser = metadata_parser(conv);
     if (!parser) {
-        free(xml_data);
+        buffer_pool_release(&conv->buffers, xml_data);
         return -1;
     }
 
+    /* Formats and xfs are appended as they are parsed */
     styles_state state = {0};
     state.conv         = conv;
+    state.xml_len      = xml_len;
     XML_SetUserData(parser, &state);
     XML_SetElementHandler(parser, styles_start_element, styles_end_element);
-    status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
-    XML_ParserFree(parser);
-    free(xml_data);
+    int status = parse_xml_buffer(parser, xml_data, xml_len);
+    buffer_pool_release(&conv->buffers, xml_data);
+
+    free(state.current_format_code);
+    free(state.current_num_fmt_id);
+    free(state.current_num_fmt_code);
 
-    if (!status) {
+    if (status < 0 || state.failed) {
         fprintf(stderr, "Error: Failed to parse xl/styles.xml\n");
         return -1;
     }
 
-    return 0;
+    return styles_resolve(&conv->styles, conv->options.excel_formats);
 }
 
 /* Worksheet parsing state */
+/* A cell of the current row; text that is not stable is copied to row_text at offset */
+typedef struct {
+    cellText text;
+    size_t   offset;
+    bool     written; /* Listed in written_cols */
+} rowCell;
+
 typedef struct {
     xlsx2csvConverter *conv;
-    FILE              *outfile;
     csvWriter         *writer;
     int                global_max_col;
     int                last_row;
@@ -550,19 +602,374 @@ typedef struct {
     bool               in_t;
     int                current_row_num;
     bool               current_row_hidden;
-    char              *current_cell_ref;
-    char              *current_cell_type;
-    char              *current_cell_style;
+    int                current_cell_col;
+    cellType           current_cell_type;
+    int                current_cell_style; /* CELL_STYLE_NONE without an s attribute */
+    int                next_cell_col;      /* Column of a cell without an r attribute */
+    char               cell_buffer[CELL_TEXT_BUFFER_SIZE]; /* The current cell formatted */
     char              *current_cell_value;
     size_t             current_cell_value_len;
     size_t             current_cell_value_capacity;
     bool               in_inline_str;
     char              *current_dimension_ref;
-#define MAX_COLS 1024
-    char *cells[MAX_COLS];
-    int   max_col;
+    bool               await_first_row;    /* Row range: the first row sets the numbering */
+    int                first_row;          /* Row range: number of the first row, 0 if none */
+    bool               first_row_implicit; /* Row range: first row had no r attribute */
+    rowCell           *cells;              /* One slot per column, sized from <dimension> */
+    int               *written_cols;       /* Columns set in the current row, in order */
+    int                written_count;
+    int                cell_capacity;      /* Slots in cells and written_cols */
+    int                max_col;            /* Highest column set since the cells were cleared */
+    char              *row_text;           /* Texts of the current row that are not stable */
+    size_t             row_text_len;
+    size_t             row_text_capacity;  /* Grows to the longest row and is kept */
 } worksheet_state;
 
+/* Release what the worksheet state holds */
+static void worksheet_state_free(worksheet_state *state)
+{
+    csv_writer_free(state->writer);
+    free(state->current_dimension_ref);
+    free(state->current_cell_value);
+    free(state->cells);
+    free(state->written_cols);
+    free(state->row_text);
+}
+
+/* Last column Excel allows (XFD); references past it only need to stay past it */
+#define EXCEL_MAX_COLUMN 16383
+
+/* Column index from the letters of a cell reference such as "AB12", -1 without letters */
+static int cell_ref_column(const char *ref, size_t len)
+{
+    int column = 0;
+    for (size_t j = 0; j < len; j++) {
+        unsigned letter = ((unsigned char)ref[j] | 0x20u) - 'a'; /* Either case */
+        if (letter >= 26) {
+            break;
+        }
+        if (column <= EXCEL_MAX_COLUMN) {
+            column = column * 26 + (int)letter + 1;
+        }
+    }
+    return column - 1;
+}
+
+/* Cell type from the len bytes of a t attribute */
+static cellType cell_type_decode(const char *value, size_t len)
+{
+    if (len == 1) {
+        if (value[0] == 's') {
+            return CELL_TYPE_SHARED_STRING;
+        }
+        if (value[0] == 'n') {
+            return CELL_TYPE_NUMBER;
+        }
+        if (value[0] == 'b') {
+            return CELL_TYPE_BOOLEAN;
+        }
+    } else if (len == 3 && memcmp(value, "str", 3) == 0) {
+        return CELL_TYPE_STRING;
+    } else if (len == 9 && memcmp(value, "inlineStr", 9) == 0) {
+        return CELL_TYPE_INLINE_STRING;
+    }
+    return CELL_TYPE_OTHER;
+}
+
+/* Style id from the len bytes of an s attribute, read as atoi would.
+ * Negative and overflowing ids become INT_MAX, which is as out of range.
+ */
+static int cell_style_decode(const char *value, size_t len)
+{
+    size_t i = 0;
+    while (i < len && (value[i] == ' ' || (value[i] >= '\t' && value[i] <= '\r'))) {
+        i++;
+    }
+
+    bool negative = i < len && value[i] == '-';
+    if (i < len && (value[i] == '+' || value[i] == '-')) {
+        i++;
+    }
+
+    int id = 0;
+    for (; i < len && value[i] >= '0' && value[i] <= '9'; i++) {
+        if (id > (INT_MAX - 9) / 10) {
+            return INT_MAX;
+        }
+        id = id * 10 + (value[i] - '0');
+    }
+    return negative && id > 0 ? INT_MAX : id;
+}
+
+/* Empty the cells of the current row, touching only those that were set.
+ * The slots and the row text buffer are kept for the next row.
+ */
+static void worksheet_cells_clear(worksheet_state *state)
+{
+    for (int i = 0; i < state->written_count; i++) {
+        memset(&state->cells[state->written_cols[i]], 0, sizeof(rowCell));
+    }
+    state->written_count = 0;
+    state->max_col       = -1;
+    state->row_text_len  = 0;
+}
+
+/* Make room for columns 0 to col_index (at most EXCEL_MAX_COLUMN); -1 if out of memory */
+static int worksheet_cells_reserve(worksheet_state *state, int col_index)
+{
+    if (col_index < state->cell_capacity) {
+        return 0;
+    }
+
+    int capacity = state->cell_capacity ? state->cell_capacity : 64;
+    while (capacity <= col_index) {
+        capacity *= 2;
+    }
+    if (capacity > EXCEL_MAX_COLUMN + 1) {
+        capacity = EXCEL_MAX_COLUMN + 1;
+    }
+
+    rowCell *cells = realloc(state->cells, (size_t)capacity * sizeof(rowCell));
+    if (!cells) {
+        return -1;
+    }
+    state->cells = cells;
+    memset(cells + state->cell_capacity,
+           0,
+           (size_t)(capacity - state->cell_capacity) * sizeof(rowCell));
+
+    int *written_cols = realloc(state->written_cols, (size_t)capacity * sizeof(int));
+    if (!written_cols) {
+        return -1;
+    }
+    state->written_cols  = written_cols;
+    state->cell_capacity = capacity;
+    return 0;
+}
+
+/* Text of a cell of the current row */
+static const char *row_cell_data(const worksheet_state *state, const rowCell *cell)
+{
+    if (cell->text.stable || cell->text.len == 0) {
+        return cell->text.data;
+    }
+    return state->row_text + cell->offset;
+}
+
+/* Store a cell in its column, copying text that the next cell would overwrite */
+static void worksheet_cell_store(worksheet_state *state, int col_index, const cellText *text)
+{
+    if (col_index < 0 || col_index > EXCEL_MAX_COLUMN ||
+        worksheet_cells_reserve(state, col_index) < 0) {
+        return;
+    }
+
+    rowCell *cell = &state->cells[col_index];
+    if (!cell->written) {
+        cell->written                               = true;
+        state->written_cols[state->written_count++] = col_index;
+    }
+    cell->text   = *text;
+    cell->offset = 0;
+
+    if (!text->stable && text->len > 0) {
+        size_t needed = state->row_text_len + text->len;
+        if (needed > state->row_text_capacity) {
+            size_t capacity = state->row_text_capacity ? state->row_text_capacity : 4096;
+            while (capacity < needed) {
+                capacity *= 2;
+            }
+            char *row_text = realloc(state->row_text, capacity);
+            if (!row_text) {
+                cell->text = (cellText){0};
+                return;
+            }
+            state->row_text          = row_text;
+            state->row_text_capacity = capacity;
+        }
+        memcpy(state->row_text + state->row_text_len, text->data, text->len);
+        cell->offset = state->row_text_len;
+        state->row_text_len += text->len;
+    }
+
+    if (col_index > state->max_col) {
+        state->max_col = col_index;
+    }
+}
+
+/* Start a row: write the empty rows before it and clear the cells */
+static void worksheet_row_start(worksheet_state *state, int row_num, bool has_row_num, bool hidden)
+{
+    state->in_row             = true;
+    state->current_row_num    = has_row_num ? row_num : state->last_row + 1;
+    state->current_row_hidden = hidden;
+    state->next_cell_col      = 0;
+    worksheet_cells_clear(state);
+
+    /* A row range starts numbering at its first row; the caller writes the gap before it */
+    if (state->await_first_row) {
+        state->await_first_row    = false;
+        state->first_row          = state->current_row_num;
+        state->first_row_implicit = !has_row_num;
+        state->last_row           = state->current_row_num - 1;
+    }
+
+    /* Write empty rows if skip_empty_lines is false */
+    if (!state->conv->options.skip_empty_lines) {
+        csv_write_empty_rows(state->writer, state->current_row_num - state->last_row - 1);
+    }
+    state->last_row = state->current_row_num;
+}
+
+/* Finish a row: write it unless it is hidden, empty or suppressed */
+static void worksheet_row_end(worksheet_state *state)
+{
+    /* Check if row is hidden */
+    if (state->current_row_hidden && state->conv->options.skip_hidden_rows) {
+        /* Drop cells and skip */
+        worksheet_cells_clear(state);
+        state->in_row = false;
+        return;
+    }
+
+    /* Process row */
+    /* Check if row is empty */
+    bool is_empty = true;
+    for (int i = 0; i < state->written_count; i++) {
+        if (state->cells[state->written_cols[i]].text.len > 0) {
+            is_empty = false;
+            break;
+        }
+    }
+
+    /* Check for date format error */
+    if (state->conv->has_date_error) {
+        worksheet_cells_clear(state);
+        state->in_row = false;
+        return;
+    }
+
+    /* Write row if not empty or if we're not skipping empty lines */
+    if (!is_empty || !state->conv->options.skip_empty_lines) {
+        int output_max_col = state->max_col;
+        if (state->conv->options.skip_trailing_columns) {
+            output_max_col = -1;
+            for (int i = 0; i < state->written_count; i++) {
+                int col = state->written_cols[i];
+                if (state->cells[col].text.len > 0 && col > output_max_col) {
+                    output_max_col = col;
+                }
+            }
+        } else {
+            if (state->global_max_col > output_max_col) {
+                output_max_col = state->global_max_col;
+            }
+        }
+
+        csv_writer_reset_row(state->writer);
+        csv_writer_set_field_count(state->writer, output_max_col + 1);
+
+        /* Slots exist up to the last cell set; the dimension may ask for more columns.
+         * Runs of empty fields, up to the end of the row past the last cell, go out at once.
+         */
+        int last_cell = output_max_col < state->max_col ? output_max_col : state->max_col;
+        int col       = 0;
+        while (col <= output_max_col) {
+            int run_end = col;
+            while (run_end <= last_cell && state->cells[run_end].text.len == 0) {
+                run_end++;
+            }
+            if (run_end > last_cell) {
+                run_end = output_max_col + 1;
+            }
+            if (run_end > col) {
+                csv_write_empty_fields(state->writer, run_end - col);
+                col = run_end;
+                continue;
+            }
+
+            const rowCell *cell = &state->cells[col];
+            csv_write_field_as(state->writer,
+                               row_cell_data(state, cell),
+                               cell->text.len,
+                               cell->text.form);
+            col++;
+        }
+        csv_writer_end_row(state->writer);
+    }
+
+    worksheet_cells_clear(state);
+
+    state->in_row = false;
+}
+
+/* Start a cell; ref is its r attribute, or NULL to take the column after the last cell.
+ * The value buffer is kept for the next cell.
+ */
+static void worksheet_cell_start(worksheet_state *state,
+                                 const char      *ref,
+                                 size_t           ref_len,
+                                 cellType         type,
+                                 int              style_id)
+{
+    state->current_cell_col       = ref ? cell_ref_column(ref, ref_len) : state->next_cell_col;
+    state->current_cell_type      = type;
+    state->current_cell_style     = style_id;
+    state->next_cell_col          = state->current_cell_col + 1;
+    state->in_cell                = true;
+    state->current_cell_value_len = 0;
+    state->in_v                   = false;
+    state->in_is                  = false;
+    state->in_t                   = false;
+    state->in_inline_str          = false;
+}
+
+/* Append character data to the cell value */
+static void worksheet_cell_append(worksheet_state *state, const char *s, size_t len)
+{
+    size_t new_len = state->current_cell_value_len + len;
+    if (new_len >= state->current_cell_value_capacity) {
+        char *value = realloc(state->current_cell_value, new_len + 256 + 1);
+        if (!value) {
+            return;
+        }
+        state->current_cell_value          = value;
+        state->current_cell_value_capacity = new_len + 256;
+    }
+    memcpy(state->current_cell_value + state->current_cell_value_len, s, len);
+    state->current_cell_value_len      = new_len;
+    state->current_cell_value[new_len] = '\0';
+}
+
+/* Finish a cell: format its value and store it in its column */
+static void worksheet_cell_end(worksheet_state *state)
+{
+    int      col_index = state->current_cell_col;
+    cellType type      = state->current_cell_type;
+
+    /* Get cell value */
+    const char *cell_value = state->current_cell_value_len > 0 ? state->current_cell_value : NULL;
+    cellText    text       = {0};
+    if (type == CELL_TYPE_INLINE_STRING) {
+        /* inlineStr: value should be collected from <is><t>...</t></is> */
+        text.data = cell_value;
+        text.len  = cell_value ? state->current_cell_value_len : 0;
+    } else if (cell_value) {
+        format_cell_value(cell_value,
+                          type,
+                          state->current_cell_style,
+                          state->conv,
+                          state->cell_buffer,
+                          &text);
+    }
+
+    /* Store value in correct column */
+    worksheet_cell_store(state, col_index, &text);
+
+    state->current_cell_value_len = 0;
+    state->in_cell                = false;
+}
+
 static void worksheet_start_element(void *userData, const XML_Char *name, const XML_Char **atts)
 {
     worksheet_state *state = (worksheet_state *)userData;
@@ -574,69 +981,50 @@ static void worksheet_start_element(void *userData, const XML_Char *name, const
             if (strcmp(atts[i], "ref") == 0) {
                 free(state->current_dimension_ref);
                 state->current_dimension_ref = str_duplicate(atts[i + 1]);
-                /* Parse dimension to get max column */
+                /* Parse dimension to get max column, and size the row for it */
                 char *colon = strchr(state->current_dimension_ref, ':');
                 if (colon) {
-                    char col_name[10] = {0};
-                    int  j            = 0;
-                    for (char *p = colon + 1; *p && isalpha(*p); p++) {
-                        col_name[j++] = *p;
-                    }
-                    col_name[j]           = '\0';
-                    state->global_max_col = column_name_to_index(col_name);
+                    int max_col = cell_ref_column(colon + 1, strlen(colon + 1));
+                    state->global_max_col =
+                        max_col < EXCEL_MAX_COLUMN ? max_col : EXCEL_MAX_COLUMN;
+                    worksheet_cells_reserve(state, state->global_max_col);
                 }
             }
         }
     } else if (strcmp(name, "row") == 0 && state->in_sheet_data) {
-        state->in_row             = true;
-        state->current_row_num    = state->last_row + 1;
-        state->current_row_hidden = false;
-        state->max_col            = -1;
-        memset(state->cells, 0, sizeof(state->cells));
-
+        int  row_num     = 0;
+        bool has_row_num = false;
+        bool hidden      = false;
         for (int i = 0; atts[i]; i += 2) {
             if (strcmp(atts[i], "r") == 0) {
-                state->current_row_num = atoi(atts[i + 1]);
+                row_num     = atoi(atts[i + 1]);
+                has_row_num = true;
             } else if (strcmp(atts[i], "hidden") == 0) {
                 if (strcmp(atts[i + 1], "1") == 0 || strcmp(atts[i + 1], "true") == 0) {
-                    state->current_row_hidden = true;
+                    hidden = true;
                 }
             }
         }
-
-        /* Write empty rows if skip_empty_lines is false */
-        if (!state->conv->options.skip_empty_lines) {
-            for (int i = state->last_row + 1; i < state->current_row_num; i++) {
-                fputs(state->conv->options.lineterminator, state->outfile);
-            }
-        }
-        state->last_row = state->current_row_num;
+        worksheet_row_start(state, row_num, has_row_num, hidden);
     } else if (strcmp(name, "c") == 0 && state->in_row) {
-        state->in_cell = true;
-        free(state->current_cell_ref);
-        free(state->current_cell_type);
-        free(state->current_cell_style);
-        free(state->current_cell_value);
-        state->current_cell_ref            = NULL;
-        state->current_cell_type           = NULL;
-        state->current_cell_style          = NULL;
-        state->current_cell_value          = NULL;
-        state->current_cell_value_len      = 0;
-        state->current_cell_value_capacity = 0;
-        state->in_v                        = false;
-        state->in_is                       = false;
-        state->in_t                        = false;
-        state->in_inline_str               = false;
+        const char *ref   = NULL;
+        cellType    type  = CELL_TYPE_NONE;
+        int         style = CELL_STYLE_NONE;
 
         for (int i = 0; atts[i]; i += 2) {
-            if (strcmp(atts[i], "r") == 0) {
-                state->current_cell_ref = str_duplicate(atts[i + 1]);
-            } else if (strcmp(atts[i], "t") == 0) {
-                state->current_cell_type = str_duplicate(atts[i + 1]);
-            } else if (strcmp(atts[i], "s") == 0) {
-                state->current_cell_style = str_duplicate(atts[i + 1]);
+            const char *value = atts[i + 1];
+            if (atts[i][0] == '\0' || atts[i][1] != '\0') {
+                continue; /* r, t and s are all one letter */
+            }
+            if (atts[i][0] == 'r') {
+                ref = value;
+            } else if (atts[i][0] == 't') {
+                type = cell_type_decode(value, strlen(value));
+            } else if (atts[i][0] == 's') {
+                style = cell_style_decode(value, strlen(value));
             }
         }
+        worksheet_cell_start(state, ref, ref ? strlen(ref) : 0, type, style);
     } else if (strcmp(name, "v") == 0 && state->in_cell) {
         state->in_v = true;
     } else if (strcmp(name, "is") == 0 && state->in_cell) {
@@ -659,124 +1047,9 @@ static void worksheet_end_element(void *userData, const XML_Char *name)
     if (strcmp(name, "sheetData") == 0) {
         state->in_sheet_data = false;
     } else if (strcmp(name, "row") == 0 && state->in_row) {
-        /* Check if row is hidden */
-        if (state->current_row_hidden && state->conv->options.skip_hidden_rows) {
-            /* Free cells and skip */
-            for (int i = 0; i < MAX_COLS; i++) {
-                free(state->cells[i]);
-                state->cells[i] = NULL;
-            }
-            state->in_row = false;
-            return;
-        }
-
-        /* Process row */
-        /* Check if row is empty */
-        bool is_empty = true;
-        for (int i = 0; i <= state->max_col; i++) {
-            if (state->cells[i] && state->cells[i][0] != '\0') {
-                is_empty = false;
-                break;
-            }
-        }
-
-        /* Check for date format error */
-        if (state->conv->has_date_error) {
-            for (int i = 0; i < MAX_COLS; i++) {
-                free(state->cells[i]);
-                state->cells[i] = NULL;
-            }
-            state->in_row = false;
-            return;
-        }
-
-        /* Write row if not empty or if we're not skipping empty lines */
-        if (!is_empty || !state->conv->options.skip_empty_lines) {
-            int output_max_col = state->max_col;
-            if (state->conv->options.skip_trailing_columns) {
-                while (output_max_col >= 0 &&
-                       (!state->cells[output_max_col] || state->cells[output_max_col][0] == '\0')) {
-                    output_max_col--;
-                }
-            } else {
-                if (state->global_max_col > output_max_col) {
-                    output_max_col = state->global_max_col;
-                }
-            }
-
-            csv_writer_reset_row(state->writer);
-            csv_writer_set_field_count(state->writer, output_max_col + 1);
-
-            if (output_max_col >= 0) {
-                for (int i = 0; i <= output_max_col; i++) {
-                    csv_write_field(state->writer, state->cells[i] ? state->cells[i] : "");
-                }
-            }
-            fputs(state->conv->options.lineterminator, state->outfile);
-        }
-
-        /* Free cells */
-        for (int i = 0; i < MAX_COLS; i++) {
-            free(state->cells[i]);
-            state->cells[i] = NULL;
-        }
-
-        state->in_row = false;
+        worksheet_row_end(state);
     } else if (strcmp(name, "c") == 0 && state->in_cell) {
-        /* Extract column from reference */
-        int col_index = 0;
-        if (state->current_cell_ref) {
-            char col_name[10] = {0};
-            int  j            = 0;
-            for (const char *p = state->current_cell_ref; *p && isalpha(*p); p++) {
-                col_name[j++] = *p;
-            }
-            col_name[j] = '\0';
-            col_index   = column_name_to_index(col_name);
-        }
-
-        /* Get cell value */
-        char *value = NULL;
-        if (state->current_cell_type && strcmp(state->current_cell_type, "inlineStr") == 0) {
-            /* inlineStr: value should be collected from <is><t>...</t></is> */
-            if (state->current_cell_value) {
-                value = str_duplicate(state->current_cell_value);
-            } else {
-                value = str_duplicate("");
-            }
-        } else if (state->current_cell_value) {
-            value = format_cell_value(state->current_cell_value,
-                                      state->current_cell_type,
-                                      state->current_cell_style,
-                                      state->conv);
-        }
-
-        /* Store value in correct column */
-        if (col_index >= 0 && col_index < MAX_COLS) {
-            if (value) {
-                state->cells[col_index] = value;
-            } else {
-                state->cells[col_index] = str_duplicate("");
-            }
-            if (col_index > state->max_col) {
-                state->max_col = col_index;
-            }
-        } else if (value) {
-            free(value);
-        }
-
-        free(state->current_cell_ref);
-        free(state->current_cell_type);
-        free(state->current_cell_style);
-        free(state->current_cell_value);
-        state->current_cell_ref            = NULL;
-        state->current_cell_type           = NULL;
-        state->current_cell_style          = NULL;
-        state->current_cell_value          = NULL;
-        state->current_cell_value_len      = 0;
-        state->current_cell_value_capacity = 0;
-
-        state->in_cell = false;
+        worksheet_cell_end(state);
     } else if (strcmp(name, "v") == 0) {
         state->in_v = false;
     } else if (strcmp(name, "is") == 0) {
@@ -796,21 +1069,329 @@ static void worksheet_char_data(void *userData, const XML_Char *s, int len)
      * - If in <is><t> (inline string with <t> wrapper)
      */
     if ((state->in_v && state->in_cell) || (state->in_t && state->in_is && state->in_cell)) {
-        size_t new_len = state->current_cell_value_len + (size_t)len;
-        if (new_len >= state->current_cell_value_capacity) {
-            state->current_cell_value_capacity = new_len + 256;
-            state->current_cell_value =
-                realloc(state->current_cell_value, state->current_cell_value_capacity + 1);
-            if (!state->current_cell_value) {
-                return;
+        worksheet_cell_append(state, s, (size_t)len);
+    }
+}
+
+/* Copy a scanned attribute value into a NUL-terminated buffer (values are short) */
+static const char *scan_span_string(const scanSpan *span, char *buffer, size_t size)
+{
+    if (!span->data || span->len >= size) {
+        return NULL;
+    }
+    memcpy(buffer, span->data, span->len);
+    buffer[span->len] = '\0';
+    return buffer;
+}
+
+/* Apply one scanned row to the worksheet state, as the expat handlers would */
+static void worksheet_scanned_row(worksheet_state *state, const sheetScanner *scanner)
+{
+    for (size_t i = 0; i < scanner->count; i++) {
+        const scanEvent *event = &scanner->events[i];
+
+        switch (event->kind) {
+            case SCAN_ROW_START: {
+                char        number[32];
+                const char *r      = scan_span_string(&event->value, number, sizeof(number));
+                const char *hidden = event->hidden.data;
+                size_t      len    = event->hidden.len;
+                worksheet_row_start(state, r ? atoi(r) : 0, r != NULL,
+                                    hidden && ((len == 1 && hidden[0] == '1') ||
+                                               (len == 4 && memcmp(hidden, "true", 4) == 0)));
+                break;
             }
+            case SCAN_CELL_START:
+                worksheet_cell_start(
+                    state,
+                    event->value.data,
+                    event->value.len,
+                    event->type.data ? cell_type_decode(event->type.data, event->type.len)
+                                     : CELL_TYPE_NONE,
+                    event->style.data ? cell_style_decode(event->style.data, event->style.len)
+                                      : CELL_STYLE_NONE);
+                break;
+            case SCAN_TEXT:
+                if (!event->escaped) {
+                    worksheet_cell_append(state, event->value.data, event->value.len);
+                } else {
+                    /* Decode straight into the value buffer; references only get shorter */
+                    size_t old_len = state->current_cell_value_len;
+                    worksheet_cell_append(state, event->value.data, event->value.len);
+                    if (state->current_cell_value_len == old_len + event->value.len) {
+                        char  *text = state->current_cell_value + old_len;
+                        size_t len  = sheet_scanner_unescape(text, event->value.len, text);
+                        state->current_cell_value_len = old_len + len;
+                        text[len]                     = '\0';
+                    }
+                }
+                break;
+            case SCAN_CELL_END:
+                worksheet_cell_end(state);
+                break;
+            case SCAN_ROW_END:
+                worksheet_row_end(state);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Scan rows from data while they fit the scanner's grammar; returns the bytes consumed.
+ * *done is set once the rest has to go to expat (end of sheetData or unusual markup),
+ * otherwise the last row continues past the end of the data.
+ */
+static size_t scan_worksheet_rows(worksheet_state *state,
+                                  sheetScanner    *scanner,
+                                  const char      *data,
+                                  size_t           len,
+                                  bool            *done)
+{
+    size_t pos = 0;
+
+    while (1) {
+        size_t     consumed;
+        scanResult result = sheet_scanner_next_row(scanner, data + pos, len - pos, &consumed);
+        pos += consumed;
+        if (result != SCAN_ROW) {
+            *done = result != SCAN_MORE;
+            return pos;
         }
-        memcpy(state->current_cell_value + state->current_cell_value_len, s, (size_t)len);
-        state->current_cell_value_len      = new_len;
-        state->current_cell_value[new_len] = '\0';
+        worksheet_scanned_row(state, scanner);
     }
 }
 
+/* Feed rows that follow a prologue expat has already parsed, without finishing.
+ * With scan set the pull scanner takes the rows while it can and expat gets
+ * the rest, starting at the first row the scanner leaves alone.
+ */
+static int parse_rows_partial(XML_Parser       parser,
+                              worksheet_state *state,
+                              bool             scan,
+                              const char      *rows,
+                              size_t           len)
+{
+    size_t used = 0;
+
+    if (scan && state->in_sheet_data && !state->in_row) {
+        sheetScanner scanner;
+        bool         done;
+        sheet_scanner_init(&scanner);
+        used = scan_worksheet_rows(state, &scanner, rows, len, &done);
+        sheet_scanner_free(&scanner);
+    }
+
+    return parse_xml_partial(parser, rows + used, len - used);
+}
+
+/* Parse a worksheet held in memory (mapped or inflated) without copying it first */
+static int parse_worksheet_mapped(XML_Parser       parser,
+                                  worksheet_state *state,
+                                  const char      *data,
+                                  size_t           size)
+{
+    size_t rows = state->conv->options.fast_scanner ? sheet_scanner_rows_start(data, size) : 0;
+    bool   scan = rows > 0 && sheet_scanner_prologue_ok(data, rows);
+
+    if (parse_xml_partial(parser, data, rows) < 0 ||
+        parse_rows_partial(parser, state, scan, data + rows, size - rows) < 0 ||
+        XML_Parse(parser, NULL, 0, 1) == XML_STATUS_ERROR) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Stream a worksheet through the pull scanner.
+ * Unlike parse_xml_stream() a row can straddle two reads, so unconsumed bytes
+ * are carried over in a buffer that grows to hold the longest row.
+ */
+static int parse_worksheet_scanned(XML_Parser parser, worksheet_state *state, void *file)
+{
+    enum { FIND_ROWS, SCAN_ROWS, EXPAT_ONLY } mode = FIND_ROWS;
+
+    sheetScanner scanner;
+    size_t       capacity = 2 * XML_STREAM_CHUNK_SIZE;
+    size_t       len      = 0;
+    char        *buffer   = malloc(capacity);
+    int          status   = buffer ? 0 : -1;
+
+    sheet_scanner_init(&scanner);
+    while (status == 0) {
+        if (capacity - len < XML_STREAM_CHUNK_SIZE) {
+            char *new_buffer = realloc(buffer, capacity * 2);
+            if (!new_buffer) {
+                status = -1;
+                break;
+            }
+            buffer = new_buffer;
+            capacity *= 2;
+        }
+
+        int read_size = zip_file_read(file, buffer + len, XML_STREAM_CHUNK_SIZE);
+        if (read_size < 0) {
+            status = -1;
+            break;
+        }
+        len += (size_t)read_size;
+
+        bool   is_final = (read_size == 0);
+        size_t used     = 0;
+
+        /* The prologue (up to the <sheetData> start tag) always goes to expat */
+        if (mode == FIND_ROWS) {
+            size_t rows = sheet_scanner_rows_start(buffer, len);
+            if (rows > 0) {
+                if (parse_xml_partial(parser, buffer, rows) < 0) {
+                    status = -1;
+                    break;
+                }
+                used = rows;
+                mode = sheet_scanner_prologue_ok(buffer, rows) && state->in_sheet_data &&
+                               !state->in_row
+                           ? SCAN_ROWS
+                           : EXPAT_ONLY;
+            } else if (is_final || len > XML_PROLOGUE_LIMIT) {
+                mode = EXPAT_ONLY;
+            }
+        }
+
+        if (mode == SCAN_ROWS) {
+            bool done = false;
+            used += scan_worksheet_rows(state, &scanner, buffer + used, len - used, &done);
+            if (done || is_final) {
+                mode = EXPAT_ONLY;
+            }
+        }
+
+        if (mode == EXPAT_ONLY) {
+            if (parse_xml_partial(parser, buffer + used, len - used) < 0) {
+                status = -1;
+                break;
+            }
+            used = len;
+        }
+
+        memmove(buffer, buffer + used, len - used);
+        len -= used;
+
+        if (is_final) {
+            if (XML_Parse(parser, NULL, 0, 1) == XML_STATUS_ERROR) {
+                status = -1;
+            }
+            break;
+        }
+    }
+
+    sheet_scanner_free(&scanner);
+    free(buffer);
+    return status;
+}
+
+/* Parse one run of complete <row> elements of a worksheet.
+ * The worksheet prologue (everything up to and including the <sheetData> start
+ * tag) is parsed first so that the rows see the same document context and
+ * <dimension> as in a full parse. With last_row < 0 the numbering starts at
+ * the first row and no empty rows are written before it; otherwise parsing
+ * continues exactly as if the previous rows ended at last_row.
+ */
+int parse_worksheet_rows(xlsx2csvConverter *conv,
+                         FILE              *outfile,
+                         const char        *prologue,
+                         size_t             prologue_len,
+                         const char        *rows,
+                         size_t             rows_len,
+                         int                last_row,
+                         worksheetRange    *range)
+{
+    static const char sheet_data_end[] = "</sheetData>";
+
+    XML_Parser parser = XML_ParserCreate(NULL);
+    if (!parser) {
+        return -1;
+    }
+
+    worksheet_state state = {0};
+    state.conv            = conv;
+    state.writer          = csv_writer_create(outfile, &conv->options);
+    state.last_row        = last_row < 0 ? 0 : last_row;
+    state.global_max_col  = -1;
+    state.await_first_row = last_row < 0;
+
+    if (!state.writer) {
+        XML_ParserFree(parser);
+        return -1;
+    }
+
+    XML_SetUserData(parser, &state);
+    XML_SetElementHandler(parser, worksheet_start_element, worksheet_end_element);
+    XML_SetCharacterDataHandler(parser, worksheet_char_data);
+
+    /* The document is left unfinished; only errors inside the fed data matter */
+    int  status = 0;
+    bool scan   = conv->options.fast_scanner && sheet_scanner_prologue_ok(prologue, prologue_len);
+    if (parse_xml_partial(parser, prologue, prologue_len) < 0 ||
+        parse_rows_partial(parser, &state, scan, rows, rows_len) < 0 ||
+        XML_Parse(parser, sheet_data_end, (int)strlen(sheet_data_end), 0) == XML_STATUS_ERROR) {
+        status = -1;
+    }
+    XML_ParserFree(parser);
+
+    if (csv_writer_flush(state.writer) < 0) {
+        status = -1;
+    }
+    worksheet_state_free(&state);
+
+    range->first_row          = state.await_first_row ? 0 : state.first_row;
+    range->last_row           = state.last_row;
+    range->first_row_implicit = state.first_row_implicit;
+
+    return status;
+}
+
+/* Checkpoint index path for a worksheet; -1 if indexing is off or there is nowhere to put it
+ * An index directory alone keeps the indexes --jobs builds for large sheets
+ */
+static int worksheet_index_path(xlsx2csvConverter *conv, int sheet_index, char *path, size_t size)
+{
+    bool keep_parallel = conv->options.jobs > 1 && conv->options.index_dir;
+    if (conv->options.index_span_mb <= 0 && !keep_parallel) {
+        return -1;
+    }
+
+    bool        from_stdin = strcmp(conv->filename, "-") == 0;
+    const char *base       = from_stdin ? "stdin" : conv->filename;
+    int         written;
+
+    if (conv->options.index_dir) {
+        const char *slash = strrchr(base, '/');
+        written           = snprintf(path, size, "%s/%s.sheet%d.idx", conv->options.index_dir,
+                                     slash ? slash + 1 : base, sheet_index);
+    } else if (!from_stdin) {
+        written = snprintf(path, size, "%s.sheet%d.idx", base, sheet_index);
+    } else {
+        return -1;
+    }
+
+    return (written > 0 && (size_t)written < size) ? 0 : -1;
+}
+
+/* Start building an index for a deflated worksheet unless a valid one already exists */
+static inflateIndex *worksheet_index_begin(xlsx2csvConverter  *conv,
+                                           const zipEntryInfo *info,
+                                           const char         *path)
+{
+    inflateIndex *existing = inflate_index_load(path, info->size, info->comp_size, info->crc32);
+    if (existing) {
+        inflate_index_free(existing);
+        return NULL;
+    }
+
+    uint64_t span = (uint64_t)conv->options.index_span_mb * 1024 * 1024;
+    return inflate_index_create(span, info->size, info->comp_size, info->crc32);
+}
+
 /* Parse worksheet and convert to CSV */
 int parse_worksheet(xlsx2csvConverter *conv, int sheet_index, FILE *outfile)
 {
@@ -821,29 +1402,74 @@ int parse_worksheet(xlsx2csvConverter *conv, int sheet_index, FILE *outfile)
     /* Build worksheet filename */
     char filename[256];
     snprintf(filename, sizeof(filename), "xl/worksheets/sheet%d.xml", sheet_index);
+    char index_path[1024];
+    bool have_index_path =
+        worksheet_index_path(conv, sheet_index, index_path, sizeof(index_path)) == 0;
+
+    /* Large sheets can be split into row ranges parsed by worker threads */
+    if (conv->options.jobs > 1 && !conv->has_date_error) {
+        int status = parse_worksheet_parallel(conv, filename, have_index_path ? index_path : NULL,
+                                              outfile);
+        if (status < 0) {
+            fprintf(stderr, "Error: Failed to parse %s\n", filename);
+            return -1;
+        }
+        if (status == 0) {
+            return 0;
+        }
+    }
 
-    char *xml_data = zip_read_file_to_string(conv->zip_handle, filename);
-    if (!xml_data) {
-        fprintf(stderr, "Error: Could not read %s\n", filename);
-        return -1;
+    /* Stored entries are parsed in place, moderately sized compressed ones are
+     * inflated in one shot, and the rest are inflated in chunks
+     */
+    size_t        mapped_size = 0;
+    const char   *mapped      = zip_file_map(conv->zip_handle, filename, &mapped_size);
+    char         *inflated    = NULL;
+    void         *file        = NULL;
+    inflateIndex *index       = NULL;
+    zipEntryInfo  info;
+    bool          have_info = !mapped && zip_file_stat(conv->zip_handle, filename, &info) == 0;
+
+    /* A requested checkpoint index that does not exist yet is built while streaming */
+    if (have_info && have_index_path && conv->options.index_span_mb > 0) {
+        index = worksheet_index_begin(conv, &info, index_path);
+    }
+    if (have_info && !index && info.size <= XML_INFLATE_WHOLE_LIMIT) {
+        inflated = zip_file_inflate(conv->zip_handle, filename, &conv->buffers, &mapped_size);
+        mapped   = inflated;
+    }
+    if (!mapped) {
+        file = zip_file_open(conv->zip_handle, filename);
+        if (!file) {
+            fprintf(stderr, "Error: Could not read %s\n", filename);
+            inflate_index_free(index);
+            return -1;
+        }
+        if (index && zip_file_build_index(file, index) < 0) {
+            inflate_index_free(index);
+            index = NULL;
+        }
     }
 
     XML_Parser parser = XML_ParserCreate(NULL);
     if (!parser) {
-        free(xml_data);
+        zip_file_close(file);
+        buffer_pool_release(&conv->buffers, inflated);
+        inflate_index_free(index);
         return -1;
     }
 
     worksheet_state state = {0};
     state.conv            = conv;
-    state.outfile         = outfile;
     state.writer          = csv_writer_create(outfile, &conv->options);
     state.last_row        = 0;
     state.global_max_col  = -1;
 
     if (!state.writer) {
         XML_ParserFree(parser);
-        free(xml_data);
+        zip_file_close(file);
+        buffer_pool_release(&conv->buffers, inflated);
+        inflate_index_free(index);
         return -1;
     }
 
@@ -851,22 +1477,34 @@ int parse_worksheet(xlsx2csvConverter *conv, int sheet_index, FILE *outfile)
     XML_SetElementHandler(parser, worksheet_start_element, worksheet_end_element);
     XML_SetCharacterDataHandler(parser, worksheet_char_data);
 
-    int status = XML_Parse(parser, xml_data, (int)strlen(xml_data), 1);
+    int status;
+    if (mapped) {
+        status = parse_worksheet_mapped(parser, &state, mapped, mapped_size);
+    } else if (conv->options.fast_scanner) {
+        status = parse_worksheet_scanned(parser, &state, file);
+    } else {
+        status = parse_xml_stream(parser, file, &conv->buffers);
+    }
     XML_ParserFree(parser);
-    free(xml_data);
+    zip_file_close(file);
+    buffer_pool_release(&conv->buffers, inflated);
 
-    csv_writer_free(state.writer);
+    if (status == 0 && index && index->complete && inflate_index_save(index, index_path) < 0) {
+        fprintf(stderr, "Warning: Could not write inflate index %s\n", index_path);
+    }
+    inflate_index_free(index);
 
-    free(state.current_dimension_ref);
-    free(state.current_cell_ref);
-    free(state.current_cell_type);
-    free(state.current_cell_style);
-    free(state.current_cell_value);
+    int written = csv_writer_flush(state.writer);
+    worksheet_state_free(&state);
 
-    if (!status) {
+    if (status < 0) {
         fprintf(stderr, "Error: Failed to parse %s\n", filename);
         return -1;
     }
+    if (written < 0) {
+        fprintf(stderr, "Error: Could not write the CSV output\n");
+        return -1;
+    }
 
     return 0;
 }
@@ -1,15 +1,36 @@
 #ifndef _XML_PARSER_H
 #define _XML_PARSER_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
 #include "xlsx2csv.h"
 
+/* Largest worksheet inflated in one shot; bigger ones stream to bound memory */
+#define XML_INFLATE_WHOLE_LIMIT (64 * 1024 * 1024)
+
+/* Row numbers seen while parsing a run of rows */
+typedef struct {
+    int  first_row;          /* 0 if the run held no rows */
+    int  last_row;
+    bool first_row_implicit; /* First row had no r attribute (numbering depends on earlier rows) */
+} worksheetRange;
+
 /* XML parser functions */
-int parse_content_types(xlsx2csvConverter *conv);
-int parse_workbook(xlsx2csvConverter *conv);
-int parse_shared_strings(xlsx2csvConverter *conv);
-int parse_styles(xlsx2csvConverter *conv);
-int parse_worksheet(xlsx2csvConverter *conv, int sheet_index, FILE *outfile);
+int  parse_content_types(xlsx2csvConverter *conv);
+int  parse_workbook(xlsx2csvConverter *conv);
+int  parse_shared_strings(xlsx2csvConverter *conv);
+int  parse_styles(xlsx2csvConverter *conv);
+void metadata_parser_free(xlsx2csvConverter *conv);
+int  parse_worksheet(xlsx2csvConverter *conv, int sheet_index, FILE *outfile);
+int  parse_worksheet_rows(xlsx2csvConverter *conv,
+                          FILE              *outfile,
+                          const char        *prologue,
+                          size_t             prologue_len,
+                          const char        *rows,
+                          size_t             rows_len,
+                          int                last_row,
+                          worksheetRange    *range);
 
 #endif /* _XML_PARSER_H */
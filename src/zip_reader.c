@@ -1,18 +1,533 @@
+/* O_TMPFILE */
+#define _GNU_SOURCE
+
 /* Standard library headers */
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /* Third-party library headers */
 #include <zip.h>
+#include <zlib.h>
 
 /* Project headers */
+#include "inflate_backend.h"
+#include "utils.h"
 #include "zip_reader.h"
 
+/* ZIP record signatures */
+#define ZIP_SIG_LOCAL_HEADER    0x04034b50u
+#define ZIP_SIG_CENTRAL_HEADER  0x02014b50u
+#define ZIP_SIG_EOCD            0x06054b50u
+#define ZIP_SIG_EOCD64_LOCATOR  0x07064b50u
+#define ZIP_SIG_EOCD64          0x06064b50u
+#define ZIP_SIG_DATA_DESCRIPTOR 0x08074b50u
+
+/* Fixed record sizes */
+#define ZIP_LOCAL_HEADER_SIZE   30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_EOCD_SIZE           22
+#define ZIP_EOCD64_LOCATOR_SIZE 20
+#define ZIP_EOCD64_SIZE         56
+
+/* Bytes read from stdin at a time */
+#define ZIP_SPOOL_CHUNK_SIZE (64 * 1024)
+
+/* Largest chunk handed to zlib at once (avail_in/avail_out are 32-bit) */
+#define ZIP_INFLATE_MAX_CHUNK (1u << 30)
+
+/* Entry buffers are allocated up front for at most the recorded size, what the
+ * compressed data can expand to (deflate: 1032 bytes per input byte) and a
+ * fixed ceiling; anything beyond grows as the data arrives
+ */
+#define ZIP_DEFLATE_MAX_RATIO    1032
+#define ZIP_ENTRY_PREALLOC_LIMIT ((size_t)1 << 30)
+#define ZIP_ENTRY_MIN_BUFFER     (64 * 1024)
+
+/* Backend an archive was opened with */
+typedef enum {
+    ZIP_BACKEND_LIBZIP,
+    ZIP_BACKEND_MMAP
+} zipBackend;
+
+/* Indexed ZIP entry (name is normalized: lowercase, no leading slash) */
+typedef struct {
+    char                *name;
+    uint32_t             hash;
+    zip_uint64_t         index;        /* libzip backend: entry index */
+    uint64_t             local_offset; /* mmap backend: offset of the local file header */
+    const unsigned char *data;         /* Streamed archives: entry data (memory or spool file) */
+    zipEntryInfo         info;
+} zipEntry;
+
+/* Opened archive with a case-insensitive hash index of its entries */
+typedef struct {
+    zipBackend            backend;
+    zip_t                *za;       /* libzip backend */
+    const unsigned char  *map;      /* Mapped archive, or the spool file of a streamed one */
+    size_t                map_size;
+    unsigned char        *memory;   /* Streamed archives: metadata parts kept in memory */
+    zipEntry             *entries;
+    size_t                entry_count;
+    size_t               *slots; /* Open addressing table of entry index + 1 (0 = empty) */
+    size_t                slot_mask;
+    const inflateBackend *inflater; /* One-shot decoder for mapped deflated entries */
+    inflateStats          stats;
+    pthread_mutex_t       stats_lock; /* Entries may be read from several threads */
+} zipArchive;
+
+/* Open entry reader */
+typedef struct {
+    zip_file_t          *zf;       /* libzip backend */
+    const unsigned char *next_in;  /* mmap backend: unread entry bytes */
+    size_t               avail_in;
+    bool                 deflated;
+    bool                 finished;
+    z_stream             strm;
+    inflateIndex        *index;    /* Checkpoint index being built, if any */
+    zipArchive          *archive;
+    bool                 counted;  /* Compressed: stats are merged into the archive on close */
+    inflateStats         stats;
+} zipFile;
+
+/* Little-endian field readers */
+static uint16_t read_u16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_u64(const unsigned char *p)
+{
+    return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+/* FNV-1a hash of a normalized entry name */
+static uint32_t entry_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash ^= (uint32_t)tolower(*p);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Normalize entry name for lookup: drop leading slash and fold case */
+static char *normalize_entry_name(const char *name, size_t len)
+{
+    if (len > 0 && name[0] == '/') {
+        name++;
+        len--;
+    }
+
+    char *normalized = malloc(len + 1);
+    if (!normalized) {
+        return NULL;
+    }
+    for (size_t i = 0; i < len; i++) {
+        normalized[i] = (char)tolower((unsigned char)name[i]);
+    }
+    normalized[len] = '\0';
+
+    return normalized;
+}
+
+/* Find entry by name, or NULL if archive has no such entry */
+static zipEntry *find_entry(zipArchive *archive, const char *filename)
+{
+    if (archive->entry_count == 0) {
+        return NULL;
+    }
+
+    if (filename[0] == '/') {
+        filename++;
+    }
+
+    uint32_t hash = entry_name_hash(filename);
+    for (size_t slot = hash & archive->slot_mask;; slot = (slot + 1) & archive->slot_mask) {
+        size_t ref = archive->slots[slot];
+        if (ref == 0) {
+            return NULL;
+        }
+        zipEntry *entry = &archive->entries[ref - 1];
+        if (entry->hash == hash && strcasecmp(entry->name, filename) == 0) {
+            return entry;
+        }
+    }
+}
+
+/* Free archive wrapper and its index (does not close the underlying archive) */
+static void archive_free(zipArchive *archive)
+{
+    for (size_t i = 0; i < archive->entry_count; i++) {
+        free(archive->entries[i].name);
+    }
+    free(archive->entries);
+    free(archive->slots);
+    free(archive->memory);
+    pthread_mutex_destroy(&archive->stats_lock);
+    free(archive);
+}
+
+/* Merge a reader's decompression counters into the archive totals */
+static void archive_add_stats(zipArchive *archive, const inflateStats *stats)
+{
+    pthread_mutex_lock(&archive->stats_lock);
+    inflate_stats_add(&archive->stats, stats);
+    pthread_mutex_unlock(&archive->stats_lock);
+}
+
+/* Allocate index storage for up to max_entries entries */
+static int archive_alloc_index(zipArchive *archive, size_t max_entries)
+{
+    if (max_entries == 0) {
+        return 0;
+    }
+
+    /* Keep load factor at or below 1/2 */
+    size_t slot_count = 16;
+    while (slot_count < max_entries * 2) {
+        slot_count *= 2;
+    }
+
+    archive->entries   = calloc(max_entries, sizeof(zipEntry));
+    archive->slots     = calloc(slot_count, sizeof(size_t));
+    archive->slot_mask = slot_count - 1;
+    if (!archive->entries || !archive->slots) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Add entry to the index; returns NULL if a same-named entry already exists */
+static zipEntry *archive_add_entry(zipArchive *archive, const char *name, size_t name_len)
+{
+    char *normalized = normalize_entry_name(name, name_len);
+    if (!normalized) {
+        return NULL;
+    }
+
+    /* First entry wins on duplicate names, matching a front-to-back scan */
+    if (find_entry(archive, normalized)) {
+        free(normalized);
+        return NULL;
+    }
+
+    zipEntry *entry = &archive->entries[archive->entry_count];
+    entry->name     = normalized;
+    entry->hash     = entry_name_hash(normalized);
+
+    size_t slot = entry->hash & archive->slot_mask;
+    while (archive->slots[slot] != 0) {
+        slot = (slot + 1) & archive->slot_mask;
+    }
+    archive->slots[slot] = ++archive->entry_count;
+
+    return entry;
+}
+
+/* Wrap libzip handle and build the entry index once */
+static zipArchive *archive_create(zip_t *za)
+{
+    zipArchive *archive = calloc(1, sizeof(zipArchive));
+    if (!archive) {
+        return NULL;
+    }
+    archive->backend  = ZIP_BACKEND_LIBZIP;
+    archive->za       = za;
+    archive->inflater = inflate_backend_find(NULL);
+    pthread_mutex_init(&archive->stats_lock, NULL);
+
+    zip_int64_t num_entries = zip_get_num_entries(za, 0);
+    if (num_entries <= 0) {
+        return archive;
+    }
+
+    if (archive_alloc_index(archive, (size_t)num_entries) < 0) {
+        archive_free(archive);
+        return NULL;
+    }
+
+    for (zip_int64_t i = 0; i < num_entries; i++) {
+        zip_stat_t st;
+        if (zip_stat_index(za, (zip_uint64_t)i, 0, &st) != 0 || !(st.valid & ZIP_STAT_NAME)) {
+            continue;
+        }
+
+        zipEntry *entry = archive_add_entry(archive, st.name, strlen(st.name));
+        if (!entry) {
+            continue;
+        }
+
+        entry->index            = (zip_uint64_t)i;
+        entry->info.size        = (st.valid & ZIP_STAT_SIZE) ? (size_t)st.size : 0;
+        entry->info.comp_size   = (st.valid & ZIP_STAT_COMP_SIZE) ? (size_t)st.comp_size : 0;
+        entry->info.comp_method = (st.valid & ZIP_STAT_COMP_METHOD) ? st.comp_method : -1;
+        entry->info.crc32       = (st.valid & ZIP_STAT_CRC) ? st.crc : 0;
+    }
+
+    return archive;
+}
+
+/* Locate the central directory from the (Zip64) end of central directory record */
+static int find_central_directory(const unsigned char *map,
+                                  size_t               map_size,
+                                  uint64_t            *cd_offset,
+                                  uint64_t            *cd_size,
+                                  uint64_t            *entry_count)
+{
+    if (map_size < ZIP_EOCD_SIZE) {
+        return -1;
+    }
+
+    /* EOCD is followed by a comment of at most 65535 bytes */
+    size_t eocd  = map_size - ZIP_EOCD_SIZE;
+    size_t limit = map_size > ZIP_EOCD_SIZE + 0xFFFF ? map_size - ZIP_EOCD_SIZE - 0xFFFF : 0;
+    while (read_u32(map + eocd) != ZIP_SIG_EOCD) {
+        if (eocd == limit) {
+            return -1;
+        }
+        eocd--;
+    }
+
+    *entry_count = read_u16(map + eocd + 10);
+    *cd_size     = read_u32(map + eocd + 12);
+    *cd_offset   = read_u32(map + eocd + 16);
+
+    /* Zip64: sizes that overflow 16/32 bits live in the Zip64 EOCD record */
+    if (*entry_count == 0xFFFF || *cd_size == 0xFFFFFFFF || *cd_offset == 0xFFFFFFFF) {
+        if (eocd < ZIP_EOCD64_LOCATOR_SIZE) {
+            return -1;
+        }
+        const unsigned char *locator = map + eocd - ZIP_EOCD64_LOCATOR_SIZE;
+        if (read_u32(locator) != ZIP_SIG_EOCD64_LOCATOR) {
+            return -1;
+        }
+        /* The Zip64 EOCD record must end before its locator */
+        size_t   record_end = eocd - ZIP_EOCD64_LOCATOR_SIZE;
+        uint64_t eocd64     = read_u64(locator + 8);
+        if (record_end < ZIP_EOCD64_SIZE || eocd64 > record_end - ZIP_EOCD64_SIZE ||
+            read_u32(map + eocd64) != ZIP_SIG_EOCD64) {
+            return -1;
+        }
+        *entry_count = read_u64(map + eocd64 + 32);
+        *cd_size     = read_u64(map + eocd64 + 40);
+        *cd_offset   = read_u64(map + eocd64 + 48);
+    }
+
+    if (*cd_offset > map_size || *cd_size > map_size - *cd_offset) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Build the entry index from the central directory of a mapped archive */
+static int index_central_directory(zipArchive *archive)
+{
+    const unsigned char *map = archive->map;
+    uint64_t             cd_offset, cd_size, entry_count;
+
+    if (find_central_directory(map, archive->map_size, &cd_offset, &cd_size, &entry_count) < 0) {
+        return -1;
+    }
+
+    /* Each central directory header takes at least 46 bytes */
+    if (entry_count > cd_size / ZIP_CENTRAL_HEADER_SIZE) {
+        return -1;
+    }
+    if (archive_alloc_index(archive, (size_t)entry_count) < 0) {
+        return -1;
+    }
+
+    const unsigned char *p   = map + cd_offset;
+    const unsigned char *end = p + cd_size;
+    for (uint64_t i = 0; i < entry_count; i++) {
+        if ((size_t)(end - p) < ZIP_CENTRAL_HEADER_SIZE || read_u32(p) != ZIP_SIG_CENTRAL_HEADER) {
+            return -1;
+        }
+
+        uint16_t flags        = read_u16(p + 8);
+        uint16_t method       = read_u16(p + 10);
+        uint32_t crc32        = read_u32(p + 16);
+        uint64_t comp_size    = read_u32(p + 20);
+        uint64_t size         = read_u32(p + 24);
+        uint16_t name_len     = read_u16(p + 28);
+        uint16_t extra_len    = read_u16(p + 30);
+        uint16_t comment_len  = read_u16(p + 32);
+        uint64_t local_offset = read_u32(p + 42);
+
+        size_t record_len = (size_t)ZIP_CENTRAL_HEADER_SIZE + name_len + extra_len + comment_len;
+        if ((size_t)(end - p) < record_len) {
+            return -1;
+        }
+
+        /* Encrypted or non-deflate entries are left to libzip */
+        if ((flags & 0x0001) || (method != ZIP_CM_STORE && method != ZIP_CM_DEFLATE)) {
+            return -1;
+        }
+
+        /* Zip64 extended information extra field */
+        const unsigned char *extra     = p + ZIP_CENTRAL_HEADER_SIZE + name_len;
+        const unsigned char *extra_end = extra + extra_len;
+        while (extra_end - extra >= 4) {
+            uint16_t id       = read_u16(extra);
+            uint16_t data_len = read_u16(extra + 2);
+            if (extra_end - extra - 4 < data_len) {
+                break;
+            }
+            if (id == 0x0001) {
+                const unsigned char *field     = extra + 4;
+                const unsigned char *field_end = field + data_len;
+                if (size == 0xFFFFFFFF && field_end - field >= 8) {
+                    size = read_u64(field);
+                    field += 8;
+                }
+                if (comp_size == 0xFFFFFFFF && field_end - field >= 8) {
+                    comp_size = read_u64(field);
+                    field += 8;
+                }
+                if (local_offset == 0xFFFFFFFF && field_end - field >= 8) {
+                    local_offset = read_u64(field);
+                }
+            }
+            extra += 4 + data_len;
+        }
+
+        if (method == ZIP_CM_STORE && size != comp_size) {
+            return -1;
+        }
+
+        zipEntry *entry =
+            archive_add_entry(archive, (const char *)p + ZIP_CENTRAL_HEADER_SIZE, name_len);
+        if (entry) {
+            entry->local_offset     = local_offset;
+            entry->info.size        = (size_t)size;
+            entry->info.comp_size   = (size_t)comp_size;
+            entry->info.comp_method = method;
+            entry->info.crc32       = crc32;
+        }
+
+        p += record_len;
+    }
+
+    return 0;
+}
+
+/* Map an open file read-only; returns NULL (and leaves fd open) on failure */
+static const unsigned char *map_fd(int fd, size_t *size)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = (size_t)st.st_size;
+    return (const unsigned char *)map;
+}
+
+/* Index a mapped archive without libzip; takes ownership of the mapping on success */
+static zipArchive *archive_create_mapped(const unsigned char *map, size_t map_size)
+{
+    zipArchive *archive = calloc(1, sizeof(zipArchive));
+    if (!archive) {
+        return NULL;
+    }
+    archive->backend  = ZIP_BACKEND_MMAP;
+    archive->map      = map;
+    archive->map_size = map_size;
+    archive->inflater = inflate_backend_find(NULL);
+    pthread_mutex_init(&archive->stats_lock, NULL);
+
+    if (index_central_directory(archive) < 0) {
+        archive_free(archive);
+        return NULL;
+    }
+
+    return archive;
+}
+
+/* Map a local file into memory and index it without libzip; NULL if not possible */
+static zipArchive *archive_create_mmap(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    size_t               map_size = 0;
+    const unsigned char *map      = map_fd(fd, &map_size);
+    close(fd);
+    if (!map) {
+        return NULL;
+    }
+
+    zipArchive *archive = archive_create_mapped(map, map_size);
+    if (!archive) {
+        munmap((void *)(uintptr_t)map, map_size);
+        return NULL;
+    }
+
+    return archive;
+}
+
+/* Locate entry data inside the mapping via its local file header */
+static const unsigned char *mapped_entry_data(zipArchive *archive, zipEntry *entry)
+{
+    if (entry->data) {
+        return entry->data;
+    }
+
+    if (entry->local_offset > archive->map_size ||
+        archive->map_size - entry->local_offset < ZIP_LOCAL_HEADER_SIZE) {
+        return NULL;
+    }
+
+    const unsigned char *header = archive->map + entry->local_offset;
+    if (read_u32(header) != ZIP_SIG_LOCAL_HEADER) {
+        return NULL;
+    }
+
+    uint64_t data_offset =
+        entry->local_offset + ZIP_LOCAL_HEADER_SIZE + read_u16(header + 26) + read_u16(header + 28);
+    if (data_offset > archive->map_size ||
+        archive->map_size - data_offset < entry->info.comp_size) {
+        return NULL;
+    }
+
+    return archive->map + data_offset;
+}
+
 /* Open XLSX file (which is a ZIP archive) */
 void *zip_open_file(const char *filename)
 {
+    /* Prefer the memory-mapped reader; libzip handles anything it cannot */
+    zipArchive *archive = archive_create_mmap(filename);
+    if (archive) {
+        return (void *)archive;
+    }
+
     int    err = 0;
     zip_t *za  = zip_open(filename, ZIP_RDONLY, &err);
 
@@ -24,67 +539,497 @@ void *zip_open_file(const char *filename)
         return NULL;
     }
 
-    return (void *)za;
+    archive = archive_create(za);
+    if (!archive) {
+        fprintf(stderr, "Error: Out of memory\n");
+        zip_discard(za);
+        return NULL;
+    }
+
+    return (void *)archive;
 }
 
-/* Open from STDIN (read into memory buffer) */
-void *zip_open_stdin(void)
+/* Sequential reader over STDIN */
+typedef struct {
+    unsigned char buffer[ZIP_SPOOL_CHUNK_SIZE];
+    size_t        pos;
+    size_t        len;
+    bool          failed; /* Read error (EOF is not one) */
+} stdinReader;
+
+/* Entry met while walking the local file headers of a streamed archive */
+typedef struct {
+    char        *name; /* Normalized */
+    zipEntryInfo info;
+    bool         in_memory;
+    size_t       offset; /* Of the entry data, in memory or in the spool file */
+} streamedEntry;
+
+/* Archive read from STDIN: metadata parts stay in memory, all else goes to disk */
+typedef struct {
+    stdinReader    in;
+    unsigned char  scratch[ZIP_SPOOL_CHUNK_SIZE]; /* Discarded output of descriptor scans */
+    char           name[UINT16_MAX + 1];
+    unsigned char  extra[UINT16_MAX];
+    unsigned char *memory;
+    size_t         memory_len;
+    size_t         memory_capacity;
+    int            spool_fd; /* Unlinked file in $TMPDIR */
+    size_t         spool_len;
+    streamedEntry *entries;
+    size_t         entry_count;
+    size_t         entry_capacity;
+    const char    *error;
+} stdinStream;
+
+/* Parts read while the workbook is opened; they are small next to the worksheets */
+static bool is_metadata_part(const char *name)
 {
-    /* Read all data from stdin into buffer */
-    size_t buffer_size = 4096;
-    size_t total_read  = 0;
-    char  *buffer      = malloc(buffer_size);
+    static const char *const parts[] = {
+        "[content_types].xml", "xl/workbook.xml", "xl/_rels/workbook.xml.rels",
+        "xl/sharedstrings.xml", "xl/styles.xml",
+    };
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        if (strcmp(name, parts[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (!buffer) {
-        fprintf(stderr, "Error: Out of memory\n");
-        return NULL;
+/* Unlinked temporary file in $TMPDIR (disk-backed, unlike a memfd); -1 on failure */
+static int spool_file_create(void)
+{
+    const char *dir = getenv("TMPDIR");
+    if (!dir || !*dir) {
+        dir = P_tmpdir;
+    }
+
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    /* File systems without O_TMPFILE: create and unlink at once */
+    size_t len  = strlen(dir) + sizeof("/xlsx2csv-XXXXXX");
+    char  *path = malloc(len);
+    if (!path) {
+        return -1;
+    }
+    snprintf(path, len, "%s/xlsx2csv-XXXXXX", dir);
+    fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);
+    }
+    free(path);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    /* An unusable $TMPDIR: the C library's default temporary directory */
+    FILE *tmp = tmpfile();
+    if (!tmp) {
+        return -1;
+    }
+    fd = dup(fileno(tmp));
+    fclose(tmp);
+    return fd;
+}
+
+/* Make unread bytes available; false at end of input or on a read error */
+static bool stdin_fill(stdinReader *in)
+{
+    if (in->pos < in->len) {
+        return true;
     }
 
     while (1) {
-        size_t read_size = fread(buffer + total_read, 1, buffer_size - total_read, stdin);
-        total_read += read_size;
+        ssize_t read_size = read(STDIN_FILENO, in->buffer, sizeof(in->buffer));
+        if (read_size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_size < 0) {
+            in->failed = true;
+        }
+        in->pos = 0;
+        in->len = read_size > 0 ? (size_t)read_size : 0;
+        return read_size > 0;
+    }
+}
 
-        if (read_size == 0) {
-            break;
+static bool stdin_read(stdinReader *in, unsigned char *dst, size_t size)
+{
+    while (size > 0) {
+        if (!stdin_fill(in)) {
+            return false;
         }
+        size_t n = in->len - in->pos < size ? in->len - in->pos : size;
+        memcpy(dst, in->buffer + in->pos, n);
+        in->pos += n;
+        dst += n;
+        size -= n;
+    }
+    return true;
+}
 
-        if (total_read >= buffer_size) {
-            buffer_size *= 2;
-            char *new_buffer = realloc(buffer, buffer_size);
-            if (!new_buffer) {
-                free(buffer);
-                fprintf(stderr, "Error: Out of memory\n");
-                return NULL;
+/* Append entry bytes to memory or to the spool file */
+static bool stream_store(stdinStream *s, bool in_memory, const unsigned char *data, size_t size)
+{
+    if (in_memory) {
+        if (s->memory_capacity - s->memory_len < size) {
+            size_t capacity = s->memory_capacity ? s->memory_capacity : ZIP_SPOOL_CHUNK_SIZE;
+            while (capacity - s->memory_len < size) {
+                capacity *= 2;
+            }
+            unsigned char *memory = realloc(s->memory, capacity);
+            if (!memory) {
+                s->error = "Out of memory";
+                return false;
             }
-            buffer = new_buffer;
+            s->memory          = memory;
+            s->memory_capacity = capacity;
         }
+        memcpy(s->memory + s->memory_len, data, size);
+        s->memory_len += size;
+        return true;
     }
 
-    /* Open ZIP from memory buffer */
-    zip_error_t   error;
-    zip_source_t *src = zip_source_buffer_create(buffer, total_read, 1, &error);
-    if (src == NULL) {
-        fprintf(stderr, "Error creating zip source: %s\n", zip_error_strerror(&error));
-        free(buffer);
+    for (size_t written = 0; written < size;) {
+        ssize_t n = write(s->spool_fd, data + written, size - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            s->error = "Could not write the spool file";
+            return false;
+        }
+        written += (size_t)n;
+    }
+    s->spool_len += size;
+    return true;
+}
+
+/* Pass size bytes of entry data from STDIN to the store */
+static bool stream_copy(stdinStream *s, bool in_memory, uint64_t size)
+{
+    while (size > 0) {
+        if (!stdin_fill(&s->in)) {
+            return false;
+        }
+        size_t n = s->in.len - s->in.pos;
+        if (n > size) {
+            n = (size_t)size;
+        }
+        if (!stream_store(s, in_memory, s->in.buffer + s->in.pos, n)) {
+            return false;
+        }
+        s->in.pos += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* Pass a deflate stream of unknown length to the store, inflating it only to find its end */
+static bool stream_copy_deflated(stdinStream *s, bool in_memory, zipEntryInfo *info)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+        s->error = "Out of memory";
+        return false;
+    }
+
+    int ret = Z_OK;
+    while (ret != Z_STREAM_END) {
+        if (!stdin_fill(&s->in)) {
+            break;
+        }
+        size_t available = s->in.len - s->in.pos;
+        strm.next_in     = s->in.buffer + s->in.pos;
+        strm.avail_in    = (uInt)available;
+        strm.next_out    = s->scratch;
+        strm.avail_out   = sizeof(s->scratch);
+
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            break;
+        }
+        size_t consumed = available - strm.avail_in;
+        if (!stream_store(s, in_memory, s->in.buffer + s->in.pos, consumed)) {
+            inflateEnd(&strm);
+            return false;
+        }
+        s->in.pos += consumed;
+    }
+
+    info->comp_size = (size_t)strm.total_in;
+    info->size      = (size_t)strm.total_out;
+    inflateEnd(&strm);
+    return ret == Z_STREAM_END;
+}
+
+/* Read the entry at the reader; 1 if one was read, 0 past the last local header, -1 on error */
+static int stream_entry(stdinStream *s)
+{
+    unsigned char header[ZIP_LOCAL_HEADER_SIZE];
+    if (!stdin_read(&s->in, header, 4) || read_u32(header) != ZIP_SIG_LOCAL_HEADER) {
+        return 0;
+    }
+    if (!stdin_read(&s->in, header + 4, ZIP_LOCAL_HEADER_SIZE - 4)) {
+        return -1;
+    }
+
+    uint16_t flags     = read_u16(header + 6);
+    uint16_t method    = read_u16(header + 8);
+    uint64_t comp_size = read_u32(header + 18);
+    uint64_t size      = read_u32(header + 22);
+    uint16_t name_len  = read_u16(header + 26);
+    uint16_t extra_len = read_u16(header + 28);
+
+    unsigned char *extra = s->extra;
+    if (!stdin_read(&s->in, (unsigned char *)s->name, name_len) ||
+        !stdin_read(&s->in, extra, extra_len)) {
+        return -1;
+    }
+
+    /* Encrypted or non-deflate entries cannot be read without libzip */
+    if ((flags & 0x0001) || (method != ZIP_CM_STORE && method != ZIP_CM_DEFLATE)) {
+        s->error = "Unsupported compression or encryption";
+        return -1;
+    }
+
+    /* Zip64 extended information: both sizes, when present */
+    bool zip64 = false;
+    for (size_t pos = 0; pos + 4 <= extra_len;) {
+        uint16_t id       = read_u16(extra + pos);
+        uint16_t data_len = read_u16(extra + pos + 2);
+        if (extra_len - pos - 4 < data_len) {
+            break;
+        }
+        if (id == 0x0001 && data_len >= 16) {
+            size      = read_u64(extra + pos + 4);
+            comp_size = read_u64(extra + pos + 12);
+            zip64     = true;
+        }
+        pos += 4 + (size_t)data_len;
+    }
+
+    if (s->entry_count == s->entry_capacity) {
+        size_t         capacity = s->entry_capacity ? s->entry_capacity * 2 : 16;
+        streamedEntry *entries  = realloc(s->entries, capacity * sizeof(streamedEntry));
+        if (!entries) {
+            s->error = "Out of memory";
+            return -1;
+        }
+        s->entries        = entries;
+        s->entry_capacity = capacity;
+    }
+
+    streamedEntry *entry = &s->entries[s->entry_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->name = normalize_entry_name(s->name, name_len);
+    if (!entry->name) {
+        s->error = "Out of memory";
+        return -1;
+    }
+    s->entry_count++;
+
+    entry->in_memory        = is_metadata_part(entry->name);
+    entry->offset           = entry->in_memory ? s->memory_len : s->spool_len;
+    entry->info.comp_method = method;
+    entry->info.crc32       = read_u32(header + 14);
+
+    /* Sizes are in the local header unless a data descriptor follows the data */
+    if (!(flags & 0x0008)) {
+        if (method == ZIP_CM_STORE && size != comp_size) {
+            s->error = "Inconsistent stored entry";
+            return -1;
+        }
+        entry->info.size      = (size_t)size;
+        entry->info.comp_size = (size_t)comp_size;
+        return stream_copy(s, entry->in_memory, comp_size) ? 1 : -1;
+    }
+
+    /* Only a deflate stream tells where it ends */
+    if (method != ZIP_CM_DEFLATE) {
+        s->error = "Stored entry of unknown size";
+        return -1;
+    }
+    if (!stream_copy_deflated(s, entry->in_memory, &entry->info)) {
+        return -1;
+    }
+
+    /* Data descriptor: optional signature, CRC-32, then both sizes (64-bit for Zip64) */
+    unsigned char descriptor[24];
+    size_t        sizes_len = zip64 ? 16 : 8;
+    if (!stdin_read(&s->in, descriptor, 4)) {
+        return -1;
+    }
+    if (read_u32(descriptor) == ZIP_SIG_DATA_DESCRIPTOR && !stdin_read(&s->in, descriptor, 4)) {
+        return -1;
+    }
+    if (!stdin_read(&s->in, descriptor + 4, sizes_len)) {
+        return -1;
+    }
+    entry->info.crc32 = read_u32(descriptor);
+    return 1;
+}
+
+/* Index the entries of a streamed archive; the spool file is mapped read-only */
+static zipArchive *archive_create_streamed(stdinStream *s)
+{
+    zipArchive *archive = calloc(1, sizeof(zipArchive));
+    if (!archive) {
         return NULL;
     }
+    archive->backend  = ZIP_BACKEND_MMAP;
+    archive->inflater = inflate_backend_find(NULL);
+    pthread_mutex_init(&archive->stats_lock, NULL);
 
-    zip_t *za = zip_open_from_source(src, ZIP_RDONLY, &error);
-    if (za == NULL) {
-        fprintf(stderr, "Error opening zip from stdin: %s\n", zip_error_strerror(&error));
-        zip_source_free(src);
+    if (s->spool_len > 0) {
+        archive->map = map_fd(s->spool_fd, &archive->map_size);
+        if (!archive->map) {
+            archive_free(archive);
+            return NULL;
+        }
+    }
+    if (archive_alloc_index(archive, s->entry_count) < 0) {
+        if (archive->map) {
+            munmap((void *)(uintptr_t)archive->map, archive->map_size);
+        }
+        archive_free(archive);
+        return NULL;
+    }
+
+    /* The archive takes over the metadata parts */
+    archive->memory = s->memory;
+    s->memory       = NULL;
+
+    static const unsigned char empty[1];
+    for (size_t i = 0; i < s->entry_count; i++) {
+        const streamedEntry *streamed = &s->entries[i];
+        zipEntry *entry = archive_add_entry(archive, streamed->name, strlen(streamed->name));
+        if (!entry) {
+            continue;
+        }
+        const unsigned char *base = streamed->in_memory ? archive->memory : archive->map;
+        entry->info               = streamed->info;
+        entry->data               = base ? base + streamed->offset : empty;
+    }
+
+    return archive;
+}
+
+/* Open from STDIN, walking the local file headers as the bytes arrive
+ * Metadata parts are kept in memory; worksheets and all other entries are
+ * spooled to an unlinked file in $TMPDIR and mapped, so memory use does not
+ * grow with the size of the worksheets
+ */
+void *zip_open_stdin(void)
+{
+    stdinStream *s = calloc(1, sizeof(stdinStream));
+    if (!s) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return NULL;
+    }
+
+    s->spool_fd = spool_file_create();
+    if (s->spool_fd < 0) {
+        fprintf(stderr, "Error: Could not create a spool file for stdin\n");
+        free(s);
         return NULL;
     }
 
-    return (void *)za;
+    int status;
+    do {
+        status = stream_entry(s);
+    } while (status > 0);
+
+    /* The central directory repeats what the local headers said; drain it */
+    while (status == 0 && stdin_fill(&s->in)) {
+        s->in.pos = s->in.len;
+    }
+
+    zipArchive *archive = NULL;
+    if (status < 0 || s->in.failed) {
+        fprintf(stderr, "Error opening zip from stdin: %s\n",
+                s->error ? s->error : "Truncated archive");
+    } else if (s->entry_count == 0) {
+        fprintf(stderr, "Error opening zip from stdin: Not a zip archive\n");
+    } else {
+        archive = archive_create_streamed(s);
+        if (!archive) {
+            fprintf(stderr, "Error: Could not read archive from stdin\n");
+        }
+    }
+
+    for (size_t i = 0; i < s->entry_count; i++) {
+        free(s->entries[i].name);
+    }
+    free(s->entries);
+    free(s->memory);
+    close(s->spool_fd);
+    free(s);
+    return (void *)archive;
 }
 
 /* Close ZIP archive */
 void xlsx_zip_close(void *handle)
 {
     if (handle) {
-        zip_close((zip_t *)handle);
+        zipArchive *archive = (zipArchive *)handle;
+        if (archive->za) {
+            zip_close(archive->za);
+        }
+        if (archive->map) {
+            munmap((void *)(uintptr_t)archive->map, archive->map_size);
+        }
+        archive_free(archive);
+    }
+}
+
+/* Look up entry metadata (case-insensitive) */
+int zip_file_stat(void *zip_handle, const char *filename, zipEntryInfo *info)
+{
+    if (!zip_handle || !filename || !info) {
+        return -1;
+    }
+
+    zipEntry *entry = find_entry((zipArchive *)zip_handle, filename);
+    if (!entry) {
+        return -1;
+    }
+
+    *info = entry->info;
+    return 0;
+}
+
+/* Get stored (uncompressed) entry contents without copying
+ * Returns NULL if the entry is compressed or the archive is not memory-mapped
+ */
+const char *zip_file_map(void *zip_handle, const char *filename, size_t *size)
+{
+    if (!zip_handle || !filename || !size) {
+        return NULL;
     }
+
+    zipArchive *archive = (zipArchive *)zip_handle;
+    if (archive->backend != ZIP_BACKEND_MMAP) {
+        return NULL;
+    }
+
+    zipEntry *entry = find_entry(archive, filename);
+    if (!entry || entry->info.comp_method != ZIP_CM_STORE) {
+        return NULL;
+    }
+
+    const unsigned char *data = mapped_entry_data(archive, entry);
+    if (!data) {
+        return NULL;
+    }
+
+    *size = entry->info.size;
+    return (const char *)data;
 }
 
 /* Open file within ZIP archive (case-insensitive) */
@@ -94,25 +1039,204 @@ void *zip_file_open(void *zip_handle, const char *filename)
         return NULL;
     }
 
-    zip_t *za = (zip_t *)zip_handle;
+    zipArchive *archive = (zipArchive *)zip_handle;
+    zipEntry   *entry   = find_entry(archive, filename);
+    if (!entry) {
+        return NULL;
+    }
 
-    /* Remove leading slash if present */
-    const char *search_name = filename;
-    if (search_name[0] == '/') {
-        search_name++;
+    zipFile *file = calloc(1, sizeof(zipFile));
+    if (!file) {
+        return NULL;
     }
 
-    /* Try to find file (case-insensitive) */
-    zip_int64_t num_entries = zip_get_num_entries(za, 0);
-    for (zip_int64_t i = 0; i < num_entries; i++) {
-        const char *name = zip_get_name(za, (zip_uint64_t)i, 0);
-        if (name && strcasecmp(name, search_name) == 0) {
-            zip_file_t *zf = zip_fopen_index(za, (zip_uint64_t)i, 0);
-            return (void *)zf;
+    file->archive = archive;
+    if (entry->info.comp_method != ZIP_CM_STORE) {
+        file->counted            = true;
+        file->stats.stream_calls = 1;
+        file->stats.bytes_in     = entry->info.comp_size;
+    }
+
+    if (archive->backend == ZIP_BACKEND_LIBZIP) {
+        file->zf = zip_fopen_index(archive->za, entry->index, 0);
+        if (!file->zf) {
+            free(file);
+            return NULL;
+        }
+        return (void *)file;
+    }
+
+    /* Memory-mapped entries are read (or inflated) straight out of the mapping */
+    file->next_in  = mapped_entry_data(archive, entry);
+    file->avail_in = entry->info.comp_size;
+    if (!file->next_in) {
+        free(file);
+        return NULL;
+    }
+
+    if (entry->info.comp_method == ZIP_CM_DEFLATE) {
+        file->deflated = true;
+        if (inflateInit2(&file->strm, -MAX_WBITS) != Z_OK) {
+            free(file);
+            return NULL;
         }
     }
 
-    return NULL;
+    return (void *)file;
+}
+
+/* Record a checkpoint if inflate stopped at a block boundary far enough from the last one */
+static int add_index_point(zipFile *file)
+{
+    z_stream *strm = &file->strm;
+
+    /* Bit 7: at the end of a block, bit 6: that block was the last one */
+    if (!(strm->data_type & 128) || (strm->data_type & 64) ||
+        !inflate_index_wants_point(file->index, strm->total_out)) {
+        return 0;
+    }
+
+    unsigned char window[INFLATE_WINDOW_SIZE];
+    uInt          window_len = 0;
+    if (inflateGetDictionary(strm, window, &window_len) != Z_OK) {
+        return -1;
+    }
+
+    return inflate_index_add_point(file->index, strm->total_out, strm->total_in,
+                                   strm->data_type & 7, window, window_len);
+}
+
+/* Read from mapped entry, inflating if needed */
+static int mapped_file_read(zipFile *file, void *buffer, size_t size)
+{
+    if (size > ZIP_INFLATE_MAX_CHUNK) {
+        size = ZIP_INFLATE_MAX_CHUNK;
+    }
+
+    if (!file->deflated) {
+        size_t n = size < file->avail_in ? size : file->avail_in;
+        memcpy(buffer, file->next_in, n);
+        file->next_in += n;
+        file->avail_in -= n;
+        return (int)n;
+    }
+
+    if (file->finished || size == 0) {
+        return 0;
+    }
+
+    file->strm.next_out  = buffer;
+    file->strm.avail_out = (uInt)size;
+
+    while (file->strm.avail_out > 0) {
+        /* With no input left, inflate reports a truncated stream as Z_BUF_ERROR */
+        if (file->strm.avail_in == 0 && file->avail_in > 0) {
+            size_t chunk =
+                file->avail_in < ZIP_INFLATE_MAX_CHUNK ? file->avail_in : ZIP_INFLATE_MAX_CHUNK;
+            file->strm.next_in  = (Bytef *)(uintptr_t)file->next_in;
+            file->strm.avail_in = (uInt)chunk;
+            file->next_in += chunk;
+            file->avail_in -= chunk;
+        }
+
+        /* Index builds stop at every block boundary to consider a checkpoint */
+        int ret = inflate(&file->strm, file->index ? Z_BLOCK : Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            file->finished = true;
+            break;
+        }
+        if (ret != Z_OK) {
+            return -1;
+        }
+        if (file->index && add_index_point(file) < 0) {
+            return -1;
+        }
+    }
+
+    int produced = (int)(size - file->strm.avail_out);
+    if (file->index) {
+        inflate_index_scan(file->index, buffer, (size_t)produced);
+        if (file->finished) {
+            inflate_index_finish(file->index);
+        }
+    }
+    return produced;
+}
+
+/* Build a checkpoint index while the entry is read from the start
+ * Only memory-mapped deflated entries that have not been read yet qualify
+ */
+int zip_file_build_index(void *file_handle, inflateIndex *index)
+{
+    if (!file_handle || !index) {
+        return -1;
+    }
+
+    zipFile *file = (zipFile *)file_handle;
+    if (file->zf || !file->deflated || file->strm.total_in != 0 || file->strm.total_out != 0) {
+        return -1;
+    }
+
+    file->index = index;
+    return 0;
+}
+
+/* Open a memory-mapped deflated entry positioned at a checkpoint
+ * Reads return entry data starting at point->out_offset
+ */
+void *zip_file_open_at(void *zip_handle, const char *filename, const inflatePoint *point)
+{
+    if (!zip_handle || !filename || !point) {
+        return NULL;
+    }
+
+    zipArchive *archive = (zipArchive *)zip_handle;
+    zipEntry   *entry   = find_entry(archive, filename);
+    if (!entry || archive->backend != ZIP_BACKEND_MMAP ||
+        entry->info.comp_method != ZIP_CM_DEFLATE || point->in_offset > entry->info.comp_size ||
+        (point->bits > 0 && point->in_offset == 0)) {
+        return NULL;
+    }
+
+    const unsigned char *data = mapped_entry_data(archive, entry);
+    if (!data) {
+        return NULL;
+    }
+
+    zipFile *file = calloc(1, sizeof(zipFile));
+    if (!file) {
+        return NULL;
+    }
+
+    file->deflated           = true;
+    file->archive            = archive;
+    file->counted            = true;
+    file->next_in            = data + point->in_offset;
+    file->avail_in           = entry->info.comp_size - point->in_offset;
+    file->stats.stream_calls = 1;
+    file->stats.bytes_in     = file->avail_in;
+
+    if (inflateInit2(&file->strm, -MAX_WBITS) != Z_OK) {
+        free(file);
+        return NULL;
+    }
+
+    /* Feed the unused high bits of the byte the checkpoint falls in, then the history */
+    int ret = Z_OK;
+    if (point->bits > 0) {
+        int byte = data[point->in_offset - 1];
+        ret      = inflatePrime(&file->strm, point->bits, byte >> (8 - point->bits));
+    }
+    if (ret == Z_OK) {
+        ret = inflateSetDictionary(&file->strm, point->window, point->window_len);
+    }
+    if (ret != Z_OK) {
+        inflateEnd(&file->strm);
+        free(file);
+        return NULL;
+    }
+
+    return (void *)file;
 }
 
 /* Read from file within ZIP */
@@ -122,60 +1246,239 @@ int zip_file_read(void *file_handle, void *buffer, size_t size)
         return -1;
     }
 
-    zip_file_t *zf = (zip_file_t *)file_handle;
-    return (int)zip_fread(zf, buffer, size);
+    zipFile *file = (zipFile *)file_handle;
+    if (!file->counted) {
+        return file->zf ? (int)zip_fread(file->zf, buffer, size)
+                        : mapped_file_read(file, buffer, size);
+    }
+
+    double start     = inflate_clock();
+    int    read_size = file->zf ? (int)zip_fread(file->zf, buffer, size)
+                                : mapped_file_read(file, buffer, size);
+    file->stats.seconds += inflate_clock() - start;
+    if (read_size > 0) {
+        file->stats.bytes_out += (uint64_t)read_size;
+    }
+    return read_size;
 }
 
 /* Close file within ZIP */
 void zip_file_close(void *file_handle)
 {
     if (file_handle) {
-        zip_fclose((zip_file_t *)file_handle);
+        zipFile *file = (zipFile *)file_handle;
+        if (file->zf) {
+            zip_fclose(file->zf);
+        } else if (file->deflated) {
+            /* Readers that stop early (parallel chunks) only count what they consumed */
+            file->stats.bytes_in -= file->avail_in + file->strm.avail_in;
+            inflateEnd(&file->strm);
+        }
+        if (file->counted) {
+            archive_add_stats(file->archive, &file->stats);
+        }
+        free(file);
     }
 }
 
-/* Read entire file from ZIP to string */
-char *zip_read_file_to_string(void *zip_handle, const char *filename)
+/* Allocate or free an entry buffer, from the pool when one is given */
+static char *entry_buffer_alloc(bufferPool *pool, size_t size)
+{
+    return pool ? buffer_pool_acquire(pool, size) : malloc(size);
+}
+
+static void entry_buffer_free(bufferPool *pool, char *buffer)
+{
+    if (pool) {
+        buffer_pool_release(pool, buffer);
+    } else {
+        free(buffer);
+    }
+}
+
+/* Bytes worth allocating before reading an entry; equals info->size only when
+ * the recorded size is plausible for the compressed data
+ */
+static size_t entry_initial_size(const zipEntryInfo *info)
+{
+    size_t bound = info->comp_size;
+    if (info->comp_method != ZIP_CM_STORE) {
+        bound = info->comp_size > ZIP_ENTRY_PREALLOC_LIMIT / ZIP_DEFLATE_MAX_RATIO
+                    ? ZIP_ENTRY_PREALLOC_LIMIT
+                    : info->comp_size * ZIP_DEFLATE_MAX_RATIO;
+    }
+    if (bound > ZIP_ENTRY_PREALLOC_LIMIT) {
+        bound = ZIP_ENTRY_PREALLOC_LIMIT;
+    }
+    return info->size < bound ? info->size : bound;
+}
+
+/* Inflate a mapped deflated entry in one call to the selected backend
+ * Returns a NUL-terminated buffer, or NULL if the entry does not qualify or fails to decode
+ */
+static char *inflate_entry(zipArchive *archive, zipEntry *entry, bufferPool *pool, size_t *length)
 {
+    if (archive->backend != ZIP_BACKEND_MMAP || !archive->inflater ||
+        entry->info.comp_method != ZIP_CM_DEFLATE) {
+        return NULL;
+    }
+
+    /* The output buffer is sized from the recorded size, so it must be one the data can hold */
+    if (entry_initial_size(&entry->info) != entry->info.size) {
+        return NULL;
+    }
+
+    const unsigned char *data = mapped_entry_data(archive, entry);
+    if (!data) {
+        return NULL;
+    }
+
+    char *buffer = entry_buffer_alloc(pool, entry->info.size + 1);
+    if (!buffer) {
+        return NULL;
+    }
+
+    inflateStats stats = {0};
+    if (inflate_backend_run(archive->inflater, &stats, data, entry->info.comp_size,
+                            (unsigned char *)buffer, entry->info.size) < 0) {
+        entry_buffer_free(pool, buffer);
+        return NULL;
+    }
+    archive_add_stats(archive, &stats);
+
+    buffer[entry->info.size] = '\0';
+    if (length) {
+        *length = entry->info.size;
+    }
+    return buffer;
+}
+
+/* Read entry into a NUL-terminated buffer sized from the central directory */
+static char *read_entry(void *zip_handle, const char *filename, bufferPool *pool, size_t *length)
+{
+    zipEntryInfo info;
+    if (zip_file_stat(zip_handle, filename, &info) < 0) {
+        return NULL;
+    }
+
+    /* Known-size deflated entries decode in one shot; anything else (or a
+     * stream the backend rejects) goes through the incremental reader
+     */
+    zipArchive *archive  = (zipArchive *)zip_handle;
+    char       *inflated = inflate_entry(archive, find_entry(archive, filename), pool, length);
+    if (inflated) {
+        return inflated;
+    }
+
     void *file = zip_file_open(zip_handle, filename);
     if (!file) {
         return NULL;
     }
 
-    /* Read file in chunks */
-    size_t buffer_size = 4096;
+    /* Allocate once for the recorded size where it is plausible; grow only if the
+     * entry holds more, or start small when that much memory is not available
+     */
+    size_t buffer_size = entry_initial_size(&info) + 1;
     size_t total_read  = 0;
-    char  *buffer      = malloc(buffer_size);
+    char  *buffer      = entry_buffer_alloc(pool, buffer_size);
 
+    if (!buffer && buffer_size > ZIP_ENTRY_MIN_BUFFER) {
+        buffer_size = ZIP_ENTRY_MIN_BUFFER;
+        buffer      = entry_buffer_alloc(pool, buffer_size);
+    }
     if (!buffer) {
         zip_file_close(file);
         return NULL;
     }
 
     while (1) {
-        int read_size = zip_file_read(file, buffer + total_read, buffer_size - total_read - 1);
-        if (read_size <= 0) {
-            break;
-        }
-
-        total_read += (size_t)read_size;
+        if (total_read == buffer_size - 1) {
+            /* Buffer holds the recorded size; probe before growing */
+            char probe;
+            if (zip_file_read(file, &probe, 1) <= 0) {
+                break;
+            }
 
-        if (total_read >= buffer_size - 1) {
-            buffer_size *= 2;
-            char *new_buffer = realloc(buffer, buffer_size);
+            size_t new_size =
+                buffer_size < ZIP_ENTRY_MIN_BUFFER ? ZIP_ENTRY_MIN_BUFFER : buffer_size * 2;
+            char *new_buffer = entry_buffer_alloc(pool, new_size);
             if (!new_buffer) {
-                free(buffer);
+                entry_buffer_free(pool, buffer);
                 zip_file_close(file);
                 return NULL;
             }
-            buffer = new_buffer;
+            memcpy(new_buffer, buffer, total_read);
+            entry_buffer_free(pool, buffer);
+            buffer      = new_buffer;
+            buffer_size = new_size;
+
+            buffer[total_read++] = probe;
         }
-    }
 
-    if (buffer) {
-        buffer[total_read] = '\0';
+        int read_size = zip_file_read(file, buffer + total_read, buffer_size - total_read - 1);
+        if (read_size <= 0) {
+            break;
+        }
+        total_read += (size_t)read_size;
     }
+
+    buffer[total_read] = '\0';
     zip_file_close(file);
 
+    if (length) {
+        *length = total_read;
+    }
     return buffer;
 }
+
+/* Read entire file from ZIP to string */
+char *zip_read_file_to_string(void *zip_handle, const char *filename)
+{
+    return read_entry(zip_handle, filename, NULL, NULL);
+}
+
+/* Read entire file from ZIP into a pooled buffer (release with buffer_pool_release);
+ * with no pool the buffer is the caller's own, to free()
+ */
+char *zip_read_file_pooled(void       *zip_handle,
+                           const char *filename,
+                           bufferPool *pool,
+                           size_t     *length)
+{
+    return read_entry(zip_handle, filename, pool, length);
+}
+
+/* Inflate a deflated entry in one shot into a pooled buffer (release with buffer_pool_release)
+ * Returns NULL if the entry is not a memory-mapped deflated entry; use zip_file_open then
+ */
+char *zip_file_inflate(void       *zip_handle,
+                       const char *filename,
+                       bufferPool *pool,
+                       size_t     *length)
+{
+    if (!zip_handle || !filename) {
+        return NULL;
+    }
+
+    zipArchive *archive = (zipArchive *)zip_handle;
+    zipEntry   *entry   = find_entry(archive, filename);
+    if (!entry) {
+        return NULL;
+    }
+
+    return inflate_entry(archive, entry, pool, length);
+}
+
+/* Select the one-shot inflate backend */
+void zip_set_inflate_backend(void *zip_handle, const inflateBackend *backend)
+{
+    if (zip_handle) {
+        ((zipArchive *)zip_handle)->inflater = backend;
+    }
+}
+
+/* Decompression counters accumulated since the archive was opened */
+const inflateStats *zip_inflate_stats(void *zip_handle)
+{
+    return zip_handle ? &((zipArchive *)zip_handle)->stats : NULL;
+}
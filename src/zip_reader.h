@@ -2,6 +2,19 @@
 #define _ZIP_READER_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "inflate_backend.h"
+#include "inflate_index.h"
+#include "xlsx2csv.h"
+
+/* ZIP entry metadata, recorded once when the archive is opened */
+typedef struct {
+    size_t   size;        /* Uncompressed size */
+    size_t   comp_size;   /* Compressed size */
+    int      comp_method; /* ZIP compression method, -1 if unknown */
+    uint32_t crc32;
+} zipEntryInfo;
 
 /* ZIP file operations */
 void *zip_open_file(const char *filename);
@@ -9,11 +22,29 @@ void *zip_open_stdin(void);
 void  xlsx_zip_close(void *handle);
 
 /* ZIP entry operations */
-void *zip_file_open(void *zip_handle, const char *filename);
-int   zip_file_read(void *file_handle, void *buffer, size_t size);
-void  zip_file_close(void *file_handle);
+int         zip_file_stat(void *zip_handle, const char *filename, zipEntryInfo *info);
+const char *zip_file_map(void *zip_handle, const char *filename, size_t *size);
+void       *zip_file_open(void *zip_handle, const char *filename);
+int         zip_file_read(void *file_handle, void *buffer, size_t size);
+void        zip_file_close(void *file_handle);
+char       *zip_file_inflate(void       *zip_handle,
+                             const char *filename,
+                             bufferPool *pool,
+                             size_t     *length);
+
+/* Checkpoint index (memory-mapped deflated entries only) */
+int   zip_file_build_index(void *file_handle, inflateIndex *index);
+void *zip_file_open_at(void *zip_handle, const char *filename, const inflatePoint *point);
+
+/* Decompression backend and statistics */
+void                zip_set_inflate_backend(void *zip_handle, const inflateBackend *backend);
+const inflateStats *zip_inflate_stats(void *zip_handle);
 
 /* Utility functions */
 char *zip_read_file_to_string(void *zip_handle, const char *filename);
+char *zip_read_file_pooled(void       *zip_handle,
+                           const char *filename,
+                           bufferPool *pool,
+                           size_t     *length);
 
 #endif /* _ZIP_READER_H */
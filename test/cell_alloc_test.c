@@ -0,0 +1,184 @@
+/* Heap allocations per cell while a worksheet is converted.
+ *
+ * malloc, calloc and realloc are wrapped at link time (-Wl,--wrap) and counted
+ * for the project's own code. Two workbooks with the same shared strings and
+ * styles but a different number of rows are converted with each parser and a
+ * few output options; the larger one may only cost the handful of extra
+ * allocations its growing buffers need, never some per cell or per row.
+ */
+
+/* Standard library headers */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Project headers */
+#include "test_workbook.h"
+#include "xlsx2csv.h"
+
+#define SMALL_ROWS 50
+#define LARGE_ROWS 20000
+
+/* Allocations the large sheet may add: geometric growth of a few buffers */
+#define ALLOWED_EXTRA 16
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t count, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+
+static size_t allocations;
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+/* Rows with a cell of each type and of each style in test_styles */
+static const char sheet_start[] = TEST_WORKSHEET_START "<dimension ref=\"A1:K%d\"/><sheetData>";
+
+static const char sheet_row[] =
+    "<row r=\"%d\">"
+    "<c r=\"A%d\" t=\"s\"><v>%d</v></c>"
+    "<c r=\"B%d\"><v>%d</v></c>"
+    "<c r=\"C%d\"><v>%d.%03d</v></c>"
+    "<c r=\"D%d\" t=\"n\"><v>1.5E-%d</v></c>"
+    "<c r=\"E%d\" s=\"1\"><v>%d.25</v></c>"
+    "<c r=\"F%d\" s=\"2\"><v>%d.125</v></c>"
+    "<c r=\"G%d\" s=\"3\"><v>0.%d</v></c>"
+    "<c r=\"H%d\" s=\"4\"><v>-%d.5</v></c>"
+    "<c r=\"I%d\" t=\"b\"><v>%d</v></c>"
+    "<c r=\"J%d\" t=\"inlineStr\"><is><t>inline &quot;%d&quot;</t></is></c>"
+    "<c r=\"K%d\" t=\"str\"><v>tab\t%d</v></c>"
+    "</row>";
+
+static const char sheet_end[] = "</sheetData>" TEST_WORKSHEET_END;
+
+/* Worksheet XML with rows rows */
+static char *sheet_xml(int rows, size_t *len)
+{
+    size_t capacity = sizeof(sheet_start) + sizeof(sheet_end) + (size_t)rows * 1024;
+    char  *xml      = malloc(capacity);
+    if (!xml) {
+        return NULL;
+    }
+
+    size_t used = (size_t)snprintf(xml, capacity, sheet_start, rows);
+    for (int r = 1; r <= rows; r++) {
+        used += (size_t)snprintf(xml + used, capacity - used, sheet_row, r, r, r % 3, r, r, r,
+                                 r, r % 1000, r, r % 300 + 1, r, 40000 + r % 3000, r, r, r,
+                                 r % 100, r, r, r, r % 2, r, r, r, r);
+    }
+    used += (size_t)snprintf(xml + used, capacity - used, "%s", sheet_end);
+    *len = used;
+    return xml;
+}
+
+/* Test workbook with a sheet of rows rows */
+static bool write_rows_workbook(const char *path, int rows)
+{
+    size_t sheet_len = 0;
+    char  *sheet     = sheet_xml(rows, &sheet_len);
+    bool   ok        = sheet && write_workbook(path, sheet, sheet_len, false);
+    free(sheet);
+    return ok;
+}
+
+typedef struct {
+    const char *name;
+    bool        fast_scanner;
+    bool        lazy_strings;
+    bool        no_line_breaks;
+    bool        escape_strings;
+    quotingMode quoting;
+} testCase;
+
+/* Allocations made converting the sheet of the workbook at path, -1 on failure */
+static long count_conversion(const char *path, const testCase *test)
+{
+    xlsx2csvConverter *conv = xlsx2csv_create(path, NULL);
+    if (!conv) {
+        return -1;
+    }
+    conv->options.fast_scanner   = test->fast_scanner;
+    conv->options.lazy_strings   = test->lazy_strings;
+    conv->options.no_line_breaks = test->no_line_breaks;
+    conv->options.escape_strings = test->escape_strings;
+    conv->options.quoting        = test->quoting;
+
+    size_t before = allocations;
+    int    status = xlsx2csv_convert(conv, "/dev/null", 1, NULL);
+    size_t count  = allocations - before;
+
+    xlsx2csv_free(conv);
+    return status < 0 ? -1 : (long)count;
+}
+
+int main(void)
+{
+    static const testCase tests[] = {
+        {"expat",             false, false, false, false, QUOTE_MINIMAL},
+        {"fast scanner",      true,  false, false, false, QUOTE_MINIMAL},
+        {"lazy strings",      true,  true,  false, false, QUOTE_MINIMAL},
+        {"no line breaks",    false, false, true,  false, QUOTE_MINIMAL},
+        {"escape, quote all", true,  false, false, true,  QUOTE_ALL    },
+    };
+
+    char small[64];
+    char large[64];
+    snprintf(small, sizeof(small), "/tmp/cell_alloc_small_%d.xlsx", (int)getpid());
+    snprintf(large, sizeof(large), "/tmp/cell_alloc_large_%d.xlsx", (int)getpid());
+
+    int failures = 0;
+    if (!write_rows_workbook(small, SMALL_ROWS) || !write_rows_workbook(large, LARGE_ROWS)) {
+        fprintf(stderr, "could not write the test workbooks\n");
+        failures++;
+    }
+
+    for (size_t i = 0; failures == 0 && i < sizeof(tests) / sizeof(tests[0]); i++) {
+        long small_count = count_conversion(small, &tests[i]);
+        long large_count = count_conversion(large, &tests[i]);
+
+        printf("%-18s %5ld allocations for %d rows, %5ld for %d rows\n",
+               tests[i].name,
+               small_count,
+               SMALL_ROWS,
+               large_count,
+               LARGE_ROWS);
+        if (small_count < 0 || large_count < 0) {
+            fprintf(stderr, "FAIL %s: conversion failed\n", tests[i].name);
+            failures++;
+        } else if (large_count > small_count + ALLOWED_EXTRA) {
+            fprintf(stderr, "FAIL %s: allocations grow with the number of cells\n",
+                    tests[i].name);
+            failures++;
+        }
+    }
+
+    unlink(small);
+    unlink(large);
+
+    if (failures) {
+        return 1;
+    }
+    printf("cell allocations: ok\n");
+    return 0;
+}
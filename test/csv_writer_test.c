@@ -0,0 +1,272 @@
+/* Test of the output paths of src/csv_writer.c.
+ *
+ * Runs of empty fields and empty rows are written from prebuilt blocks; the
+ * output must be byte for byte what one csv_write_field(NULL) per field and
+ * one line terminator per row give, for every quoting mode, with the run at
+ * the start or in the middle of a row, and across block boundaries.
+ *
+ * The writer's own buffer goes to a file descriptor with write(2), or through
+ * the FILE for memory streams; both must give the same bytes for any buffer
+ * size, fields larger than the buffer included, and keep their place among
+ * what is written to the FILE directly before and after a flush.
+ */
+
+/* Standard library headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project headers */
+#include "csv_writer.h"
+
+static int failures = 0;
+
+/* Output of one writer session, captured in memory */
+typedef struct {
+    FILE      *fp;
+    char      *data;
+    size_t     len;
+    csvWriter *writer;
+} capture;
+
+static void capture_open(capture *c, xlsxOptions *options)
+{
+    c->data   = NULL;
+    c->len    = 0;
+    c->fp     = open_memstream(&c->data, &c->len);
+    c->writer = c->fp ? csv_writer_create(c->fp, options) : NULL;
+    if (!c->writer) {
+        fprintf(stderr, "cannot create a writer\n");
+        exit(1);
+    }
+}
+
+static void capture_close(capture *c)
+{
+    csv_writer_free(c->writer);
+    fclose(c->fp);
+}
+
+static void compare(const char *what, const capture *expected, const capture *actual)
+{
+    if (expected->len != actual->len || memcmp(expected->data, actual->data, expected->len)) {
+        fprintf(stderr,
+                "FAIL %s: %zu bytes expected, %zu written\n",
+                what,
+                expected->len,
+                actual->len);
+        failures++;
+    }
+}
+
+/* A row of field_count fields: an optional leading value, count empty fields, a value */
+static void check_fields(xlsxOptions *options, int count, bool leading)
+{
+    capture expected, actual;
+    capture_open(&expected, options);
+    capture_open(&actual, options);
+
+    int field_count = count + (leading ? 2 : 1);
+    csv_writer_set_field_count(expected.writer, field_count);
+    csv_writer_set_field_count(actual.writer, field_count);
+
+    if (leading) {
+        csv_write_field(expected.writer, "a");
+        csv_write_field(actual.writer, "a");
+    }
+    for (int i = 0; i < count; i++) {
+        csv_write_field(expected.writer, NULL);
+    }
+    csv_write_empty_fields(actual.writer, count);
+    csv_write_field(expected.writer, "z");
+    csv_write_field(actual.writer, "z");
+
+    /* A row of empty fields only, which QUOTE_MINIMAL quotes when it has one */
+    for (int width = 1; width <= 2; width++) {
+        csv_writer_reset_row(expected.writer);
+        csv_writer_reset_row(actual.writer);
+        csv_writer_set_field_count(expected.writer, width);
+        csv_writer_set_field_count(actual.writer, width);
+        for (int i = 0; i < width; i++) {
+            csv_write_field(expected.writer, NULL);
+        }
+        csv_write_empty_fields(actual.writer, width);
+    }
+
+    capture_close(&expected);
+    capture_close(&actual);
+
+    char what[96];
+    snprintf(what,
+             sizeof(what),
+             "%d empty fields, quoting %d, delimiter %d%s",
+             count,
+             options->quoting,
+             options->delimiter,
+             leading ? ", after a field" : "");
+    compare(what, &expected, &actual);
+    free(expected.data);
+    free(actual.data);
+}
+
+static void check_rows(xlsxOptions *options, int count)
+{
+    capture expected, actual;
+    capture_open(&expected, options);
+    capture_open(&actual, options);
+
+    for (int i = 0; i < count; i++) {
+        fputs(options->lineterminator, expected.fp);
+    }
+    csv_write_empty_rows(actual.writer, count);
+    for (int i = 0; i < count; i++) {
+        fputs(options->lineterminator, expected.fp);
+    }
+    csv_writer_flush(actual.writer);
+    csv_write_repeated(actual.fp, options->lineterminator, (size_t)count);
+
+    capture_close(&expected);
+    capture_close(&actual);
+
+    char what[96];
+    snprintf(what,
+             sizeof(what),
+             "%d empty rows, terminator of %zu bytes",
+             count,
+             strlen(options->lineterminator));
+    compare(what, &expected, &actual);
+    free(expected.data);
+    free(actual.data);
+}
+
+/* Rows of fields from 0 to 20000 bytes, some with quotes and delimiters */
+static void write_rows(csvWriter *writer, unsigned seed)
+{
+    static const char filler[] = "ab\",x";
+    static char       field[20001];
+    for (int row = 0; row < 200; row++) {
+        csv_writer_reset_row(writer);
+        csv_writer_set_field_count(writer, 5);
+        for (int col = 0; col < 5; col++) {
+            seed       = seed * 1103515245 + 12345;
+            size_t len = (seed >> 8) % 4 == 0 ? (seed >> 4) % sizeof(field) : (seed >> 4) % 12;
+            for (size_t i = 0; i < len; i++) {
+                field[i] = filler[(seed >> (i % 16)) % 5];
+            }
+            field[len] = '\0';
+            csv_write_field(writer, field);
+        }
+        csv_writer_end_row(writer);
+    }
+}
+
+/* A writer on a file, with text written to the FILE around it */
+static char *write_to_file(xlsxOptions *options, bool file, size_t *len)
+{
+    char *data = NULL;
+    FILE *fp   = file ? tmpfile() : open_memstream(&data, len);
+    if (!fp) {
+        fprintf(stderr, "cannot open a stream\n");
+        exit(1);
+    }
+
+    fputs("before\n", fp);
+    csvWriter *writer = csv_writer_create(fp, options);
+    write_rows(writer, 1);
+    if (csv_writer_flush(writer) < 0) {
+        failures++;
+    }
+    fputs("between\n", fp);
+    write_rows(writer, 2);
+    csv_writer_free(writer);
+    fputs("after\n", fp);
+
+    if (file) {
+        long size = ftell(fp);
+        rewind(fp);
+        data = malloc((size_t)size);
+        *len = fread(data, 1, (size_t)size, fp);
+    }
+    fclose(fp);
+    return data;
+}
+
+static void check_output_paths(void)
+{
+    static const int sizes_kb[] = {1, 4, 5, 64, 0};
+
+    xlsxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.quoting        = QUOTE_MINIMAL;
+    options.delimiter      = ',';
+    options.lineterminator = "\r\n";
+
+    size_t expected_len;
+    char  *expected = write_to_file(&options, false, &expected_len);
+
+    for (size_t i = 0; i < sizeof(sizes_kb) / sizeof(sizes_kb[0]); i++) {
+        options.write_buffer_kb = sizes_kb[i];
+        for (int file = 0; file <= 1; file++) {
+            size_t len;
+            char  *data = write_to_file(&options, file, &len);
+            if (len != expected_len || memcmp(data, expected, len) != 0) {
+                fprintf(stderr,
+                        "FAIL %d KB buffer to a %s: %zu bytes expected, %zu written\n",
+                        sizes_kb[i],
+                        file ? "file" : "memory stream",
+                        expected_len,
+                        len);
+                failures++;
+            }
+            free(data);
+        }
+    }
+    free(expected);
+}
+
+int main(void)
+{
+    static const int         counts[]   = {0, 1, 2, 3, 1364, 1365, 1366, 4095, 4096, 4097, 20000};
+    static const quotingMode quotings[] = {QUOTE_MINIMAL, QUOTE_ALL, QUOTE_NONNUMERIC, QUOTE_NONE};
+    static const char        delims[]   = {',', ';', '\t'};
+
+    char long_terminator[5001];
+    memset(long_terminator, '~', sizeof(long_terminator) - 1);
+    long_terminator[sizeof(long_terminator) - 1] = '\0';
+    char *terminators[] = {"\n", "\r\n", "", long_terminator};
+
+    size_t count_total = sizeof(counts) / sizeof(counts[0]);
+
+    xlsxOptions options;
+    memset(&options, 0, sizeof(options));
+
+    for (size_t q = 0; q < sizeof(quotings) / sizeof(quotings[0]); q++) {
+        for (size_t d = 0; d < sizeof(delims); d++) {
+            options.quoting        = quotings[q];
+            options.delimiter      = delims[d];
+            options.lineterminator = "\n";
+            for (size_t c = 0; c < count_total; c++) {
+                check_fields(&options, counts[c], false);
+                check_fields(&options, counts[c], true);
+            }
+        }
+    }
+
+    options.quoting   = QUOTE_MINIMAL;
+    options.delimiter = ',';
+    for (size_t t = 0; t < sizeof(terminators) / sizeof(terminators[0]); t++) {
+        options.lineterminator = terminators[t];
+        for (size_t c = 0; c < count_total; c++) {
+            check_rows(&options, counts[c]);
+        }
+    }
+
+    check_output_paths();
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("csv_writer: runs and buffered output match field by field output\n");
+    return 0;
+}
@@ -0,0 +1,177 @@
+/* Differential test of src/dtoa.c against snprintf and strtod.
+ *
+ * Random doubles, drawn both as raw bit patterns and as the short decimals,
+ * integers, ties and powers of ten spreadsheets are full of, must give the
+ * same text as "%.15g" and "%.*f", and the shortest form must read back and
+ * be no longer than the shortest "%.*g" that does.
+ */
+
+/* Standard library headers */
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project headers */
+#include "dtoa.h"
+
+#define ITERATIONS 100000
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void)
+{
+    /* xorshift64* */
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double random_double(void)
+{
+    uint64_t r = next_random();
+    double   value;
+
+    switch (r % 6) {
+        case 0: {
+            /* Any bit pattern */
+            uint64_t bits = next_random();
+            memcpy(&value, &bits, sizeof(value));
+            break;
+        }
+        case 1:
+            /* Decimals with a few places, as typed into a cell */
+            value = (double)(int64_t)(next_random() % 200000000000ULL - 100000000000LL) /
+                    pow(10, (double)(next_random() % 9));
+            break;
+        case 2:
+            /* Halfway cases for the fixed forms */
+            value = ((double)(next_random() % 2000000) + 0.5) / pow(10, (double)(next_random() % 7));
+            break;
+        case 3:
+            /* Around powers of ten */
+            value = pow(10, (double)(int)(next_random() % 40) - 20);
+            value = nextafter(value, (r >> 8) & 1 ? INFINITY : 0.0);
+            break;
+        case 4:
+            /* Integers */
+            value = (double)(int64_t)(next_random() >> (next_random() % 64));
+            break;
+        default:
+            /* Uniform magnitudes across the range cells use */
+            value = (double)(next_random() >> 11) / 9007199254740992.0 *
+                    pow(10, (double)(int)(next_random() % 24) - 8);
+            break;
+    }
+    return (r >> 9) & 1 ? -value : value;
+}
+
+/* Length of the shortest "%.*g" that reads back */
+static int shortest_reference(double value)
+{
+    char buffer[64];
+    for (int precision = 1; precision < 17; precision++) {
+        snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (strtod(buffer, NULL) == value) {
+            return precision;
+        }
+    }
+    return 17;
+}
+
+static int significant_digits(const char *text)
+{
+    int  count   = 0;
+    int  zeros   = 0;
+    bool leading = true;
+    for (const char *p = text; *p && *p != 'e'; p++) {
+        if (*p < '0' || *p > '9') {
+            continue;
+        }
+        if (leading && *p == '0') {
+            continue;
+        }
+        leading = false;
+        if (*p == '0') {
+            zeros++;
+        } else {
+            count += zeros + 1;
+            zeros = 0;
+        }
+    }
+    return count ? count : 1;
+}
+
+static int failures = 0;
+
+static void report(const char *what, double value, const char *got, const char *expected)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    fprintf(stderr,
+            "FAIL %s 0x%016" PRIx64 ": got \"%s\", expected \"%s\"\n",
+            what,
+            bits,
+            got,
+            expected);
+    failures++;
+}
+
+static void check(double value)
+{
+    char got[DTOA_BUFFER_SIZE];
+    char expected[DTOA_BUFFER_SIZE];
+
+    dtoa_general(value, got);
+    snprintf(expected, sizeof(expected), "%.15g", value);
+    if (strcmp(got, expected) != 0) {
+        report("%.15g", value, got, expected);
+    }
+
+    for (int decimals = 0; decimals <= 9; decimals += 3) {
+        dtoa_fixed(value, decimals, got);
+        snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+        if (strcmp(got, expected) != 0) {
+            report("%.*f", value, got, expected);
+        }
+    }
+
+    if (isnan(value)) {
+        return;
+    }
+    dtoa_shortest(value, got);
+    snprintf(expected, sizeof(expected), "%.17g", value);
+    if (strtod(got, NULL) != value || significant_digits(got) > shortest_reference(value)) {
+        report("shortest", value, got, expected);
+    }
+}
+
+int main(void)
+{
+    static const double fixed_cases[] = {0.0,     -0.0, 0.5,    1.5,    2.5,    0.1, 0.3,
+                                         1e-4,    1e15, 1e-5,   1e16,   123.456, 5e-324,
+                                         1e300,   1e-300, 999999999999999.9, 0.000099999999999999999,
+                                         9.9999999999999995e-5, 2.5e-7, 0.0000005};
+
+    for (size_t i = 0; i < sizeof(fixed_cases) / sizeof(fixed_cases[0]); i++) {
+        check(fixed_cases[i]);
+        check(-fixed_cases[i]);
+    }
+    for (int i = 0; i < ITERATIONS; i++) {
+        check(random_double());
+        if (failures > 20) {
+            break;
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("dtoa: all conversions match\n");
+    return 0;
+}
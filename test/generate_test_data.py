@@ -9,6 +9,7 @@ from openpyxl.styles import numbers
 from datetime import datetime, date, time, timedelta
 import os
 import random
+import zipfile
 
 # ============================================================================
 # 单元测试数据 - Unit Test Data
@@ -687,6 +688,200 @@ def create_excel_errors_test():
     print("✓ excel_errors.xlsx")
 
 
+def write_raw_xlsx(path, sheets, shared_strings=None):
+    """Write a workbook from raw worksheet XML, for layouts openpyxl does not produce
+
+    sheets maps each sheet name to the XML inside <worksheet>, or to a (doctype, xml) pair
+    for a worksheet that starts with a document type declaration. shared_strings lists
+    the XML inside each <si> of xl/sharedStrings.xml (openpyxl writes inline strings only).
+    """
+    main_ns = "http://schemas.openxmlformats.org/spreadsheetml/2006/main"
+    rel_ns = "http://schemas.openxmlformats.org/officeDocument/2006/relationships"
+    overrides = "".join(
+        f'<Override PartName="/xl/worksheets/sheet{i}.xml" ContentType="application/'
+        'vnd.openxmlformats-officedocument.spreadsheetml.worksheet+xml"/>'
+        for i in range(1, len(sheets) + 1)
+    )
+    sheet_list = "".join(
+        f'<sheet name="{name}" sheetId="{i}" r:id="rId{i}"/>'
+        for i, name in enumerate(sheets, 1)
+    )
+    relationships = "".join(
+        f'<Relationship Id="rId{i}" Type="{rel_ns}/worksheet" Target="worksheets/sheet{i}.xml"/>'
+        for i in range(1, len(sheets) + 1)
+    )
+    if shared_strings is not None:
+        overrides += (
+            '<Override PartName="/xl/sharedStrings.xml" ContentType="application/'
+            'vnd.openxmlformats-officedocument.spreadsheetml.sharedStrings+xml"/>'
+        )
+        relationships += (
+            f'<Relationship Id="rId{len(sheets) + 1}" Type="{rel_ns}/sharedStrings" '
+            'Target="sharedStrings.xml"/>'
+        )
+    parts = {
+        "[Content_Types].xml": (
+            '<?xml version="1.0" encoding="UTF-8"?>'
+            '<Types xmlns="http://schemas.openxmlformats.org/package/2006/content-types">'
+            '<Override PartName="/xl/workbook.xml" ContentType="application/'
+            f'vnd.openxmlformats-officedocument.spreadsheetml.sheet.main+xml"/>{overrides}</Types>'
+        ),
+        "xl/workbook.xml": (
+            f'<?xml version="1.0" encoding="UTF-8"?><workbook xmlns="{main_ns}" xmlns:r="{rel_ns}">'
+            f"<sheets>{sheet_list}</sheets></workbook>"
+        ),
+        "xl/_rels/workbook.xml.rels": (
+            '<?xml version="1.0" encoding="UTF-8"?>'
+            '<Relationships xmlns="http://schemas.openxmlformats.org/package/2006/relationships">'
+            f"{relationships}</Relationships>"
+        ),
+    }
+    for i, sheet in enumerate(sheets.values(), 1):
+        doctype, sheet_xml = sheet if isinstance(sheet, tuple) else ("", sheet)
+        parts[f"xl/worksheets/sheet{i}.xml"] = (
+            f'<?xml version="1.0" encoding="UTF-8"?>{doctype}<worksheet xmlns="{main_ns}">'
+            f"{sheet_xml}</worksheet>"
+        )
+    if shared_strings is not None:
+        items = "".join(f"<si>{si}</si>" for si in shared_strings)
+        parts["xl/sharedStrings.xml"] = (
+            f'<?xml version="1.0" encoding="UTF-8"?><sst xmlns="{main_ns}" '
+            f'count="{len(shared_strings)}" uniqueCount="{len(shared_strings)}">{items}</sst>'
+        )
+    with zipfile.ZipFile(path, "w", zipfile.ZIP_DEFLATED) as z:
+        for name, xml in parts.items():
+            info = zipfile.ZipInfo(name, date_time=(2020, 1, 1, 0, 0, 0))
+            z.writestr(info, xml, compress_type=zipfile.ZIP_DEFLATED)
+
+
+def create_implicit_columns_test():
+    """Test cells without an r attribute (openpyxl always writes r, so the XML is built here)"""
+    write_raw_xlsx(
+        "test_data/implicit_columns.xlsx",
+        {
+            "Implicit": "<sheetData>"
+            # No r at all: consecutive columns from A
+            '<row r="1"><c><v>1</v></c><c><v>2</v></c><c><v>3</v></c></row>'
+            # Mixed: each cell without r follows the cell before it
+            '<row r="2"><c r="C2"><v>1</v></c><c><v>2</v></c>'
+            '<c r="B2"><v>3</v></c><c><v>4</v></c></row>'
+            '<row r="3"><c r="B3" t="str"><v>x</v></c><c t="e"><v>#N/A</v></c>'
+            '<c t="inlineStr"><is><t>inline</t></is></c></row>'
+            "</sheetData>",
+        },
+    )
+    print("✓ implicit_columns.xlsx")
+
+
+def create_wide_columns_test():
+    """Test columns past AMJ (the 1024th), up to the dimension's last column"""
+    write_raw_xlsx(
+        "test_data/wide_columns.xlsx",
+        {
+            "Wide": '<dimension ref="A1:AMP3"/><sheetData>'
+            '<row r="1"><c r="A1"><v>1</v></c><c r="AMK1" t="str"><v>past 1024</v></c></row>'
+            '<row r="2"><c r="B2"><v>2</v></c></row>'
+            '<row r="3"><c r="AMP3"><v>3</v></c></row>'
+            "</sheetData>",
+        },
+    )
+    print("✓ wide_columns.xlsx")
+
+
+def create_scanner_fallbacks_test():
+    """Test markup --fast-scanner hands to expat, one kind per sheet between plain rows"""
+    plain_before = '<row r="1"><c r="A1" t="str"><v>before</v></c><c r="B1"><v>1.5</v></c></row>'
+    plain_after = '<row r="3"><c r="A3" t="str"><v>after</v></c><c r="C3"><v>3</v></c></row>'
+    many_atts = "".join(f' x{i}="{i}"' for i in range(17))
+    fallbacks = {
+        "Comments": '<row r="2"><!-- row note --><c r="A2"><v>2</v></c>'
+        "<!-- cell note --><c r=\"B2\" t=\"str\"><v>x<!-- in value -->y</v></c></row>"
+        "<!-- between rows -->",
+        "CDATA": '<row r="2"><c r="A2" t="str"><v><![CDATA[a<b & "c"]]></v></c>'
+        '<c r="B2" t="inlineStr"><is><t><![CDATA[]]]]><![CDATA[>]]></t></is></c></row>',
+        "References": '<row r="2"><c r="A2" t="str"><v>&lt;&amp;&gt;&quot;&apos;</v></c>'
+        '<c r="B2" t="str"><v>&#65;&#x263A;&#x1F600;</v></c>'
+        '<c r="C2" t="str"><v>line&#13;&#10;break</v></c></row>',
+        "Attributes": f'<row r="2"{many_atts}><c r="A2"><v>2</v></c>'
+        f'<c r="B2" t="str"{many_atts}><v>many</v></c></row>',
+    }
+    sheets = {
+        name: f"<sheetData>{plain_before}{rows}{plain_after}</sheetData>"
+        for name, rows in fallbacks.items()
+    }
+    # A document type declaration sends the whole sheet to expat, entities included
+    sheets["Entities"] = (
+        '<!DOCTYPE worksheet [<!ENTITY company "ACME &amp; Co"><!ENTITY year "2024">]>',
+        f'<sheetData>{plain_before}<row r="2"><c r="A2" t="str"><v>&company;</v></c>'
+        f"<c r=\"B2\"><v>&year;</v></c></row>{plain_after}</sheetData>",
+    )
+    write_raw_xlsx("test_data/scanner_fallbacks.xlsx", sheets)
+    print("✓ scanner_fallbacks.xlsx")
+
+
+def create_shared_strings_test():
+    """Test a shared string table: rich text runs, phonetic runs, whitespace and escapes"""
+    strings = [
+        "<t>plain</t>",
+        '<r><rPr><b/><sz val="11"/></rPr><t>Bold</t></r>'
+        '<r><t xml:space="preserve"> and plain</t></r>',
+        '<t>東京</t><rPh sb="0" eb="2"><t>トウキョウ</t></rPh><phoneticPr fontId="1"/>',
+        '<r><t>日本</t></r><r><rPr><i/></rPr><t>語</t></r>'
+        '<rPh sb="0" eb="2"><t>ニホン</t></rPh><rPh sb="2" eb="3"><t>ゴ</t></rPh>',
+        '<rPh sb="0" eb="1"><t>only phonetic</t></rPh>',
+        '<t xml:space="preserve">  padded  </t>',
+        "<t/>",
+        "",
+        '<t>a &lt;b&gt; &amp; "c", d</t>',
+        "<t>line one\nline two\ttab&#13;</t>",
+        "<t>00123</t>",
+        "<t>emoji 😀 and ü</t>",
+    ]
+    # Each string once in order, then backwards and repeated, as a sheet references them
+    count = len(strings)
+    rows = "".join(
+        f'<row r="{i + 1}"><c r="A{i + 1}" t="s"><v>{i}</v></c>'
+        f'<c r="B{i + 1}" t="s"><v>{count - 1 - i}</v></c>'
+        f'<c r="C{i + 1}"><v>{i}</v></c><c r="D{i + 1}" t="s"><v>{i // 2}</v></c></row>'
+        for i in range(count)
+    )
+    write_raw_xlsx(
+        "test_data/shared_strings.xlsx",
+        {"Strings": f"<sheetData>{rows}</sheetData>"},
+        strings,
+    )
+    print("✓ shared_strings.xlsx")
+
+
+def create_shared_strings_large_test():
+    """Test a shared string table larger than a 1 MB --strings-memory limit spills"""
+    words = ["alpha", "beta", "gamma, delta", 'say "hi"', "ünïcödé", "東京", "line\nbreak"]
+    strings = []
+    for i in range(40000):
+        text = f"String {i:05d} " + " ".join(words[(i + k) % len(words)] for k in range(i % 9))
+        if i % 11 == 0:
+            strings.append(
+                f'<r><rPr><b/></rPr><t>{text}</t></r><r><t xml:space="preserve"> +</t></r>'
+            )
+        elif i % 13 == 0:
+            strings.append(f'<t>{text}</t><rPh sb="0" eb="1"><t>フリガナ</t></rPh>')
+        else:
+            strings.append(f"<t>{text.replace('&', '&amp;')}</t>")
+    # Every seventh string, with the one at the other end of the table beside it
+    count = len(strings)
+    rows = "".join(
+        f'<row r="{r}"><c r="A{r}" t="s"><v>{i}</v></c>'
+        f'<c r="B{r}" t="s"><v>{count - 1 - i}</v></c></row>'
+        for r, i in enumerate(range(0, count, 7), start=1)
+    )
+    write_raw_xlsx(
+        "test_data/shared_strings_large.xlsx",
+        {"Strings": f"<sheetData>{rows}</sheetData>"},
+        strings,
+    )
+    print("✓ shared_strings_large.xlsx")
+
+
 # ============================================================================
 # 主函数 - Main
 # ============================================================================
@@ -711,6 +906,11 @@ def main():
     create_multisheet_complex_test()
     create_number_formats_test()
     create_excel_errors_test()  # 新增测试
+    create_implicit_columns_test()
+    create_wide_columns_test()
+    create_scanner_fallbacks_test()
+    create_shared_strings_test()
+    create_shared_strings_large_test()
 
     print("\n=== 真实场景数据 ===")
     create_stock_data_1107()
@@ -721,9 +921,9 @@ def main():
     create_portfolio_tracking()
 
     print("\n✓ 所有测试数据生成完成！")
-    print("  - 单元测试: 12个文件")  # 更新数量
+    print("  - 单元测试: 17个文件")  # 更新数量
     print("  - 真实场景: 6个文件")
-    print("  - 总计: 18个测试文件")  # 更新数量
+    print("  - 总计: 23个测试文件")  # 更新数量
 
 
 if __name__ == "__main__":
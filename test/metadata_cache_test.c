@@ -0,0 +1,303 @@
+/* Cache files of src/metadata_cache.c that must not be trusted.
+ *
+ * A workbook is converted once without a cache to get the expected CSV, then
+ * with a cache directory. The cache file written by that run must be used as
+ * is by the next one; a file that no longer matches the workbook, or that is
+ * truncated, carries a string outside its arena, an unknown format type, bytes
+ * past its end or another layout, must be rejected and replaced, with the CSV
+ * unchanged. Runs started together must leave one valid file and no temporary
+ * ones behind.
+ */
+
+/* Standard library headers */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Project headers */
+#include "test_workbook.h"
+#include "xlsx2csv.h"
+
+#define CONCURRENT_RUNS 8
+
+/* Offsets in the cache file: magic, 11 key fields, then the workbook path */
+#define CACHE_LAYOUT_OFFSET 24
+#define CACHE_PATH_LEN      88
+#define CACHE_PATH          96
+
+static int failures = 0;
+
+/* Shared strings, dates and numbers in the custom formats of test_styles */
+static const char sheet[] =
+    TEST_WORKSHEET_START
+    "<sheetData>"
+    "<row r=\"1\"><c r=\"A1\" t=\"s\"><v>0</v></c><c r=\"B1\" s=\"5\"><v>45306</v></c>"
+    "<c r=\"C1\" s=\"4\"><v>1.5</v></c></row>"
+    "<row r=\"2\"><c r=\"A2\" t=\"s\"><v>1</v></c><c r=\"B2\" s=\"5\"><v>45307</v></c>"
+    "<c r=\"C2\" s=\"4\"><v>2.25</v></c></row>"
+    "<row r=\"3\"><c r=\"A3\" t=\"s\"><v>2</v></c><c r=\"B3\" s=\"5\"><v>1</v></c>"
+    "<c r=\"C3\"><v>3</v></c></row>"
+    "</sheetData>" TEST_WORKSHEET_END;
+
+static bool write_file(const char *path, const char *data, size_t len)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, len, fp) == len;
+    return fclose(fp) == 0 && ok;
+}
+
+/* CSV of the first sheet, with the cache in cache_dir (none if NULL) */
+static char *convert(const char *book, char *cache_dir, const char *csv, size_t *len)
+{
+    xlsxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.delimiter        = ',';
+    options.quoting          = QUOTE_MINIMAL;
+    options.sheetdelimiter   = "--------";
+    options.outputencoding   = "utf-8";
+    options.lineterminator   = "\n";
+    options.skip_hidden_rows = true;
+    options.jobs             = 1;
+    options.write_buffer_kb  = 1024;
+    options.cache_dir        = cache_dir;
+
+    xlsx2csvConverter *conv = xlsx2csv_create(book, &options);
+    if (!conv) {
+        return NULL;
+    }
+    int status = xlsx2csv_convert(conv, csv, 1, NULL);
+    xlsx2csv_free(conv);
+    return status < 0 ? NULL : read_file(csv, len);
+}
+
+/* The one file in the cache directory; false if there are none or several */
+static bool cache_file(const char *dir, char *path, size_t size)
+{
+    DIR *d = opendir(dir);
+    if (!d) {
+        return false;
+    }
+    int            count = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] != '.') {
+            snprintf(path, size, "%s/%s", dir, ent->d_name);
+            count++;
+        }
+    }
+    closedir(d);
+    return count == 1;
+}
+
+static ino_t inode(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_ino : 0;
+}
+
+typedef struct {
+    const char *book;
+    char       *cache_dir;
+    const char *csv;
+    char       *expected;
+    size_t      expected_len;
+} testRun;
+
+/* Convert with the cache and compare; the cache file after the run, or false */
+static bool run(const testRun *t, const char *what, char *path, size_t size)
+{
+    size_t len = 0;
+    char  *csv = convert(t->book, t->cache_dir, t->csv, &len);
+    bool   ok  = csv && len == t->expected_len && memcmp(csv, t->expected, len) == 0;
+    free(csv);
+    if (!ok) {
+        fprintf(stderr, "FAIL %s: the CSV differs from the uncached conversion\n", what);
+        failures++;
+        return false;
+    }
+    size_t path_len = cache_file(t->cache_dir, path, size) ? strlen(path) : 0;
+    if (path_len < 5 || strcmp(path + path_len - 5, ".meta") != 0) {
+        fprintf(stderr, "FAIL %s: the cache directory does not hold exactly one cache file\n",
+                what);
+        failures++;
+        return false;
+    }
+    return true;
+}
+
+/* Damage the cache file, then check it is replaced by one the next run uses as is */
+static void check_rejected(const testRun *t, const char *what, const char *path, char *data,
+                           size_t len)
+{
+    if (!write_file(path, data, len)) {
+        fprintf(stderr, "FAIL %s: cannot write the cache file\n", what);
+        failures++;
+        return;
+    }
+
+    char  rebuilt[512];
+    ino_t damaged = inode(path);
+    if (!run(t, what, rebuilt, sizeof(rebuilt))) {
+        return;
+    }
+    ino_t replaced = inode(rebuilt);
+    if (replaced == damaged) {
+        fprintf(stderr, "FAIL %s: the cache file was not rebuilt\n", what);
+        failures++;
+        return;
+    }
+    if (run(t, what, rebuilt, sizeof(rebuilt)) && inode(rebuilt) != replaced) {
+        fprintf(stderr, "FAIL %s: the rebuilt cache file is not used\n", what);
+        failures++;
+    }
+}
+
+static size_t pad8(size_t len)
+{
+    return (len + 7) & ~(size_t)7;
+}
+
+static uint64_t get_u64(const char *data, size_t offset)
+{
+    uint64_t value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+static void put_u64(char *data, size_t offset, uint64_t value)
+{
+    memcpy(data + offset, &value, sizeof(value));
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/metadata_cache_test_XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+    char book[64], cache_dir[64], csv[64];
+    snprintf(book, sizeof(book), "%s/book.xlsx", dir);
+    snprintf(cache_dir, sizeof(cache_dir), "%s/cache", dir);
+    snprintf(csv, sizeof(csv), "%s/out.csv", dir);
+    mkdir(cache_dir, 0700);
+
+    testRun t = {book, cache_dir, csv, NULL, 0};
+    if (write_workbook(book, sheet, strlen(sheet), false)) {
+        t.expected = convert(book, NULL, csv, &t.expected_len);
+    }
+    if (!t.expected || !strstr(t.expected, "with, comma") || !strstr(t.expected, "2024-01-15")) {
+        fprintf(stderr, "cannot convert the test workbook\n");
+        return 1;
+    }
+
+    /* Written by the first run, used as is by the second */
+    char  path[512];
+    ino_t written = 0;
+    if (run(&t, "first run", path, sizeof(path))) {
+        written = inode(path);
+        if (run(&t, "second run", path, sizeof(path)) && inode(path) != written) {
+            fprintf(stderr, "FAIL second run: a valid cache file was rebuilt\n");
+            failures++;
+        }
+    }
+
+    size_t len  = 0;
+    char  *good = written ? read_file(path, &len) : NULL;
+    if (good) {
+        char  *data     = malloc(len + 8);
+        size_t path_len = (size_t)get_u64(good, CACHE_PATH_LEN);
+        size_t entries  = CACHE_PATH + pad8(path_len) + 16;
+        size_t count    = (size_t)get_u64(good, entries - 16);
+        size_t arena    = (size_t)get_u64(good, entries - 8);
+        size_t formats  = entries + pad8(count * sizeof(sharedString)) + pad8(arena);
+
+        /* The workbook changed since the cache was written */
+        struct timespec times[2] = {{0, UTIME_OMIT}, {12345, 0}};
+        utimensat(AT_FDCWD, book, times, 0);
+        check_rejected(&t, "stale workbook", path, good, len);
+        free(good);
+        good = read_file(path, &len);
+
+        check_rejected(&t, "truncated", path, good, len / 2);
+
+        memcpy(data, good, len);
+        put_u64(data, entries, arena);
+        check_rejected(&t, "string outside the arena", path, data, len);
+
+        memcpy(data, good, len);
+        put_u64(data, entries + 8, arena);
+        check_rejected(&t, "string past the arena", path, data, len);
+
+        memcpy(data, good, len);
+        put_u64(data, formats + 16, 99);
+        check_rejected(&t, "unknown format type", path, data, len);
+
+        memcpy(data, good, len);
+        memset(data + len, 0, 8);
+        check_rejected(&t, "trailing bytes", path, data, len + 8);
+
+        memcpy(data, good, len);
+        put_u64(data, CACHE_LAYOUT_OFFSET, sizeof(sharedString) + 8);
+        check_rejected(&t, "other layout", path, data, len);
+
+        memcpy(data, good, len);
+        data[0] = 'Y';
+        check_rejected(&t, "bad magic", path, data, len);
+
+        free(data);
+        free(good);
+    }
+
+    /* Runs writing the cache at the same time */
+    unlink(path);
+    for (int i = 0; i < CONCURRENT_RUNS; i++) {
+        if (fork() == 0) {
+            char own_csv[80];
+            snprintf(own_csv, sizeof(own_csv), "%s.%d", csv, i);
+            size_t own_len = 0;
+            char  *own     = convert(book, cache_dir, own_csv, &own_len);
+            bool   ok = own && own_len == t.expected_len && memcmp(own, t.expected, own_len) == 0;
+            unlink(own_csv);
+            _exit(ok ? 0 : 1);
+        }
+    }
+    for (int i = 0; i < CONCURRENT_RUNS; i++) {
+        int status = 0;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "FAIL concurrent runs: a conversion failed\n");
+            failures++;
+        }
+    }
+    if (run(&t, "after concurrent runs", path, sizeof(path))) {
+        ino_t shared = inode(path);
+        if (run(&t, "after concurrent runs", path, sizeof(path)) && inode(path) != shared) {
+            fprintf(stderr, "FAIL concurrent runs: the cache file left behind is not used\n");
+            failures++;
+        }
+    }
+
+    unlink(path);
+    unlink(csv);
+    unlink(book);
+    rmdir(cache_dir);
+    rmdir(dir);
+    free(t.expected);
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("metadata_cache: damaged and stale cache files are rebuilt\n");
+    return 0;
+}
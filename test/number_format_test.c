@@ -0,0 +1,162 @@
+/* Table test of src/number_format.c.
+ *
+ * Each format code is compiled once and rendered for a few values; the text
+ * must be what Excel shows in the cell. The table covers sections and their
+ * conditions, digit grouping and scaling commas, percent and _ padding, quoted
+ * and escaped literals, scientific notation, elapsed and 12-hour times with
+ * fractions of a second, and the 1900 calendar around its first serials and
+ * its 1900-02-29. Values a format cannot show (negative dates) must fail so
+ * the caller falls back to its own rendering.
+ */
+
+/* Standard library headers */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Project headers */
+#include "number_format.h"
+
+typedef struct {
+    const char *code;
+    double      value;
+    bool        date1904;
+    const char *expected; /* NULL: the format cannot show the value */
+} formatCase;
+
+static int failures = 0;
+
+static const formatCase cases[] = {
+    /* Sections and conditions */
+    {"[<1000]0;0.0,\"K\"",            999,               false, "999"        },
+    {"[<1000]0;0.0,\"K\"",            1500,              false, "1.5K"       },
+    {"[<1000]0;0.0,\"K\"",            12345,             false, "12.3K"      },
+    {"[<1000]0;0.0,\"K\"",            -5,                false, "-5"         },
+    {"[>=100][Red]0;[Blue]0.00",      150,               false, "150"        },
+    {"[>=100][Red]0;[Blue]0.00",      2.5,               false, "2.50"       },
+    {"0;-0;\"zero\"",                 0,                 false, "zero"       },
+    {"0;-0;\"zero\"",                 -3,                false, "-3"         },
+    {"0.00;(0.00)",                   -1.5,              false, "(1.50)"     },
+    {"0.00;(0.00)",                   1.5,               false, "1.50"       },
+    {"0;0;0;\"text\"",                7,                 false, "7"          },
+
+    /* Grouping and scaling commas */
+    {"#,##0",                         1234567,           false, "1,234,567"  },
+    {"#,##0",                         0,                 false, "0"          },
+    {"#,##0",                         -1234.5,           false, "-1,235"     },
+    {"#,##0.00",                      1234.567,          false, "1,234.57"   },
+    {"#,##0.00",                      999.999,           false, "1,000.00"   },
+    {"#,##0,",                        1234567,           false, "1,235"      },
+    {"0.0,,\"M\"",                    1234567,           false, "1.2M"       },
+    {"#",                             0,                 false, ""           },
+    {"000",                           7,                 false, "007"        },
+    {"0.0",                           0.05,              false, "0.1"        },
+    {"0.00",                          2.675,             false, "2.68"       },
+    {"#.##",                          3,                 false, "3."         },
+
+    /* Percent and padding */
+    {"0%",                            0.256,             false, "26%"        },
+    {"0.00%",                         0.12345,           false, "12.35%"     },
+    {"0.0%",                          -0.5,              false, "-50.0%"     },
+    {"#,##0_);(#,##0)",               1234,              false, "1,234 "     },
+    {"#,##0_);(#,##0)",               -1234,             false, "(1,234)"    },
+    {"0.00_-",                        1,                 false, "1.00 "      },
+
+    /* Quoted and escaped literals */
+    {"\"$\"#,##0.00",                 5,                 false, "$5.00"      },
+    {"\\$0.00",                       5,                 false, "$5.00"      },
+    {"0\" units\"",                   3,                 false, "3 units"    },
+    {"0\\ \\k\\g",                    3,                 false, "3 kg"       },
+    {"$#,##0",                        1000,              false, "$1,000"     },
+    {"\"#,0;\"0",                     4,                 false, "#,0;4"      },
+
+    /* Scientific */
+    {"0.00E+00",                      12345,             false, "1.23E+04"   },
+    {"0.00E+00",                      0.000123,          false, "1.23E-04"   },
+    {"0.00E+00",                      0,                 false, "0.00E+00"   },
+    {"0.00E+00",                      -12345,            false, "-1.23E+04"  },
+    {"0.0E-0",                        12345,             false, "1.2E4"      },
+
+    /* Dates */
+    {"yyyy-mm-dd",                    45306,             false, "2024-01-15" },
+    {"d-mmm-yy",                      45306,             false, "15-Jan-24"  },
+    {"dddd, mmmm d, yyyy",            45306,             false,
+     "Monday, January 15, 2024"                                              },
+    {"mm/dd/yyyy hh:mm",              45306.75,          false, "01/15/2024 18:00"},
+
+    /* Serials 0, 1 and 60 on the 1900 calendar, and 0 on the 1904 one */
+    {"yyyy-mm-dd",                    0,                 false, "1900-01-00" },
+    {"yyyy-mm-dd",                    1,                 false, "1900-01-01" },
+    {"yyyy-mm-dd",                    59,                false, "1900-02-28" },
+    {"yyyy-mm-dd",                    60,                false, "1900-02-29" },
+    {"yyyy-mm-dd",                    61,                false, "1900-03-01" },
+    {"d-mmm-yy",                      60,                false, "29-Feb-00"  },
+    {"yyyy-mm-dd",                    0,                 true,  "1904-01-01" },
+    {"yyyy-mm-dd",                    45306,             true,  "2028-01-16" },
+
+    /* Elapsed and 12-hour times, fractional seconds */
+    {"[h]:mm:ss",                     1.5,               false, "36:00:00"   },
+    {"[h]:mm:ss",                     0.25,              false, "6:00:00"    },
+    {"[mm]:ss",                       1.0 / 24,          false, "60:00"      },
+    {"[ss]",                          1.0 / 1440,        false, "60"         },
+    {"h:mm AM/PM",                    0.75,              false, "6:00 PM"    },
+    {"h:mm AM/PM",                    0,                 false, "12:00 AM"   },
+    {"h:mm AM/PM",                    0.5,               false, "12:00 PM"   },
+    {"h:mm a/p",                      0.25,              false, "6:00 a"     },
+    {"hh:mm:ss.00",                   43200.25 / 86400,  false, "12:00:00.25"},
+    {"mm:ss.0",                       75.44 / 86400,     false, "01:15.4"    },
+    {"h:mm:ss",                       59.6 / 86400,      false, "0:01:00"    },
+
+    /* Negative values have no date: the caller renders them itself */
+    {"yyyy-mm-dd",                    -1,                false, NULL         },
+    {"h:mm:ss",                       -0.5,              false, NULL         },
+    {"[h]:mm",                        -1,                false, NULL         },
+};
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const formatCase *c      = &cases[i];
+        numberFormat     *format = number_format_compile(c->code);
+        if (!format) {
+            fprintf(stderr, "FAIL %s: not compiled\n", c->code);
+            failures++;
+            continue;
+        }
+
+        char buffer[256];
+        int  len = number_format_render(format, c->value, c->date1904, buffer, sizeof(buffer));
+        if (!c->expected) {
+            if (len >= 0) {
+                fprintf(stderr, "FAIL %s (%.17g): \"%s\" where no text was expected\n", c->code,
+                        c->value, buffer);
+                failures++;
+            }
+        } else if (len < 0 || strcmp(buffer, c->expected) != 0 ||
+                   (size_t)len != strlen(c->expected)) {
+            fprintf(stderr, "FAIL %s (%.17g%s): \"%s\", expected \"%s\"\n", c->code, c->value,
+                    c->date1904 ? ", 1904" : "", len < 0 ? "(failed)" : buffer, c->expected);
+            failures++;
+        }
+        number_format_free(format);
+    }
+
+    /* General and text-only codes are left to the caller */
+    static const char *const uncompiled[] = {"General", "@"};
+    for (size_t i = 0; i < sizeof(uncompiled) / sizeof(uncompiled[0]); i++) {
+        numberFormat *format = number_format_compile(uncompiled[i]);
+        if (format) {
+            fprintf(stderr, "FAIL %s: compiled\n", uncompiled[i]);
+            number_format_free(format);
+            failures++;
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("number_format: %zu cases render as Excel shows them\n",
+           sizeof(cases) / sizeof(cases[0]));
+    return 0;
+}
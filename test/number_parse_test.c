@@ -0,0 +1,211 @@
+/* Differential test of src/number_parse.c against strtod.
+ *
+ * Random decimal texts, from short integers to long mantissas with exponents,
+ * plus malformed and strtod-only spellings, must give the same double (bit for
+ * bit) and end pointer as strtod, and the same numeric verdict as the grammar
+ * is_numeric used to check by hand.
+ */
+
+/* Standard library headers */
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Project headers */
+#include "number_parse.h"
+
+#define ITERATIONS 1000000
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t next_random(void)
+{
+    /* xorshift64* */
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static unsigned below(unsigned n)
+{
+    return (unsigned)(next_random() % n);
+}
+
+/* Reference grammar: optional spaces and sign, digits with at most one point,
+ * an optional exponent with digits, trailing spaces
+ */
+static bool reference_numeric(const char *str)
+{
+    int i = 0;
+    while (isspace((unsigned char)str[i])) {
+        i++;
+    }
+    if (str[i] == '+' || str[i] == '-') {
+        i++;
+    }
+
+    bool has_digit = false;
+    bool has_dot   = false;
+    bool has_exp   = false;
+    while (str[i] != '\0') {
+        if (isdigit((unsigned char)str[i])) {
+            has_digit = true;
+        } else if (str[i] == '.' && !has_dot && !has_exp) {
+            has_dot = true;
+        } else if ((str[i] == 'e' || str[i] == 'E') && !has_exp && has_digit) {
+            has_exp   = true;
+            has_digit = false;
+            i++;
+            if (str[i] == '+' || str[i] == '-') {
+                i++;
+            }
+            continue;
+        } else if (isspace((unsigned char)str[i])) {
+            break;
+        } else {
+            return false;
+        }
+        i++;
+    }
+    while (isspace((unsigned char)str[i])) {
+        i++;
+    }
+    return has_digit && str[i] == '\0';
+}
+
+static void append_digits(char *text, size_t *len, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        text[(*len)++] = (char)('0' + below(10));
+    }
+}
+
+static void random_text(char *text)
+{
+    static const char *const oddities[] = {
+        "",      "-",    "+",     ".",      "e5",      "1e",    "1e+",  "1.2.3", "0x1A",
+        "-0x10", "inf",  "-nan",  "1e5.5",  " 12 ",    "12 x",  "\t7\n", "1..2",  "-0",
+        "+.5",   "5.",   ".e1",   "1e-400", "1e400",   "#N/A",  "1,5",   "0e0",   "00012",
+        "4.9e-324", "2.2250738585072011e-308", "9007199254740993", "1.7976931348623157e308"};
+
+    size_t len = 0;
+    switch (below(8)) {
+        case 0:
+            strcpy(text, oddities[below(sizeof(oddities) / sizeof(oddities[0]))]);
+            return;
+        case 1:
+            /* Integers */
+            if (below(2)) {
+                text[len++] = '-';
+            }
+            append_digits(text, &len, 1 + below(22));
+            break;
+        case 2:
+            /* What Excel writes: up to 17 significant digits */
+            if (below(3) == 0) {
+                text[len++] = '-';
+            }
+            append_digits(text, &len, 1 + below(8));
+            text[len++] = '.';
+            append_digits(text, &len, 1 + below(17));
+            break;
+        case 3:
+            /* Small values with leading zeros */
+            text[len++] = '0';
+            text[len++] = '.';
+            for (unsigned zeros = below(12); zeros > 0; zeros--) {
+                text[len++] = '0';
+            }
+            append_digits(text, &len, 1 + below(18));
+            break;
+        case 4:
+            /* Mantissa and exponent */
+            append_digits(text, &len, 1 + below(20));
+            if (below(2)) {
+                text[len++] = '.';
+                append_digits(text, &len, below(20));
+            }
+            text[len++] = below(2) ? 'e' : 'E';
+            if (below(2)) {
+                text[len++] = below(2) ? '-' : '+';
+            }
+            append_digits(text, &len, 1 + below(3));
+            break;
+        case 5:
+            /* Long mantissas */
+            append_digits(text, &len, 1 + below(40));
+            if (below(2)) {
+                text[len++] = '.';
+                append_digits(text, &len, below(40));
+            }
+            break;
+        case 6: {
+            /* Shortest forms of random doubles */
+            uint64_t bits = next_random();
+            double   value;
+            memcpy(&value, &bits, sizeof(value));
+            snprintf(text, 64, "%.*g", 1 + (int)below(17), value);
+            return;
+        }
+        default: {
+            /* Digits, points, signs, exponents and spaces in any order */
+            static const char alphabet[] = "0123456789..--++eE  x";
+            unsigned          count      = 1 + below(12);
+            for (unsigned i = 0; i < count; i++) {
+                text[len++] = alphabet[below(sizeof(alphabet) - 1)];
+            }
+            break;
+        }
+    }
+    text[len] = '\0';
+}
+
+static int failures = 0;
+
+static void check(const char *text)
+{
+    parsedNumber number;
+    const char  *end = number_parse(text, &number);
+
+    char  *expected_end;
+    double expected        = strtod(text, &expected_end);
+    bool   expected_exp    = strpbrk(text, "eE") != NULL;
+    bool   expected_number = reference_numeric(text);
+
+    if (memcmp(&number.value, &expected, sizeof(expected)) != 0 || end != expected_end ||
+        number.numeric != expected_number || number.has_exponent != expected_exp) {
+        fprintf(stderr,
+                "FAIL \"%s\": value %.17g/%.17g end %td/%td numeric %d/%d exponent %d/%d\n",
+                text,
+                number.value,
+                expected,
+                end - text,
+                expected_end - text,
+                number.numeric,
+                expected_number,
+                number.has_exponent,
+                expected_exp);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    char text[128];
+    for (int i = 0; i < ITERATIONS && failures <= 20; i++) {
+        random_text(text);
+        check(text);
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("number_parse: all texts match strtod\n");
+    return 0;
+}
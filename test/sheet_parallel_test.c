@@ -0,0 +1,203 @@
+/* Output of --jobs against the serial conversion.
+ *
+ * Worksheets large enough to be split into row ranges are converted with one
+ * job and with four, and the CSV must be the same byte for byte: a 12 MB sheet
+ * split in memory (deflated and stored) and a 70 MB deflated one split at
+ * checkpoints, each with row and cell references and without any. The large
+ * sheet is also converted twice with an index directory, so the second run
+ * splits it at the checkpoints the first one saved.
+ */
+
+/* Standard library headers */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Project headers */
+#include "test_workbook.h"
+#include "xlsx2csv.h"
+
+#define SMALL_SHEET_MB 12
+#define LARGE_SHEET_MB 70
+
+static int failures = 0;
+
+static const char sheet_start[] = TEST_WORKSHEET_START "<sheetData>";
+
+static const char sheet_end[] = "</sheetData>" TEST_WORKSHEET_END;
+
+/* Rows skip a number now and then, and their cells a column */
+static const char row_with_refs[] =
+    "<row r=\"%d\"><c r=\"A%d\" t=\"s\"><v>%d</v></c><c r=\"B%d\"><v>%d</v></c>"
+    "<c r=\"D%d\" s=\"1\"><v>%d</v></c><c r=\"E%d\" s=\"2\"><v>%d.%03d</v></c>"
+    "<c r=\"F%d\" t=\"inlineStr\"><is><t>row &lt;%d&gt;</t></is></c></row>";
+
+/* The same cells with no references; positions follow from the order */
+static const char row_without_refs[] =
+    "<row><c t=\"s\"><v>%d</v></c><c><v>%d</v></c><c/>"
+    "<c s=\"1\"><v>%d</v></c><c s=\"2\"><v>%d.%03d</v></c>"
+    "<c t=\"inlineStr\"><is><t>row &lt;%d&gt;</t></is></c></row>";
+
+/* Worksheet XML of at least mb megabytes */
+static char *sheet_xml(int mb, bool refs, size_t *len)
+{
+    size_t target   = (size_t)mb * 1024 * 1024;
+    size_t capacity = target + 4096;
+    char  *xml      = malloc(capacity);
+    if (!xml) {
+        return NULL;
+    }
+
+    size_t used = (size_t)snprintf(xml, capacity, "%s", sheet_start);
+    for (int i = 1, r = 1; used < target; i++, r += i % 97 == 0 ? 3 : 1) {
+        int n = i % 3, v = i * 7, d = 40000 + i % 5000, f = i % 1000;
+        if (refs) {
+            used += (size_t)snprintf(xml + used, capacity - used, row_with_refs, r, r, n, r, v,
+                                     r, d, r, i, f, r, i);
+        } else {
+            used += (size_t)snprintf(xml + used, capacity - used, row_without_refs, n, v, d, i,
+                                     f, i);
+        }
+    }
+    used += (size_t)snprintf(xml + used, capacity - used, "%s", sheet_end);
+    *len = used;
+    return xml;
+}
+
+/* Test workbook with a sheet of at least mb megabytes */
+static bool write_sheet_workbook(const char *path, int mb, bool refs, bool deflated)
+{
+    size_t sheet_len = 0;
+    char  *sheet     = sheet_xml(mb, refs, &sheet_len);
+    bool   ok        = sheet && write_workbook(path, sheet, sheet_len, deflated);
+    free(sheet);
+    return ok;
+}
+
+/* CSV of the first sheet converted with jobs threads, NULL on failure */
+static char *convert(const char *book, int jobs, char *index_dir, const char *csv, size_t *len)
+{
+    xlsxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.delimiter        = ',';
+    options.quoting          = QUOTE_MINIMAL;
+    options.sheetdelimiter   = "--------";
+    options.outputencoding   = "utf-8";
+    options.lineterminator   = "\n";
+    options.skip_hidden_rows = true;
+    options.jobs             = jobs;
+    options.index_dir        = index_dir;
+    options.write_buffer_kb  = 1024;
+
+    xlsx2csvConverter *conv = xlsx2csv_create(book, &options);
+    if (!conv) {
+        return NULL;
+    }
+    int status = xlsx2csv_convert(conv, csv, 1, NULL);
+    xlsx2csv_free(conv);
+    return status < 0 ? NULL : read_file(csv, len);
+}
+
+static void compare(const char *what, const char *expected, size_t expected_len,
+                    const char *actual, size_t actual_len)
+{
+    if (!actual) {
+        fprintf(stderr, "FAIL %s: conversion failed\n", what);
+        failures++;
+        return;
+    }
+    if (expected_len != actual_len || memcmp(expected, actual, expected_len) != 0) {
+        size_t at = 0;
+        while (at < expected_len && at < actual_len && expected[at] == actual[at]) {
+            at++;
+        }
+        fprintf(stderr, "FAIL %s: %zu bytes expected, %zu written, first difference at %zu\n",
+                what, expected_len, actual_len, at);
+        failures++;
+    }
+}
+
+static void check_workbook(const char *dir, int mb, bool refs, bool deflated)
+{
+    char book[96], csv[96], index_dir[96], what[96];
+    snprintf(book, sizeof(book), "%s/book.xlsx", dir);
+    snprintf(csv, sizeof(csv), "%s/out.csv", dir);
+    snprintf(index_dir, sizeof(index_dir), "%s/index", dir);
+    snprintf(what, sizeof(what), "%d MB %s sheet %s references", mb,
+             deflated ? "deflated" : "stored", refs ? "with" : "without");
+
+    if (!write_sheet_workbook(book, mb, refs, deflated)) {
+        fprintf(stderr, "FAIL %s: cannot write the workbook\n", what);
+        failures++;
+        return;
+    }
+
+    size_t expected_len = 0;
+    char  *expected     = convert(book, 1, NULL, csv, &expected_len);
+    if (!expected || expected_len == 0) {
+        fprintf(stderr, "FAIL %s: serial conversion failed\n", what);
+        failures++;
+        free(expected);
+        unlink(book);
+        return;
+    }
+
+    size_t len = 0;
+    char  *csv_data = convert(book, 4, NULL, csv, &len);
+    compare(what, expected, expected_len, csv_data, len);
+    free(csv_data);
+
+    /* The index the first run keeps must give the same split in the second */
+    if (mb > SMALL_SHEET_MB) {
+        char index_file[128];
+        snprintf(index_file, sizeof(index_file), "%s/book.xlsx.sheet1.idx", index_dir);
+        mkdir(index_dir, 0700);
+        for (int run = 0; run < 2; run++) {
+            char with_index[128];
+            snprintf(with_index, sizeof(with_index), "%s, %s index", what,
+                     run == 0 ? "saving the" : "reading the saved");
+            csv_data = convert(book, 4, index_dir, csv, &len);
+            compare(with_index, expected, expected_len, csv_data, len);
+            free(csv_data);
+
+            struct stat st;
+            if (stat(index_file, &st) != 0) {
+                fprintf(stderr, "FAIL %s: no index kept in the index directory\n", with_index);
+                failures++;
+            }
+        }
+        unlink(index_file);
+        rmdir(index_dir);
+    }
+
+    free(expected);
+    unlink(csv);
+    unlink(book);
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/sheet_parallel_test_XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+
+    check_workbook(dir, SMALL_SHEET_MB, true, true);
+    check_workbook(dir, SMALL_SHEET_MB, false, true);
+    check_workbook(dir, SMALL_SHEET_MB, false, false);
+    check_workbook(dir, LARGE_SHEET_MB, true, true);
+    check_workbook(dir, LARGE_SHEET_MB, false, true);
+    rmdir(dir);
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("sheet_parallel: --jobs 4 output matches --jobs 1\n");
+    return 0;
+}
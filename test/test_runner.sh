@@ -138,6 +138,71 @@ run_error_test()
     rm -f "/tmp/expected_${test_name}_stdout.txt" "/tmp/expected_${test_name}_stderr.txt"
 }
 
+# Function to test that an option leaves the output of every workbook unchanged
+run_same_output_test()
+{
+    local test_name="$1"
+    local options="$2"
+    local xlsx_file
+
+    for xlsx_file in test_data/*.xlsx; do
+        local name="${test_name}_$(basename "$xlsx_file" .xlsx)"
+        echo -n "Testing $name... "
+
+        rm -rf "/tmp/expected_${name}" "actual/${name}"
+        mkdir -p "/tmp/expected_${name}" "actual/${name}"
+
+        # Temporarily disable exit on error: both runs must fail the same way
+        set +e
+        $C_XLSX2CSV -a "$xlsx_file" "/tmp/expected_${name}" > /dev/null 2>&1
+        local default_exit=$?
+        $C_XLSX2CSV -a $options "$xlsx_file" "actual/${name}" > /dev/null 2>&1
+        local option_exit=$?
+        set -e
+
+        if [ $default_exit -ne $option_exit ]; then
+            echo -e "${RED}FAIL${NC}"
+            echo "  Exit codes differ: default=$default_exit, $options=$option_exit"
+            TESTS_FAILED=$((TESTS_FAILED + 1))
+        elif ! diff -r -q "/tmp/expected_${name}" "actual/${name}" > /dev/null 2>&1; then
+            echo -e "${RED}FAIL${NC}"
+            echo "  Output differs from the default conversion"
+            echo "  Run: diff -r /tmp/expected_${name} actual/${name}"
+            TESTS_FAILED=$((TESTS_FAILED + 1))
+        else
+            echo -e "${GREEN}PASS${NC}"
+            TESTS_PASSED=$((TESTS_PASSED + 1))
+            rm -rf "/tmp/expected_${name}"
+        fi
+    done
+}
+
+# Function to test output the Python version cannot produce against expected/<name>.csv
+run_expected_test()
+{
+    local test_name="$1"
+    local xlsx_file="$2"
+    local options="$3"
+
+    echo -n "Testing $test_name... "
+
+    $C_XLSX2CSV $options "$xlsx_file" "actual/${test_name}.csv" 2> /dev/null || {
+        echo -e "${RED}FAIL${NC} (C version crashed)"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+        return
+    }
+
+    if diff -q "expected/${test_name}.csv" "actual/${test_name}.csv" > /dev/null 2>&1; then
+        echo -e "${GREEN}PASS${NC}"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}FAIL${NC}"
+        echo "  Output differs from the expected output"
+        echo "  Run: diff expected/${test_name}.csv actual/${test_name}.csv"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
 # Basic tests
 echo "=== Basic Functionality Tests ==="
 run_test "basic" "test_data/basic.xlsx" ""
@@ -246,6 +311,38 @@ if [ -f "test_data/mixed_empty.xlsx" ]; then
     run_test "mixed_empty_skip" "test_data/mixed_empty.xlsx" "-i"
 fi
 
+# Cells without an r attribute
+if [ -f "test_data/implicit_columns.xlsx" ]; then
+    echo -e "\n=== Implicit Column Tests ==="
+    run_test "implicit_columns" "test_data/implicit_columns.xlsx" ""
+fi
+
+# Columns past the 1024th
+if [ -f "test_data/wide_columns.xlsx" ]; then
+    echo -e "\n=== Wide Column Tests ==="
+    run_test "wide_columns" "test_data/wide_columns.xlsx" ""
+fi
+
+# Markup the fast scanner leaves to expat
+if [ -f "test_data/scanner_fallbacks.xlsx" ]; then
+    echo -e "\n=== Scanner Fallback Tests ==="
+    run_test "scanner_fallbacks_comments" "test_data/scanner_fallbacks.xlsx" "-s 1"
+    run_test "scanner_fallbacks_cdata" "test_data/scanner_fallbacks.xlsx" "-s 2"
+    run_test "scanner_fallbacks_references" "test_data/scanner_fallbacks.xlsx" "-s 3"
+    run_test "scanner_fallbacks_attributes" "test_data/scanner_fallbacks.xlsx" "-s 4"
+    run_test "scanner_fallbacks_entities" "test_data/scanner_fallbacks.xlsx" "-s 5"
+fi
+
+# Shared string table with rich text and phonetic runs
+if [ -f "test_data/shared_strings.xlsx" ]; then
+    echo -e "\n=== Shared Strings Tests ==="
+    run_test "shared_strings_default" "test_data/shared_strings.xlsx" ""
+    run_test "shared_strings_quote_nonnumeric" "test_data/shared_strings.xlsx" "-q nonnumeric"
+fi
+if [ -f "test_data/shared_strings_large.xlsx" ]; then
+    run_test "shared_strings_large" "test_data/shared_strings_large.xlsx" ""
+fi
+
 # Unicode extended tests
 if [ -f "test_data/unicode_extended.xlsx" ]; then
     echo -e "\n=== Unicode Extended Tests ==="
@@ -334,6 +431,24 @@ if [ -f "test_data/portfolio_tracking.xlsx" ]; then
     run_test "portfolio_holdings" "test_data/portfolio_tracking.xlsx" "-n Holdings --floatformat %.02f"
 fi
 
+# Numbers shown through their Excel number formats (no Python equivalent)
+if [ -f "test_data/number_formats.xlsx" ] && [ -f "test_data/financial_report.xlsx" ]; then
+    echo -e "\n=== Excel Number Format Tests ==="
+    run_expected_test "number_formats_excel" "test_data/number_formats.xlsx" "--excel-formats"
+    run_expected_test "financial_excel" "test_data/financial_report.xlsx" "--excel-formats"
+fi
+
+# Conversion options that must not change any output
+echo -e "\n=== Fast Scanner Tests ==="
+run_same_output_test "fast_scanner" "--fast-scanner"
+
+echo -e "\n=== Lazy Shared Strings Tests ==="
+run_same_output_test "lazy_shared_strings" "--lazy-shared-strings"
+
+# 1 MB, the smallest limit: shared_strings_large.xlsx spills its text and entries
+echo -e "\n=== Shared Strings Memory Limit Tests ==="
+run_same_output_test "strings_memory" "--strings-memory 1"
+
 echo
 echo "====================================="
 echo "Test Results"
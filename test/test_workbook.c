@@ -0,0 +1,233 @@
+/* Workbooks written by the tests (see test_workbook.h) */
+
+/* Standard library headers */
+#include <stdlib.h>
+#include <string.h>
+
+/* Third-party library headers */
+#include <zlib.h>
+
+/* Project headers */
+#include "test_workbook.h"
+
+const char test_content_types[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Override PartName=\"/xl/workbook.xml\" ContentType=\"application/"
+    "vnd.openxmlformats-officedocument.spreadsheetml.sheet.main+xml\"/>"
+    "<Override PartName=\"/xl/worksheets/sheet1.xml\" ContentType=\"application/"
+    "vnd.openxmlformats-officedocument.spreadsheetml.worksheet+xml\"/>"
+    "</Types>";
+
+const char test_workbook[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+    "<workbook xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" "
+    "xmlns:r=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships\">"
+    "<sheets><sheet name=\"Sheet1\" sheetId=\"1\" r:id=\"rId1\"/></sheets></workbook>";
+
+const char test_workbook_rels[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/"
+    "relationships/worksheet\" Target=\"worksheets/sheet1.xml\"/></Relationships>";
+
+const char test_shared_strings[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+    "<sst xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" count=\"3\" "
+    "uniqueCount=\"3\"><si><t>plain</t></si><si><t>with, comma</t></si>"
+    "<si><t>two\nlines</t></si></sst>";
+
+const char test_styles[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+    "<styleSheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+    "<numFmts count=\"2\"><numFmt numFmtId=\"164\" formatCode=\"0.000_ \"/>"
+    "<numFmt numFmtId=\"165\" formatCode=\"dd/mm/yyyy\"/></numFmts>"
+    "<cellXfs count=\"6\"><xf numFmtId=\"0\"/><xf numFmtId=\"14\"/><xf numFmtId=\"2\"/>"
+    "<xf numFmtId=\"10\"/><xf numFmtId=\"164\"/><xf numFmtId=\"165\"/></cellXfs></styleSheet>";
+
+void put16(FILE *fp, unsigned value)
+{
+    fputc((int)(value & 0xff), fp);
+    fputc((int)((value >> 8) & 0xff), fp);
+}
+
+void put32(FILE *fp, unsigned long value)
+{
+    put16(fp, (unsigned)(value & 0xffff));
+    put16(fp, (unsigned)((value >> 16) & 0xffff));
+}
+
+void put64(FILE *fp, uint64_t value)
+{
+    put32(fp, (unsigned long)(value & 0xffffffff));
+    put32(fp, (unsigned long)(value >> 32));
+}
+
+/* Raw deflate of a part, as stored in the archive */
+static bool deflate_part(zipPart *part)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, 1, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    uLong bound    = deflateBound(&stream, (uLong)part->len);
+    part->deflated = malloc(bound);
+    if (!part->deflated) {
+        deflateEnd(&stream);
+        return false;
+    }
+    stream.next_in     = (Bytef *)(uintptr_t)part->data;
+    stream.avail_in    = (uInt)part->len;
+    stream.next_out    = part->deflated;
+    stream.avail_out   = (uInt)bound;
+    int status         = deflate(&stream, Z_FINISH);
+    part->deflated_len = stream.total_out;
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+bool write_zip(const char *path, zipPart *parts, int count, const zipLayout *layout)
+{
+    static const zipLayout plain = {NULL, 0, false, false};
+    if (!layout) {
+        layout = &plain;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (parts[i].deflate && !parts[i].deflated && !deflate_part(&parts[i])) {
+            return false;
+        }
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    bool descriptors = layout->descriptors;
+    for (int i = 0; i < count; i++) {
+        zipPart      *part   = &parts[i];
+        const void   *data   = part->deflate ? (const void *)part->deflated : part->data;
+        unsigned long stored = (unsigned long)(part->deflate ? part->deflated_len : part->len);
+        part->crc            = crc32(0, (const Bytef *)part->data, (uInt)part->len);
+        part->offset         = (unsigned long)ftell(fp);
+        put32(fp, 0x04034b50);
+        put16(fp, 20);                       /* Version needed */
+        put16(fp, descriptors ? 0x0008 : 0); /* Flags */
+        put16(fp, part->deflate ? 8 : 0);    /* Deflated or stored */
+        put32(fp, 0);                        /* Time and date */
+        put32(fp, descriptors ? 0 : part->crc);
+        put32(fp, descriptors ? 0 : stored);
+        put32(fp, descriptors ? 0 : (unsigned long)part->len);
+        put16(fp, (unsigned)strlen(part->name));
+        put16(fp, 0);
+        fputs(part->name, fp);
+        fwrite(data, 1, stored, fp);
+        if (descriptors) {
+            put32(fp, 0x08074b50);
+            put32(fp, part->crc);
+            put32(fp, stored);
+            put32(fp, (unsigned long)part->len);
+        }
+    }
+
+    unsigned long directory = (unsigned long)ftell(fp);
+    for (int i = 0; i < count; i++) {
+        const zipPart *part   = &parts[i];
+        bool           wrong  = layout->tampered && strcmp(part->name, layout->tampered) == 0;
+        uint64_t       record = wrong ? layout->size : part->len;
+        bool           extra  = wrong && layout->zip64;
+        put32(fp, 0x02014b50);
+        put16(fp, 45);
+        put16(fp, 20);
+        put16(fp, 0);
+        put16(fp, part->deflate ? 8 : 0);
+        put32(fp, 0);
+        put32(fp, part->crc);
+        put32(fp, (unsigned long)(part->deflate ? part->deflated_len : part->len));
+        put32(fp, extra ? 0xffffffffUL : (unsigned long)(record & 0xffffffff));
+        put16(fp, (unsigned)strlen(part->name));
+        put16(fp, extra ? 12 : 0); /* Extra field */
+        put16(fp, 0);              /* Comment */
+        put16(fp, 0);              /* Disk */
+        put16(fp, 0);              /* Internal attributes */
+        put32(fp, 0);              /* External attributes */
+        put32(fp, part->offset);
+        fputs(part->name, fp);
+        if (extra) {
+            put16(fp, 0x0001);
+            put16(fp, 8);
+            put64(fp, record);
+        }
+    }
+    unsigned long directory_end = (unsigned long)ftell(fp);
+
+    put32(fp, 0x06054b50);
+    put16(fp, 0);
+    put16(fp, 0);
+    put16(fp, (unsigned)count);
+    put16(fp, (unsigned)count);
+    put32(fp, directory_end - directory);
+    put32(fp, directory);
+    put16(fp, 0);
+
+    bool ok = !ferror(fp);
+    return fclose(fp) == 0 && ok;
+}
+
+void zip_parts_free(zipPart *parts, int count)
+{
+    for (int i = 0; i < count; i++) {
+        free(parts[i].deflated);
+        parts[i].deflated = NULL;
+    }
+}
+
+void test_workbook_parts(zipPart parts[TEST_WORKBOOK_PARTS], const char *sheet, size_t sheet_len)
+{
+    static const char *const names[TEST_WORKBOOK_PARTS] = {
+        "[Content_Types].xml",  "xl/workbook.xml", "xl/_rels/workbook.xml.rels",
+        "xl/sharedStrings.xml", "xl/styles.xml",   "xl/worksheets/sheet1.xml",
+    };
+    const char *data[TEST_WORKBOOK_PARTS] = {
+        test_content_types,  test_workbook, test_workbook_rels,
+        test_shared_strings, test_styles,   sheet,
+    };
+
+    memset(parts, 0, TEST_WORKBOOK_PARTS * sizeof(zipPart));
+    for (int i = 0; i < TEST_WORKBOOK_PARTS; i++) {
+        parts[i].name = names[i];
+        parts[i].data = data[i];
+        parts[i].len  = i == TEST_WORKBOOK_PARTS - 1 ? sheet_len : strlen(data[i]);
+    }
+}
+
+bool write_workbook(const char *path, const char *sheet, size_t sheet_len, bool deflate)
+{
+    zipPart parts[TEST_WORKBOOK_PARTS];
+    test_workbook_parts(parts, sheet, sheet_len);
+    for (int i = 0; i < TEST_WORKBOOK_PARTS; i++) {
+        parts[i].deflate = deflate;
+    }
+
+    bool ok = write_zip(path, parts, TEST_WORKBOOK_PARTS, NULL);
+    zip_parts_free(parts, TEST_WORKBOOK_PARTS);
+    return ok;
+}
+
+char *read_file(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    char *data = malloc((size_t)size + 1);
+    *len       = data ? fread(data, 1, (size_t)size, fp) : 0;
+    fclose(fp);
+    return data;
+}
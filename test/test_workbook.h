@@ -0,0 +1,73 @@
+/* Workbooks written by the tests.
+ *
+ * The fixed parts of a one-sheet XLSX and a small ZIP writer for them: entries
+ * stored or deflated, with optional data descriptors, and a central directory
+ * that can record a wrong size for one entry (in a Zip64 field if asked).
+ */
+
+#ifndef _TEST_WORKBOOK_H
+#define _TEST_WORKBOOK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Start and end of the worksheet XML; <sheetData> and the rest go in between */
+#define TEST_WORKSHEET_START                                          \
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>" \
+    "<worksheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+#define TEST_WORKSHEET_END "</worksheet>"
+
+/* Parts of a test workbook, with its one sheet at xl/worksheets/sheet1.xml */
+#define TEST_WORKBOOK_PARTS 6
+
+extern const char test_content_types[];
+extern const char test_workbook[];
+extern const char test_workbook_rels[];
+
+/* Shared strings: 0 "plain", 1 "with, comma", 2 "two\nlines" */
+extern const char test_shared_strings[];
+
+/* Styles: 0 general, 1 date, 2 "0.00", 3 percent, 4 custom "0.000_ ", 5 custom "dd/mm/yyyy" */
+extern const char test_styles[];
+
+/* One entry of a test archive */
+typedef struct {
+    const char    *name;
+    const char    *data;
+    size_t         len;
+    bool           deflate;      /* Deflate the entry instead of storing it */
+    unsigned char *deflated;     /* Filled in by write_zip, freed by zip_parts_free */
+    size_t         deflated_len;
+    unsigned long  crc;
+    unsigned long  offset;       /* Of the local header, as last written */
+} zipPart;
+
+/* Deviations from a plain archive; NULL for none */
+typedef struct {
+    const char *tampered;    /* Entry whose central directory records size instead of its length */
+    uint64_t    size;
+    bool        zip64;       /* Record that size in a Zip64 extra field */
+    bool        descriptors; /* Leave the CRC and sizes to data descriptors after the entries */
+} zipLayout;
+
+/* Little-endian fields of the ZIP records */
+void put16(FILE *fp, unsigned value);
+void put32(FILE *fp, unsigned long value);
+void put64(FILE *fp, uint64_t value);
+
+/* Write the parts as a ZIP archive; deflated entries are compressed once and kept */
+bool write_zip(const char *path, zipPart *parts, int count, const zipLayout *layout);
+void zip_parts_free(zipPart *parts, int count);
+
+/* The parts of a test workbook with the given worksheet XML, all stored */
+void test_workbook_parts(zipPart parts[TEST_WORKBOOK_PARTS], const char *sheet, size_t sheet_len);
+
+/* A test workbook with the given worksheet XML, deflated or stored */
+bool write_workbook(const char *path, const char *sheet, size_t sheet_len, bool deflate);
+
+/* Contents of a file, NULL if it cannot be read */
+char *read_file(const char *path, size_t *len);
+
+#endif /* _TEST_WORKBOOK_H */
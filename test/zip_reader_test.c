@@ -0,0 +1,284 @@
+/* Entries whose recorded uncompressed size is wrong or missing.
+ *
+ * The size in the central directory (or its Zip64 extra field) is only a hint:
+ * a workbook whose sharedStrings.xml, styles.xml or worksheet claims 1 TB,
+ * UINT64_MAX, too few bytes or none at all must read and convert exactly as the
+ * same workbook with the true sizes, whether the entry goes to a plain buffer
+ * or to a pool that already holds a smaller used buffer.
+ *
+ * Read from STDIN, the archive is walked by its local headers; entries whose
+ * sizes only follow in a data descriptor must convert the same, and a
+ * truncated stream must fail rather than give partial output.
+ *
+ * An end of central directory record that points at a Zip64 record outside the
+ * file, or one that would overlap the locator after it, must be refused.
+ */
+
+/* Standard library headers */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Project headers */
+#include "test_workbook.h"
+#include "utils.h"
+#include "xlsx2csv.h"
+#include "zip_reader.h"
+
+#define SHEET_ROWS 2000
+
+static int failures = 0;
+
+/* Worksheet XML with a string, a date and a number per row */
+static char *sheet_xml(size_t *len)
+{
+    size_t capacity = 256 + (size_t)SHEET_ROWS * 128;
+    char  *xml      = malloc(capacity);
+    if (!xml) {
+        return NULL;
+    }
+
+    size_t used = (size_t)snprintf(xml, capacity, "%s", TEST_WORKSHEET_START "<sheetData>");
+    for (int r = 1; r <= SHEET_ROWS; r++) {
+        used += (size_t)snprintf(xml + used, capacity - used,
+                                 "<row r=\"%d\"><c r=\"A%d\" t=\"s\"><v>%d</v></c>"
+                                 "<c r=\"B%d\" s=\"1\"><v>%d</v></c><c r=\"C%d\"><v>%d</v></c>"
+                                 "</row>",
+                                 r, r, r % 2, r, 45306 + r % 400, r, r);
+    }
+    used += (size_t)snprintf(xml + used, capacity - used, "%s", "</sheetData>" TEST_WORKSHEET_END);
+    *len = used;
+    return xml;
+}
+
+/* An end of central directory record that sends the reader to the Zip64 one
+ * through a locator pointing at record_offset, after padding zero bytes
+ */
+static bool write_truncated_zip64(const char *path, size_t padding, uint64_t record_offset)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    for (size_t i = 0; i < padding; i++) {
+        fputc(0, fp);
+    }
+    put32(fp, 0x07064b50);
+    put32(fp, 0);
+    put64(fp, record_offset);
+    put32(fp, 1);
+
+    put32(fp, 0x06054b50);
+    put16(fp, 0);
+    put16(fp, 0);
+    put16(fp, 0xffff);
+    put16(fp, 0xffff);
+    put32(fp, 0);
+    put32(fp, 0);
+    put16(fp, 0);
+
+    bool ok = !ferror(fp);
+    return fclose(fp) == 0 && ok;
+}
+
+/* CSV of the first sheet, NULL if the conversion fails */
+static char *convert(const char *path, const char *csv_path, size_t *len)
+{
+    xlsx2csvConverter *conv = xlsx2csv_create(path, NULL);
+    if (!conv) {
+        return NULL;
+    }
+    int status = xlsx2csv_convert(conv, csv_path, 1, NULL);
+    xlsx2csv_free(conv);
+    return status < 0 ? NULL : read_file(csv_path, len);
+}
+
+/* CSV of the first sheet of the workbook at path given on STDIN */
+static char *convert_stdin(const char *path, const char *csv_path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp || dup2(fileno(fp), STDIN_FILENO) < 0) {
+        if (fp) {
+            fclose(fp);
+        }
+        return NULL;
+    }
+    fclose(fp);
+    return convert("-", csv_path, len);
+}
+
+/* Every way of reading the part must give its exact contents */
+static void check_reads(const char *what, const char *path, const zipPart *part)
+{
+    void *zip = zip_open_file(path);
+    if (!zip) {
+        fprintf(stderr, "FAIL %s: cannot open the archive\n", what);
+        failures++;
+        return;
+    }
+
+    char *data = zip_read_file_to_string(zip, part->name);
+    if (!data || strlen(data) != part->len || memcmp(data, part->data, part->len) != 0) {
+        fprintf(stderr, "FAIL %s: zip_read_file_to_string\n", what);
+        failures++;
+    }
+    free(data);
+
+    /* A used smaller buffer in the pool must not be handed out for the entry */
+    bufferPool pool;
+    memset(&pool, 0, sizeof(pool));
+    char *small = buffer_pool_acquire(&pool, 16);
+    memset(small, 'x', 16);
+    buffer_pool_release(&pool, small);
+
+    size_t len    = 0;
+    char  *pooled = zip_read_file_pooled(zip, part->name, &pool, &len);
+    if (!pooled || len != part->len || memcmp(pooled, part->data, part->len) != 0) {
+        fprintf(stderr, "FAIL %s: zip_read_file_pooled\n", what);
+        failures++;
+    }
+    if (pooled) {
+        buffer_pool_release(&pool, pooled);
+    }
+
+    /* One-shot inflate may decline the entry, but not decode it wrongly */
+    char *inflated = zip_file_inflate(zip, part->name, &pool, &len);
+    if (inflated) {
+        if (len != part->len || memcmp(inflated, part->data, part->len) != 0) {
+            fprintf(stderr, "FAIL %s: zip_file_inflate\n", what);
+            failures++;
+        }
+        buffer_pool_release(&pool, inflated);
+    }
+
+    buffer_pool_free(&pool);
+    xlsx_zip_close(zip);
+}
+
+int main(void)
+{
+    static const struct {
+        uint64_t    size;
+        bool        zip64;
+        const char *name;
+    } sizes[] = {
+        {(uint64_t)1 << 40, true,  "1 TB in Zip64"     },
+        {UINT64_MAX,        true,  "UINT64_MAX in Zip64"},
+        {0xfffffffe,        false, "4 GB"               },
+        {10,                false, "10 bytes"           },
+        {0,                 false, "0 bytes"            },
+    };
+
+    size_t  sheet_len  = 0;
+    char   *sheet      = sheet_xml(&sheet_len);
+    int     part_count = TEST_WORKBOOK_PARTS;
+    zipPart parts[TEST_WORKBOOK_PARTS];
+    test_workbook_parts(parts, sheet, sheet_len);
+    for (int i = 0; i < part_count; i++) {
+        parts[i].deflate = true;
+    }
+
+    char path[64];
+    char csv_path[64];
+    snprintf(path, sizeof(path), "/tmp/zip_reader_test_%d.xlsx", (int)getpid());
+    snprintf(csv_path, sizeof(csv_path), "/tmp/zip_reader_test_%d.csv", (int)getpid());
+
+    size_t expected_len = 0;
+    char  *expected     = NULL;
+    if (sheet && write_zip(path, parts, part_count, NULL)) {
+        expected = convert(path, csv_path, &expected_len);
+    }
+    if (!expected || !strstr(expected, "with, comma") || strstr(expected, "45306")) {
+        fprintf(stderr, "cannot convert the test workbook with its true sizes\n");
+        return 1;
+    }
+
+    for (int p = 3; p < part_count; p++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            char what[96];
+            snprintf(what, sizeof(what), "%s recorded as %s", parts[p].name, sizes[s].name);
+            zipLayout layout = {parts[p].name, sizes[s].size, sizes[s].zip64, false};
+            if (!write_zip(path, parts, part_count, &layout)) {
+                fprintf(stderr, "FAIL %s: cannot write the archive\n", what);
+                failures++;
+                continue;
+            }
+
+            check_reads(what, path, &parts[p]);
+
+            size_t len = 0;
+            char  *csv = convert(path, csv_path, &len);
+            if (!csv || len != expected_len || memcmp(csv, expected, len) != 0) {
+                fprintf(stderr, "FAIL %s: the CSV differs from the true-size workbook's\n",
+                        what);
+                failures++;
+            }
+            free(csv);
+        }
+    }
+
+    /* A Zip64 locator whose record cannot fit before it must be refused, not read */
+    static const struct {
+        size_t      padding;
+        uint64_t    offset;
+        const char *name;
+    } locators[] = {
+        {0,   (uint64_t)1 << 32, "a 42-byte file, record at 4 GB"      },
+        {0,   UINT64_MAX,        "a 42-byte file, record at UINT64_MAX"},
+        {30,  0,                 "a record overlapping its locator"    },
+        {100, 60,                "a record running into its locator"   },
+    };
+    for (size_t l = 0; l < sizeof(locators) / sizeof(locators[0]); l++) {
+        size_t len = 0;
+        void  *zip = NULL;
+        if (!write_truncated_zip64(path, locators[l].padding, locators[l].offset) ||
+            (zip = zip_open_file(path)) != NULL || convert(path, csv_path, &len) != NULL) {
+            fprintf(stderr, "FAIL Zip64 locator in %s: the archive opens\n", locators[l].name);
+            failures++;
+        }
+        if (zip) {
+            xlsx_zip_close(zip);
+        }
+    }
+
+    /* The archive on STDIN, with sizes in the local headers or in data descriptors */
+    for (int descriptors = 0; descriptors <= 1; descriptors++) {
+        const char *what   = descriptors ? "STDIN, data descriptors" : "STDIN";
+        size_t      len    = 0;
+        char       *csv    = NULL;
+        zipLayout   layout = {NULL, 0, false, descriptors == 1};
+        if (write_zip(path, parts, part_count, &layout)) {
+            csv = convert_stdin(path, csv_path, &len);
+        }
+        if (!csv || len != expected_len || memcmp(csv, expected, len) != 0) {
+            fprintf(stderr, "FAIL %s: the CSV differs from the workbook file's\n", what);
+            failures++;
+        }
+        free(csv);
+
+        /* Cut inside the worksheet */
+        unlink(csv_path);
+        if (truncate(path, (off_t)(parts[part_count - 1].offset + 100)) != 0 ||
+            convert_stdin(path, csv_path, &len) != NULL) {
+            fprintf(stderr, "FAIL %s: a truncated archive converts\n", what);
+            failures++;
+        }
+    }
+
+    unlink(path);
+    unlink(csv_path);
+    free(expected);
+    zip_parts_free(parts, part_count);
+    free(sheet);
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    printf("zip_reader: entries with wrong or missing sizes read in full\n");
+    return 0;
+}